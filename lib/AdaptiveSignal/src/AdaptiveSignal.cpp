@@ -0,0 +1,104 @@
+#include "AdaptiveSignal.h"
+
+#include <string.h>
+
+AdaptiveSignal::AdaptiveSignal(const Config &config) : config_(config) {
+  memset(approaches_, 0, sizeof(approaches_));
+}
+
+void AdaptiveSignal::advanceBuckets(Approach &approach, uint32_t nowMs) {
+  uint32_t slot = nowMs / RATE_BUCKET_MS;
+  uint32_t stale = slot - approach.bucketSlot;
+  if (stale > RATE_BUCKETS) {
+    stale = RATE_BUCKETS;
+  }
+  for (uint32_t i = 1; i <= stale; i++) {
+    approach.buckets[(approach.bucketSlot + i) % RATE_BUCKETS] = 0;
+  }
+  approach.bucketSlot = slot;
+}
+
+void AdaptiveSignal::addArrivals(uint8_t approach, uint32_t count, uint32_t nowMs) {
+  if (approach >= APPROACHES || count == 0) {
+    return;
+  }
+  Approach &a = approaches_[approach];
+  advanceBuckets(a, nowMs);
+  uint16_t &bucket = a.buckets[a.bucketSlot % RATE_BUCKETS];
+  bucket = (bucket + count > UINT16_MAX) ? UINT16_MAX : bucket + count;
+
+  // Cars arriving on green with nobody ahead of them drive straight through
+  if (a.green && a.queue == 0) {
+    a.served += count;
+  } else {
+    a.queue += count;
+  }
+}
+
+void AdaptiveSignal::greenStarted(uint8_t approach, uint32_t nowMs) {
+  Approach &a = approaches_[approach];
+  a.green = true;
+  a.greenStartMs = nowMs;
+}
+
+void AdaptiveSignal::greenEnded(uint8_t approach, uint32_t nowMs) {
+  Approach &a = approaches_[approach];
+  if (!a.green) {
+    return;
+  }
+  a.green = false;
+
+  uint32_t elapsed = nowMs - a.greenStartMs;
+  uint32_t discharged = 0;
+  if (elapsed > config_.startupLostMs) {
+    discharged = (elapsed - config_.startupLostMs) / config_.headwayMs;
+  }
+  if (discharged > a.queue) {
+    discharged = a.queue;
+  }
+  a.queue -= discharged;
+  a.served += discharged;
+}
+
+uint32_t AdaptiveSignal::arrivalsPerHour(uint8_t approach, uint32_t nowMs) {
+  Approach &a = approaches_[approach];
+  advanceBuckets(a, nowMs);
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < RATE_BUCKETS; i++) {
+    total += a.buckets[i];
+  }
+  return total * (3600000UL / (RATE_BUCKETS * RATE_BUCKET_MS));
+}
+
+uint32_t AdaptiveSignal::greenTime(uint8_t approach, uint32_t nowMs) {
+  uint32_t queue = approaches_[approach].queue;
+  uint32_t rate = arrivalsPerHour(approach, nowMs);
+  uint8_t other = (approach + 1) % APPROACHES;
+  bool otherIdle = approaches_[other].queue == 0 && arrivalsPerHour(other, nowMs) == 0;
+
+  // Nobody to serve: give the minimum and move on
+  if (queue == 0 && rate == 0) {
+    return config_.minGreenMs;
+  }
+  // Nobody waiting on the other road: keep this one moving
+  if (otherIdle) {
+    return config_.maxGreenMs;
+  }
+
+  // The queue has to clear, and cars arriving meanwhile join the back of it:
+  //   g = lost + headway * (queue + rate * g)  =>  g = (lost + headway * queue) / (1 - headway * rate)
+  uint64_t busyPerMille = (uint64_t)config_.headwayMs * rate / 3600;
+  if (busyPerMille >= 900) {
+    return config_.maxGreenMs; // close to saturation
+  }
+  uint64_t green = ((uint64_t)config_.startupLostMs + (uint64_t)config_.headwayMs * queue) * 1000 /
+                   (1000 - busyPerMille);
+
+  if (green < config_.minGreenMs) {
+    return config_.minGreenMs;
+  }
+  if (green > config_.maxGreenMs) {
+    return config_.maxGreenMs;
+  }
+  return (uint32_t)green;
+}
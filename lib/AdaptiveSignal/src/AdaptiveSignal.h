@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+// Demand-responsive green times for a two-approach intersection, in the
+// spirit of SCATS/SCOOT: every green is sized from the queue that built up
+// on that approach while it was red plus the cars expected to arrive while it
+// is green, clamped to configured bounds.
+//
+// Detectors report arrivals with addArrivals(). The controller reports phase
+// changes with greenStarted()/greenEnded(). All times are milliseconds from
+// millis(), and nothing here allocates or blocks.
+class AdaptiveSignal {
+public:
+  static const uint8_t APPROACHES = 2;
+
+  struct Config {
+    uint32_t minGreenMs;
+    uint32_t maxGreenMs;
+    uint32_t headwayMs;     // one queued car leaves per headway (saturation flow)
+    uint32_t startupLostMs; // time lost before the first car moves
+  };
+
+  explicit AdaptiveSignal(const Config &config);
+
+  void addArrivals(uint8_t approach, uint32_t count, uint32_t nowMs);
+  void greenStarted(uint8_t approach, uint32_t nowMs);
+  void greenEnded(uint8_t approach, uint32_t nowMs);
+
+  // Green time for an approach whose green starts now
+  uint32_t greenTime(uint8_t approach, uint32_t nowMs);
+
+  // Estimated cars waiting, and arrival rate over the last two minutes
+  uint32_t queue(uint8_t approach) const { return approaches_[approach].queue; }
+  uint32_t arrivalsPerHour(uint8_t approach, uint32_t nowMs);
+  // Cars estimated to have left on green so far
+  uint32_t served(uint8_t approach) const { return approaches_[approach].served; }
+
+private:
+  static const uint8_t RATE_BUCKETS = 12;
+  static const uint32_t RATE_BUCKET_MS = 10000;
+
+  struct Approach {
+    uint32_t queue;
+    uint32_t served;
+    bool green;
+    uint32_t greenStartMs;
+    uint16_t buckets[RATE_BUCKETS]; // arrivals per 10 s slot
+    uint32_t bucketSlot;            // slot number of the newest bucket
+  };
+
+  void advanceBuckets(Approach &approach, uint32_t nowMs);
+
+  Config config_;
+  Approach approaches_[APPROACHES];
+};
@@ -0,0 +1,134 @@
+#include "AdcService.h"
+
+namespace {
+
+const uint16_t SAMPLES_PER_VALUE = 1 << (2 * ADC_SERVICE_OVERSAMPLE_BITS);
+
+// ADC1 channel of GPIO 32..39
+const int8_t ADC1_CHANNEL_OF_PIN[8] = {4, 5, 6, 7, 0, 1, 2, 3};
+
+#if defined(ARDUINO_ARCH_ESP32)
+// Bytes the driver hands over per DMA interrupt, and buffers between the
+// DMA and the task
+const uint32_t FRAME_BYTES = 256;
+const uint32_t DRIVER_BUFFER_BYTES = 4 * FRAME_BYTES;
+#endif
+
+} // namespace
+
+int8_t AdcService::addPin(uint8_t pin) {
+  if (pin < 32 || pin > 39 || count_ >= ADC_SERVICE_MAX_CHANNELS) {
+    return -1;
+  }
+  uint8_t channel = ADC1_CHANNEL_OF_PIN[pin - 32];
+  if (indexOf_[channel] >= 0) {
+    return indexOf_[channel];
+  }
+  channels_[count_] = channel;
+  indexOf_[channel] = count_;
+  return count_++;
+}
+
+uint16_t AdcService::read(uint8_t index) const {
+  Frame frame;
+  frames_.read(frame);
+  return frame.values[index];
+}
+
+uint16_t AdcService::read12(uint8_t index) const {
+  const uint16_t half = (1 << ADC_SERVICE_OVERSAMPLE_BITS) >> 1;
+  return (read(index) + half) >> ADC_SERVICE_OVERSAMPLE_BITS;
+}
+
+void AdcService::addSamples(const uint16_t *samples, size_t count) {
+  uint8_t allDone = (1 << count_) - 1;
+  for (size_t i = 0; i < count; i++) {
+    uint8_t channel = samples[i] >> 12;
+    int8_t index = channel < 8 ? indexOf_[channel] : -1;
+    if (index < 0) {
+      continue;
+    }
+    sums_[index] += samples[i] & 0x0FFF;
+    if (++samples_[index] < SAMPLES_PER_VALUE) {
+      continue;
+    }
+    pending_.values[index] = sums_[index] >> ADC_SERVICE_OVERSAMPLE_BITS;
+    sums_[index] = 0;
+    samples_[index] = 0;
+    done_ |= 1 << index;
+    if (done_ == allDone) {
+      frames_.publish(pending_);
+      done_ = 0;
+    }
+  }
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool AdcService::begin(UBaseType_t priority, BaseType_t core) {
+  if (count_ == 0) {
+    return false;
+  }
+
+  adc_digi_init_config_t init = {};
+  init.max_store_buf_size = DRIVER_BUFFER_BYTES;
+  init.conv_num_each_intr = FRAME_BYTES;
+  adc_digi_pattern_config_t pattern[ADC_SERVICE_MAX_CHANNELS] = {};
+  for (uint8_t i = 0; i < count_; i++) {
+    init.adc1_chan_mask |= 1 << channels_[i];
+    pattern[i].atten = ADC_ATTEN_DB_11; // full 0-3.3 V range, as analogRead()
+    pattern[i].channel = channels_[i];
+    pattern[i].unit = 0; // ADC1
+    pattern[i].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+  }
+  if (adc_digi_initialize(&init) != ESP_OK) {
+    return false;
+  }
+
+  adc_digi_configuration_t config = {};
+  config.conv_limit_en = 1; // required on the ESP32
+  config.conv_limit_num = 250;
+  config.pattern_num = count_;
+  config.adc_pattern = pattern;
+  config.sample_freq_hz = ADC_SERVICE_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE1;
+  if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK) {
+    return false;
+  }
+  if (xTaskCreatePinnedToCore(taskMain, "adc", 3072, this, priority, NULL, core) != pdPASS) {
+    return false;
+  }
+
+  unsigned long start = millis();
+  while (updates() == 0) {
+    if (millis() - start > 100) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+void AdcService::taskMain(void *arg) {
+  AdcService *service = static_cast<AdcService *>(arg);
+  uint16_t frame[FRAME_BYTES / sizeof(uint16_t)];
+
+  for (;;) {
+    uint32_t length = 0;
+    esp_err_t err = adc_digi_read_bytes((uint8_t *)frame, sizeof(frame), &length, ADC_MAX_DELAY);
+    if (err == ESP_ERR_INVALID_STATE) {
+      // The driver dropped conversions, but what it returned is still good
+      service->overruns_++;
+    }
+    else if (err != ESP_OK) {
+      continue;
+    }
+    service->addSamples(frame, length / sizeof(uint16_t));
+  }
+}
+#else
+// Nothing samples on the host; tests feed addSamples() themselves
+bool AdcService::begin(UBaseType_t priority, BaseType_t core) {
+  return count_ > 0;
+}
+#endif
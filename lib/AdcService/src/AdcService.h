@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+#include "DoubleBuffer.h"
+
+#ifndef ADC_SERVICE_MAX_CHANNELS
+#define ADC_SERVICE_MAX_CHANNELS 4
+#endif
+
+// Conversions per second, shared round-robin by all channels. The ESP32
+// digital controller does not go below 20 kHz.
+#ifndef ADC_SERVICE_SAMPLE_HZ
+#define ADC_SERVICE_SAMPLE_HZ 20000
+#endif
+
+// Each output is the sum of 4^bits conversions shifted down by bits, which
+// adds that many bits of resolution and averages the noise down by 2^bits.
+#ifndef ADC_SERVICE_OVERSAMPLE_BITS
+#define ADC_SERVICE_OVERSAMPLE_BITS 4
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/adc.h>
+#endif
+
+// Samples ADC1 pins in the background and keeps the latest oversampled value
+// of each, so loop() never waits on a conversion.
+//
+// The ADC digital controller converts the pins in turn at
+// ADC_SERVICE_SAMPLE_HZ and DMAs the results to the driver. A task drains
+// them, sums 4^ADC_SERVICE_OVERSAMPLE_BITS conversions per pin and, once
+// every pin has a new value, publishes them together through a DoubleBuffer.
+// With the defaults and two pins that is 39 new values a second, each 16
+// bits instead of 12.
+//
+// Only ADC1 pins (GPIO 32-39) work: ADC2 is shared with WiFi. While the
+// service runs, analogRead() must not be used on ADC1.
+class AdcService {
+public:
+  static const uint8_t BITS = 12 + ADC_SERVICE_OVERSAMPLE_BITS;
+  static const uint32_t FULL_SCALE = 4095UL << ADC_SERVICE_OVERSAMPLE_BITS;
+
+  struct Frame {
+    uint16_t values[ADC_SERVICE_MAX_CHANNELS];
+  };
+
+  // Adds an ADC1 pin. Returns its index for read(), or -1 when the pin is
+  // not on ADC1 or ADC_SERVICE_MAX_CHANNELS are in use.
+  int8_t addPin(uint8_t pin);
+
+  // Starts sampling, then waits (up to 100 ms) for the first values so
+  // read() is good straight away
+  bool begin(UBaseType_t priority = 2, BaseType_t core = 0);
+
+  // Latest value, 0..FULL_SCALE
+  uint16_t read(uint8_t index) const;
+  // The same rounded to 12 bits, to stand in for analogRead()
+  uint16_t read12(uint8_t index) const;
+  // All pins' values from the same round
+  uint32_t readFrame(Frame &frame) const { return frames_.read(frame); }
+
+  // Rounds published so far
+  uint32_t updates() const { return frames_.sequence(); }
+  // Times the driver's buffer overflowed because the task fell behind
+  uint32_t overruns() const { return overruns_; }
+
+  // Takes raw conversions in the controller's TYPE1 format: 12 bits of
+  // result, ADC1 channel in the top 4. The task calls this with each DMA
+  // frame; the host tests call it directly.
+  void addSamples(const uint16_t *samples, size_t count);
+
+private:
+  static void taskMain(void *arg);
+
+  uint8_t channels_[ADC_SERVICE_MAX_CHANNELS]; // ADC1 channel of each index
+  int8_t indexOf_[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+  uint8_t count_ = 0;
+  uint32_t sums_[ADC_SERVICE_MAX_CHANNELS] = {};
+  uint16_t samples_[ADC_SERVICE_MAX_CHANNELS] = {};
+  uint8_t done_ = 0; // bit per index with a value for this round
+  Frame pending_ = {};
+  DoubleBuffer<Frame> frames_;
+  volatile uint32_t overruns_ = 0;
+};
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Hands the latest value of T from one writer to any number of readers
+// without locks.
+//
+// The writer fills the slot readers are not being pointed at, then bumps a
+// sequence number that selects it. A reader copies the current slot and
+// checks the sequence did not move meanwhile; if it did, the writer may have
+// reused that slot, so the reader copies again. Meant for a writer that
+// publishes much less often than a copy takes, where retries are rare.
+template <typename T>
+class DoubleBuffer {
+public:
+  // Writer side
+  void publish(const T &value) {
+    uint32_t sequence = __atomic_load_n(&sequence_, __ATOMIC_RELAXED);
+    slots_[(sequence + 1) & 1] = value;
+    __atomic_store_n(&sequence_, sequence + 1, __ATOMIC_RELEASE);
+  }
+
+  // Reader side. Returns the sequence number of the value copied, 0 when
+  // nothing has been published yet.
+  uint32_t read(T &value) const {
+    for (;;) {
+      uint32_t sequence = __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE);
+      value = slots_[sequence & 1];
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&sequence_, __ATOMIC_RELAXED) == sequence) {
+        return sequence;
+      }
+    }
+  }
+
+  uint32_t sequence() const { return __atomic_load_n(&sequence_, __ATOMIC_ACQUIRE); }
+
+private:
+  T slots_[2] = {};
+  uint32_t sequence_ = 0;
+};
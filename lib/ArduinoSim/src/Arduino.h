@@ -0,0 +1,66 @@
+#pragma once
+
+// Host build of the Arduino-ESP32 API, backed by the simulator in Sim.h.
+// Only the calls the sketches in this repo use are provided.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#include "Print.h"
+#include "HardwareSerial.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+#define IRAM_ATTR
+#define ARDUINO_ISR_ATTR
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+long map(long x, long in_min, long in_max, long out_min, long out_max);
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+uint16_t analogRead(uint8_t pin);
+
+// Simulated interrupts never preempt the code that is running, so there is
+// nothing to mask
+#define interrupts()
+#define noInterrupts()
+
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
@@ -0,0 +1,733 @@
+#include "Sim.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+HardwareSerial Serial;
+
+struct SimQueue {
+  size_t itemSize;
+  size_t length;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+struct SimTask {
+  enum State { READY, BLOCKED, DELETED };
+
+  std::string name;
+  TaskFunction_t code;
+  void *arg;
+  UBaseType_t priority;
+  uint32_t stackDepth;
+
+  State state = READY;
+  uint64_t order = 0;             // round robin between equal priorities
+  uint64_t wakeUs = UINT64_MAX;   // timeout while blocked
+  bool timedOut = false;
+  bool waitingNotify = false;
+  SimQueue *waitingQueue = nullptr;
+  uint32_t notifyValue = 0;
+  bool notifyPending = false;
+
+  // Only the thread holding the baton (running == true) touches sim state
+  bool running = false;
+  std::condition_variable cv;
+  std::unique_lock<std::mutex> *lock = nullptr;
+};
+
+namespace {
+
+const uint64_t NEVER = UINT64_MAX;
+
+struct Pin {
+  uint8_t mode = INPUT;
+  uint8_t level = LOW;
+  uint16_t analog = 0;
+  void (*isr)() = nullptr;
+  void (*isrWithArg)(void *) = nullptr;
+  void *isrArg = nullptr;
+  int isrMode = 0;
+};
+
+// Never destroyed: task threads are still parked on these when main() returns
+std::mutex &simMutex = *new std::mutex;
+std::condition_variable &schedulerCv = *new std::condition_variable;
+std::vector<SimTask *> tasks;
+SimTask *current = nullptr;
+uint64_t now = 0;
+uint64_t orderCounter = 0;
+
+std::multimap<uint64_t, std::pair<uint8_t, uint8_t>> inputs; // time -> (pin, level)
+Pin pins[64];
+std::vector<sim::PinChange> history;
+LiquidCrystal *lastLcd = nullptr;
+std::mt19937 rng;
+
+void (*sketchSetup)() = nullptr;
+void (*sketchLoop)() = nullptr;
+
+uint64_t wakeTimeFor(TickType_t ticks) {
+  if (ticks == portMAX_DELAY) {
+    return NEVER;
+  }
+  return now + (uint64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+void makeReady(SimTask *task) {
+  if (task->state != SimTask::BLOCKED) {
+    return;
+  }
+  task->state = SimTask::READY;
+  task->wakeUs = NEVER;
+  task->order = ++orderCounter;
+}
+
+// Task thread: hand the baton back to the scheduler and wait to be resumed
+void yieldToScheduler(SimTask *self) {
+  self->running = false;
+  current = nullptr;
+  schedulerCv.notify_one();
+  self->cv.wait(*self->lock, [self] { return self->running; });
+}
+
+// Task thread: block until woken or until wakeUs. Returns false on timeout.
+bool blockCurrent(uint64_t wakeUs) {
+  SimTask *self = current;
+  self->state = SimTask::BLOCKED;
+  self->wakeUs = wakeUs;
+  self->timedOut = false;
+  yieldToScheduler(self);
+  return !self->timedOut;
+}
+
+void wakeQueueWaiters(SimQueue *queue) {
+  for (SimTask *task : tasks) {
+    if (task->state == SimTask::BLOCKED && task->waitingQueue == queue) {
+      makeReady(task);
+    }
+  }
+}
+
+void notify(SimTask *task, uint32_t value, eNotifyAction action) {
+  switch (action) {
+  case eNoAction:
+    break;
+  case eSetBits:
+    task->notifyValue |= value;
+    break;
+  case eIncrement:
+    task->notifyValue++;
+    break;
+  case eSetValueWithOverwrite:
+    task->notifyValue = value;
+    break;
+  case eSetValueWithoutOverwrite:
+    if (!task->notifyPending) {
+      task->notifyValue = value;
+    }
+    break;
+  }
+  task->notifyPending = true;
+  if (task->state == SimTask::BLOCKED && task->waitingNotify) {
+    makeReady(task);
+  }
+}
+
+void applyInput(uint8_t pin, uint8_t level) {
+  Pin &p = pins[pin];
+  uint8_t old = p.level;
+  p.level = level;
+  if ((p.isr == nullptr && p.isrWithArg == nullptr) || old == level) {
+    return;
+  }
+  bool rising = old == LOW && level == HIGH;
+  if (p.isrMode == CHANGE || (p.isrMode == RISING && rising) || (p.isrMode == FALLING && !rising)) {
+    // interrupt context: no current task
+    if (p.isr != nullptr) {
+      p.isr();
+    }
+    else {
+      p.isrWithArg(p.isrArg);
+    }
+  }
+}
+
+void deliverDueInputs() {
+  while (!inputs.empty() && inputs.begin()->first <= now) {
+    auto input = inputs.begin()->second;
+    inputs.erase(inputs.begin());
+    applyInput(input.first, input.second);
+  }
+}
+
+SimTask *pickReady() {
+  SimTask *best = nullptr;
+  for (SimTask *task : tasks) {
+    if (task->state != SimTask::READY) {
+      continue;
+    }
+    if (best == nullptr || task->priority > best->priority ||
+        (task->priority == best->priority && task->order < best->order)) {
+      best = task;
+    }
+  }
+  return best;
+}
+
+void runTask(SimTask *task, std::unique_lock<std::mutex> &lock) {
+  current = task;
+  task->running = true;
+  task->cv.notify_one();
+  schedulerCv.wait(lock, [] { return current == nullptr; });
+}
+
+void taskThread(SimTask *task) {
+  std::unique_lock<std::mutex> lock(simMutex);
+  task->lock = &lock;
+  task->cv.wait(lock, [task] { return task->running; });
+
+  task->code(task->arg);
+
+  // A FreeRTOS task must not return; treat it as deleting itself
+  task->state = SimTask::DELETED;
+  task->running = false;
+  current = nullptr;
+  schedulerCv.notify_one();
+}
+
+void loopTask(void *) {
+  sketchSetup();
+  for (;;) {
+    sketchLoop();
+  }
+}
+
+} // namespace
+
+// ---- Simulator control ----
+
+namespace sim {
+
+void begin(void (*setupFn)(), void (*loopFn)()) {
+  sketchSetup = setupFn;
+  sketchLoop = loopFn;
+  std::lock_guard<std::mutex> lock(simMutex);
+  xTaskCreatePinnedToCore(loopTask, "loopTask", 8192, nullptr, 1, nullptr, 1);
+}
+
+uint64_t nowUs() {
+  return now;
+}
+
+void runUntil(uint64_t endUs) {
+  std::unique_lock<std::mutex> lock(simMutex);
+
+  for (;;) {
+    deliverDueInputs();
+
+    SimTask *next = pickReady();
+    if (next != nullptr) {
+      runTask(next, lock);
+      continue;
+    }
+
+    // Everything is blocked: jump to the next timeout or input
+    uint64_t nextUs = endUs;
+    for (SimTask *task : tasks) {
+      if (task->state == SimTask::BLOCKED && task->wakeUs < nextUs) {
+        nextUs = task->wakeUs;
+      }
+    }
+    if (!inputs.empty() && inputs.begin()->first < nextUs) {
+      nextUs = inputs.begin()->first;
+    }
+    if (nextUs > now) {
+      now = nextUs;
+    }
+
+    bool woke = false;
+    for (SimTask *task : tasks) {
+      if (task->state == SimTask::BLOCKED && task->wakeUs <= now) {
+        makeReady(task);
+        task->timedOut = true;
+        woke = true;
+      }
+    }
+    bool inputsDue = !inputs.empty() && inputs.begin()->first <= now;
+    if (!woke && !inputsDue && now >= endUs) {
+      break;
+    }
+  }
+}
+
+void runFor(uint64_t us) {
+  runUntil(now + us);
+}
+
+void setInputAt(uint64_t us, uint8_t pin, uint8_t level) {
+  std::lock_guard<std::mutex> lock(simMutex);
+  inputs.insert({us, {pin, level}});
+}
+
+void pulseLowAt(uint64_t us, uint8_t pin, uint64_t widthUs) {
+  setInputAt(us, pin, LOW);
+  setInputAt(us + widthUs, pin, HIGH);
+}
+
+void setAnalog(uint8_t pin, uint16_t value) {
+  std::lock_guard<std::mutex> lock(simMutex);
+  pins[pin].analog = value;
+}
+
+uint8_t pinLevel(uint8_t pin) {
+  return pins[pin].level;
+}
+
+const std::vector<PinChange> &pinHistory() {
+  return history;
+}
+
+LiquidCrystal *lcd() {
+  return lastLcd;
+}
+
+std::string lcdLine(uint8_t row) {
+  std::string line;
+  if (lastLcd == nullptr) {
+    return line;
+  }
+  for (uint8_t col = 0; col < lastLcd->cols(); col++) {
+    line.push_back(lastLcd->charAt(col, row));
+  }
+  return line;
+}
+
+} // namespace sim
+
+// ---- Arduino core ----
+
+long map(long x, long in_min, long in_max, long out_min, long out_max) {
+  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) {
+    return 0;
+  }
+  return (long)(rng() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) {
+    return howsmall;
+  }
+  return random(howbig - howsmall) + howsmall;
+}
+
+void randomSeed(unsigned long seed) {
+  rng.seed(seed);
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t)now;
+}
+
+unsigned long millis() {
+  return (unsigned long)(now / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)now;
+}
+
+void delay(uint32_t ms) {
+  vTaskDelay(pdMS_TO_TICKS(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  // Busy-wait on real hardware; here it just moves the clock
+  now += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  pins[pin].mode = mode;
+  if (mode == INPUT_PULLUP) {
+    pins[pin].level = HIGH;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  uint8_t level = val ? HIGH : LOW;
+  if (pins[pin].level != level) {
+    pins[pin].level = level;
+    history.push_back({now, pin, level});
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  return pins[pin].level;
+}
+
+uint16_t analogRead(uint8_t pin) {
+  return pins[pin].analog;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  pins[pin].isr = isr;
+  pins[pin].isrWithArg = nullptr;
+  pins[pin].isrMode = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode) {
+  pins[pin].isr = nullptr;
+  pins[pin].isrWithArg = isr;
+  pins[pin].isrArg = arg;
+  pins[pin].isrMode = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  pins[pin].isr = nullptr;
+  pins[pin].isrWithArg = nullptr;
+}
+
+// ---- Print ----
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long n, int base) {
+  if (base == 10 && n < 0) {
+    return print('-') + printNumber((unsigned long long)(-(long long)n), 10);
+  }
+  return printNumber((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+  return printNumber(n, base);
+}
+
+size_t Print::print(long long n, int base) {
+  if (base == 10 && n < 0) {
+    return print('-') + printNumber((unsigned long long)(-n), 10);
+  }
+  return printNumber((unsigned long long)n, base);
+}
+
+size_t Print::print(unsigned long long n, int base) {
+  return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+  return printFloat(n, digits);
+}
+
+size_t Print::printNumber(unsigned long long n, uint8_t base) {
+  char buf[8 * sizeof(n) + 1];
+  char *str = &buf[sizeof(buf) - 1];
+  *str = '\0';
+  if (base < 2) {
+    base = 10;
+  }
+  do {
+    char c = n % base;
+    n /= base;
+    *--str = c < 10 ? c + '0' : c + 'A' - 10;
+  } while (n);
+  return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits) {
+  if (isnan(number)) {
+    return print("nan");
+  }
+  if (isinf(number)) {
+    return print("inf");
+  }
+  if (number > 4294967040.0 || number < -4294967040.0) {
+    return print("ovf");
+  }
+
+  size_t n = 0;
+  if (number < 0.0) {
+    n += print('-');
+    number = -number;
+  }
+
+  double rounding = 0.5;
+  for (uint8_t i = 0; i < digits; ++i) {
+    rounding /= 10.0;
+  }
+  number += rounding;
+
+  unsigned long intPart = (unsigned long)number;
+  double remainder = number - (double)intPart;
+  n += print(intPart);
+  if (digits > 0) {
+    n += print('.');
+  }
+  while (digits-- > 0) {
+    remainder *= 10.0;
+    unsigned int toPrint = (unsigned int)remainder;
+    n += print(toPrint);
+    remainder -= toPrint;
+  }
+  return n;
+}
+
+// ---- LiquidCrystal ----
+
+LiquidCrystal::LiquidCrystal(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t) {
+  memset(ddram_, ' ', sizeof(ddram_));
+  lastLcd = this;
+}
+
+void LiquidCrystal::begin(uint8_t cols, uint8_t rows) {
+  cols_ = cols;
+  rows_ = rows;
+  clear();
+}
+
+void LiquidCrystal::clear() {
+  memset(ddram_, ' ', sizeof(ddram_));
+  address_ = 0;
+  busBytes_++;
+  clears_++;
+}
+
+void LiquidCrystal::home() {
+  address_ = 0;
+  busBytes_++;
+}
+
+void LiquidCrystal::setCursor(uint8_t col, uint8_t row) {
+  static const uint8_t rowOffsets[4] = {0x00, 0x40, 0x14, 0x54};
+  if (row >= rows_) {
+    row = rows_ - 1;
+  }
+  address_ = (rowOffsets[row] + col) & (DDRAM_SIZE - 1);
+  busBytes_++;
+}
+
+size_t LiquidCrystal::write(uint8_t c) {
+  ddram_[address_] = (char)c;
+  address_ = (address_ + 1) & (DDRAM_SIZE - 1);
+  busBytes_++;
+  return 1;
+}
+
+char LiquidCrystal::charAt(uint8_t col, uint8_t row) const {
+  static const uint8_t rowOffsets[4] = {0x00, 0x40, 0x14, 0x54};
+  return ddram_[(rowOffsets[row] + col) & (DDRAM_SIZE - 1)];
+}
+
+// ---- FreeRTOS tasks ----
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority,
+                                   TaskHandle_t *createdTask, BaseType_t) {
+  SimTask *task = new SimTask();
+  task->name = name;
+  task->code = code;
+  task->arg = parameters;
+  task->priority = priority;
+  task->stackDepth = stackDepth;
+  task->order = ++orderCounter;
+  tasks.push_back(task);
+  if (createdTask != nullptr) {
+    *createdTask = task;
+  }
+
+  std::thread(taskThread, task).detach();
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *createdTask) {
+  return xTaskCreatePinnedToCore(code, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  if (task == nullptr || task == current) {
+    SimTask *self = current;
+    self->state = SimTask::DELETED;
+    yieldToScheduler(self); // never resumed
+    return;
+  }
+  task->state = SimTask::DELETED;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  if (current == nullptr) {
+    now = wakeTimeFor(ticks);
+    return;
+  }
+  blockCurrent(wakeTimeFor(ticks));
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t)(now / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return current;
+}
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  // Host threads have their own stacks; report the task's full allocation
+  SimTask *t = task ? task : current;
+  return t ? t->stackDepth : 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  SimTask *self = current;
+  if (self->notifyValue == 0 && ticksToWait != 0) {
+    self->waitingNotify = true;
+    blockCurrent(wakeTimeFor(ticksToWait));
+    self->waitingNotify = false;
+  }
+
+  uint32_t value = self->notifyValue;
+  if (value != 0) {
+    self->notifyValue = clearCountOnExit ? 0 : value - 1;
+  }
+  self->notifyPending = false;
+  return value;
+}
+
+BaseType_t xTaskNotifyWait(uint32_t bitsToClearOnEntry, uint32_t bitsToClearOnExit,
+                           uint32_t *notificationValue, TickType_t ticksToWait) {
+  SimTask *self = current;
+  if (!self->notifyPending) {
+    self->notifyValue &= ~bitsToClearOnEntry;
+    if (ticksToWait != 0) {
+      self->waitingNotify = true;
+      blockCurrent(wakeTimeFor(ticksToWait));
+      self->waitingNotify = false;
+    }
+  }
+
+  if (notificationValue != nullptr) {
+    *notificationValue = self->notifyValue;
+  }
+  if (!self->notifyPending) {
+    return pdFALSE;
+  }
+  self->notifyValue &= ~bitsToClearOnExit;
+  self->notifyPending = false;
+  return pdTRUE;
+}
+
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action) {
+  notify(task, value, action);
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  notify(task, 0, eIncrement);
+  return pdPASS;
+}
+
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higherPriorityTaskWoken) {
+  notify(task, value, action);
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+  xTaskNotifyFromISR(task, 0, eIncrement, higherPriorityTaskWoken);
+}
+
+// ---- FreeRTOS queues ----
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  SimQueue *queue = new SimQueue();
+  queue->length = length;
+  queue->itemSize = itemSize;
+  return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete queue;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+  uint64_t wakeUs = wakeTimeFor(ticksToWait);
+  while (queue->items.size() >= queue->length) {
+    if (ticksToWait == 0 || current == nullptr || now >= wakeUs) {
+      return errQUEUE_FULL;
+    }
+    current->waitingQueue = queue;
+    SimTask *self = current;
+    blockCurrent(wakeUs);
+    self->waitingQueue = nullptr;
+  }
+
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  queue->items.emplace_back(bytes, bytes + queue->itemSize);
+  wakeQueueWaiters(queue);
+  return pdPASS;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+  return xQueueSend(queue, item, ticksToWait);
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken) {
+  if (higherPriorityTaskWoken != nullptr) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item) {
+  queue->items.clear();
+  return xQueueSend(queue, item, 0);
+}
+
+static BaseType_t queueTake(QueueHandle_t queue, void *buffer, TickType_t ticksToWait, bool remove) {
+  uint64_t wakeUs = wakeTimeFor(ticksToWait);
+  while (queue->items.empty()) {
+    if (ticksToWait == 0 || current == nullptr || now >= wakeUs) {
+      return pdFALSE;
+    }
+    SimTask *self = current;
+    self->waitingQueue = queue;
+    blockCurrent(wakeUs);
+    self->waitingQueue = nullptr;
+  }
+
+  memcpy(buffer, queue->items.front().data(), queue->itemSize);
+  if (remove) {
+    queue->items.pop_front();
+    wakeQueueWaiters(queue);
+  }
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+  return queueTake(queue, buffer, ticksToWait, true);
+}
+
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+  return queueTake(queue, buffer, ticksToWait, false);
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return (UBaseType_t)queue->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  return (UBaseType_t)(queue->length - queue->items.size());
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include "Print.h"
+
+// Everything written is kept in output() so tests can read the log, and
+// tests feed received bytes in with receive()
+class HardwareSerial : public Print {
+public:
+  void begin(unsigned long baud) { baud_ = baud; }
+  void end() {}
+  size_t setTxBufferSize(size_t size) { txBufferSize_ = size; return size; }
+  int availableForWrite() override { return (int)txBufferSize_; }
+  size_t write(uint8_t c) override { output_.push_back((char)c); return 1; }
+  using Print::write;
+  operator bool() const { return true; }
+
+  int available() { return (int)(input_.size() - inputPos_); }
+  int peek() { return available() > 0 ? (uint8_t)input_[inputPos_] : -1; }
+  int read() { return available() > 0 ? (uint8_t)input_[inputPos_++] : -1; }
+
+  unsigned long baud() const { return baud_; }
+  const std::string &output() const { return output_; }
+  void clearOutput() { output_.clear(); }
+  void receive(const std::string &bytes) { input_ += bytes; }
+
+private:
+  unsigned long baud_ = 0;
+  size_t txBufferSize_ = 128;
+  std::string output_;
+  std::string input_;
+  size_t inputPos_ = 0;
+};
+
+extern HardwareSerial Serial;
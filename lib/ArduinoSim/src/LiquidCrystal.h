@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Print.h"
+
+// HD44780 model. Keeps the display RAM so tests can read what is on the
+// glass, and counts the bytes that would have gone over the 4-bit bus.
+class LiquidCrystal : public Print {
+public:
+  LiquidCrystal(uint8_t rs, uint8_t enable, uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3);
+
+  void begin(uint8_t cols, uint8_t rows);
+  void clear();
+  void home();
+  void setCursor(uint8_t col, uint8_t row);
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Simulator access
+  uint8_t cols() const { return cols_; }
+  uint8_t rows() const { return rows_; }
+  char charAt(uint8_t col, uint8_t row) const;
+  uint32_t busBytes() const { return busBytes_; }
+  uint32_t clears() const { return clears_; }
+
+private:
+  static const uint8_t DDRAM_SIZE = 0x80;
+
+  uint8_t cols_ = 16;
+  uint8_t rows_ = 2;
+  uint8_t address_ = 0;
+  char ddram_[DDRAM_SIZE];
+  uint32_t busBytes_ = 0;
+  uint32_t clears_ = 0;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+
+// Control surface for tests running a sketch on the host.
+//
+// Virtual time only moves inside run*(): tasks run until they all block, then
+// the clock jumps straight to the next timeout or scripted input. Scripted
+// inputs fire attached interrupts exactly like a real edge would. Hours of
+// sketch time therefore take milliseconds, and every run is deterministic.
+namespace sim {
+
+struct PinChange {
+  uint64_t us;
+  uint8_t pin;
+  uint8_t level;
+};
+
+// Start the Arduino loop task, which calls setupFn() once and then loopFn()
+// forever. Call once per test binary: sketch globals cannot be reset.
+void begin(void (*setupFn)(), void (*loopFn)());
+
+uint64_t nowUs();
+void runUntil(uint64_t us);
+void runFor(uint64_t us);
+
+// Drive an input pin to a level at an absolute virtual time
+void setInputAt(uint64_t us, uint8_t pin, uint8_t level);
+// Low pulse of the given width, as a photoresistor tripped by a car gives
+void pulseLowAt(uint64_t us, uint8_t pin, uint64_t widthUs);
+void setAnalog(uint8_t pin, uint16_t value);
+
+uint8_t pinLevel(uint8_t pin);
+// Every digitalWrite() that changed an output, oldest first
+const std::vector<PinChange> &pinHistory();
+
+// The most recently constructed LiquidCrystal
+LiquidCrystal *lcd();
+std::string lcdLine(uint8_t row);
+
+} // namespace sim
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+typedef struct SimQueue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait);
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t ticksToWait);
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken);
+BaseType_t xQueueOverwrite(QueueHandle_t queue, const void *item);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait);
+BaseType_t xQueuePeek(QueueHandle_t queue, void *buffer, TickType_t ticksToWait);
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Tasks are run one at a time by the simulator. Higher priority wins, and a
+// task runs until it blocks, so code takes no virtual time to execute.
+typedef struct SimTask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum { eNoAction, eSetBits, eIncrement, eSetValueWithOverwrite, eSetValueWithoutOverwrite } eNotifyAction;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                                   void *parameters, UBaseType_t priority,
+                                   TaskHandle_t *createdTask, BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint32_t stackDepth,
+                       void *parameters, UBaseType_t priority, TaskHandle_t *createdTask);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyWait(uint32_t bitsToClearOnEntry, uint32_t bitsToClearOnExit,
+                           uint32_t *notificationValue, TickType_t ticksToWait);
+BaseType_t xTaskNotify(TaskHandle_t task, uint32_t value, eNotifyAction action);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+BaseType_t xTaskNotifyFromISR(TaskHandle_t task, uint32_t value, eNotifyAction action,
+                              BaseType_t *higherPriorityTaskWoken);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
@@ -0,0 +1,130 @@
+#include "AsyncLcd.h"
+
+#include <string.h>
+
+AsyncLcd::AsyncLcd(LcdFrame &frame) : frame_(frame) {}
+
+bool AsyncLcd::begin(UBaseType_t priority, BaseType_t core) {
+  frame_.begin();
+
+  queue_ = xQueueCreate(QUEUE_LENGTH, sizeof(Command));
+  if (queue_ == NULL) {
+    return false;
+  }
+  return xTaskCreatePinnedToCore(taskMain, "lcd", 2048, this, priority, NULL, core) == pdPASS;
+}
+
+void AsyncLcd::clear() {
+  Command command = {};
+  command.type = CMD_CLEAR;
+  stage(command);
+}
+
+void AsyncLcd::setCursor(uint8_t col, uint8_t row) {
+  Command command = {};
+  command.type = CMD_CURSOR;
+  command.col = col;
+  command.row = row;
+  stage(command);
+}
+
+void AsyncLcd::printLine(uint8_t row, const char *text) {
+  Command command = {};
+  command.type = CMD_LINE;
+  command.row = row;
+  size_t length = strlen(text);
+  command.length = length < TEXT_MAX ? length : TEXT_MAX;
+  memcpy(command.text, text, command.length);
+  stage(command);
+}
+
+size_t AsyncLcd::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t AsyncLcd::write(const uint8_t *buffer, size_t size) {
+  size_t written = 0;
+  // print() of a number comes a character at a time: top up the last text
+  if (drawLength_ > 0 && draw_[drawLength_ - 1].type == CMD_TEXT) {
+    Command &last = draw_[drawLength_ - 1];
+    size_t room = TEXT_MAX - last.length;
+    written = size < room ? size : room;
+    memcpy(last.text + last.length, buffer, written);
+    last.length += written;
+  }
+  while (written < size) {
+    Command command = {};
+    command.type = CMD_TEXT;
+    command.length = (size - written) < TEXT_MAX ? (size - written) : TEXT_MAX;
+    memcpy(command.text, buffer + written, command.length);
+    stage(command);
+    written += command.length;
+  }
+  return size;
+}
+
+void AsyncLcd::render() {
+  Command command = {};
+  command.type = CMD_RENDER;
+  stage(command);
+
+  // Never wait for the LCD task; a full queue means it is far behind anyway.
+  // Only this task sends, so the room can only grow while the draw goes in.
+  if (drawTooBig_ || queue_ == NULL || uxQueueSpacesAvailable(queue_) < drawLength_) {
+    dropped_++;
+  }
+  else {
+    __atomic_add_fetch(&pendingRenders_, 1, __ATOMIC_RELAXED);
+    for (uint8_t i = 0; i < drawLength_; i++) {
+      xQueueSend(queue_, &draw_[i], 0);
+    }
+  }
+  drawLength_ = 0;
+  drawTooBig_ = false;
+}
+
+void AsyncLcd::stage(const Command &command) {
+  if (drawLength_ == DRAW_MAX) {
+    drawTooBig_ = true;
+    return;
+  }
+  draw_[drawLength_++] = command;
+}
+
+void AsyncLcd::apply(const Command &command) {
+  switch (command.type) {
+  case CMD_CLEAR:
+    frame_.clear();
+    break;
+  case CMD_CURSOR:
+    frame_.setCursor(command.col, command.row);
+    break;
+  case CMD_TEXT:
+    frame_.write((const uint8_t *)command.text, command.length);
+    break;
+  case CMD_LINE: {
+    char line[TEXT_MAX + 1];
+    memcpy(line, command.text, command.length);
+    line[command.length] = '\0';
+    frame_.printLine(command.row, line);
+    break;
+  }
+  case CMD_RENDER:
+    // Skip this one if a newer render is already on its way
+    if (__atomic_sub_fetch(&pendingRenders_, 1, __ATOMIC_RELAXED) == 0) {
+      frame_.render();
+    }
+    break;
+  }
+}
+
+void AsyncLcd::taskMain(void *arg) {
+  AsyncLcd *self = static_cast<AsyncLcd *>(arg);
+  Command command;
+
+  for (;;) {
+    if (xQueueReceive(self->queue_, &command, portMAX_DELAY) == pdTRUE) {
+      self->apply(command);
+    }
+  }
+}
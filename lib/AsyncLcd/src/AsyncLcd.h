@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LcdFrame.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// Non-blocking front end for an LcdFrame.
+//
+// clear(), setCursor(), print() and render() only record a small command and
+// return. render() posts the draw's commands to a FreeRTOS queue together,
+// or none of them if they do not all fit, so a full queue never shows half a
+// draw. A low-priority task on the other core applies the commands to the
+// frame and does the slow HD44780 bit-banging. If several render() requests
+// are queued, only the last one is drawn, so bursts of updates collapse into
+// a single diff.
+//
+// Draw from one task only.
+class AsyncLcd : public Print {
+public:
+  explicit AsyncLcd(LcdFrame &frame);
+
+  // Call once after lcd.begin(). Clears the screen and starts the task.
+  bool begin(UBaseType_t priority = 1, BaseType_t core = 0);
+
+  void clear();
+  void setCursor(uint8_t col, uint8_t row);
+  void printLine(uint8_t row, const char *text);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+
+  // Ask the task to send everything drawn since the last render() to the LCD
+  void render();
+
+  // Draws thrown away because the queue was full
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  static const uint8_t TEXT_MAX = LcdFrame::COLS;
+  static const UBaseType_t QUEUE_LENGTH = 64;
+  // Commands in one draw, render() included; a bigger draw is dropped
+  static const uint8_t DRAW_MAX = 12;
+
+  enum CommandType : uint8_t { CMD_CLEAR, CMD_CURSOR, CMD_TEXT, CMD_LINE, CMD_RENDER };
+
+  struct Command {
+    CommandType type;
+    uint8_t col;
+    uint8_t row;
+    uint8_t length;
+    char text[TEXT_MAX];
+  };
+
+  void stage(const Command &command);
+  void apply(const Command &command);
+  static void taskMain(void *arg);
+
+  LcdFrame &frame_;
+  QueueHandle_t queue_ = NULL;
+  Command draw_[DRAW_MAX];
+  uint8_t drawLength_ = 0;
+  bool drawTooBig_ = false;
+  volatile uint32_t pendingRenders_ = 0;
+  volatile uint32_t dropped_ = 0;
+};
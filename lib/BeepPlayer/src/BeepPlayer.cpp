@@ -0,0 +1,100 @@
+#include "BeepPlayer.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+// play() and stop() run in the caller's task, the timer callback in the
+// esp_timer task, possibly on the other core
+#define BEEP_LOCK() portENTER_CRITICAL(&lock_)
+#define BEEP_UNLOCK() portEXIT_CRITICAL(&lock_)
+#else
+#define BEEP_LOCK()
+#define BEEP_UNLOCK()
+#endif
+
+bool BeepPlayer::begin() {
+  pinMode(pin_, OUTPUT);
+  digitalWrite(pin_, LOW);
+
+#if defined(ARDUINO_ARCH_ESP32)
+  esp_timer_create_args_t args = {};
+  args.callback = onTimer;
+  args.arg = this;
+  args.name = "beep";
+  return esp_timer_create(&args, &timer_) == ESP_OK;
+#else
+  return true;
+#endif
+}
+
+void BeepPlayer::play(const Pattern &pattern) {
+  BEEP_LOCK();
+  if (pattern_ != &pattern) {
+    pattern_ = &pattern;
+    step_ = 0;
+    played_ = 0;
+    schedule(beep());
+  }
+  BEEP_UNLOCK();
+}
+
+void BeepPlayer::stop() {
+  BEEP_LOCK();
+  pattern_ = NULL;
+  on_ = false;
+  digitalWrite(pin_, LOW);
+  schedule(0);
+  BEEP_UNLOCK();
+}
+
+uint32_t BeepPlayer::advance() {
+  if (pattern_ == NULL) {
+    return 0;
+  }
+
+  if (on_) {
+    on_ = false;
+    digitalWrite(pin_, LOW);
+    uint16_t offMs = pattern_->steps[step_].offMs;
+    if (offMs > 0) {
+      return offMs;
+    }
+  }
+
+  if (++step_ >= pattern_->count) {
+    step_ = 0;
+    played_++;
+    if (pattern_->repeats != FOREVER && played_ >= pattern_->repeats) {
+      pattern_ = NULL;
+      return 0;
+    }
+  }
+  return beep();
+}
+
+uint32_t BeepPlayer::beep() {
+  on_ = true;
+  digitalWrite(pin_, HIGH);
+  return pattern_->steps[step_].onMs;
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void BeepPlayer::schedule(uint32_t ms) {
+  esp_timer_stop(timer_);
+  if (ms > 0) {
+    dueUs_ = esp_timer_get_time() + ms * 1000LL;
+    esp_timer_start_once(timer_, ms * 1000ULL);
+  }
+}
+
+void BeepPlayer::onTimer(void *arg) {
+  BeepPlayer *player = static_cast<BeepPlayer *>(arg);
+  portENTER_CRITICAL(&player->lock_);
+  // A play() or stop() that got the lock first has already re-armed the
+  // timer for its own pattern; this expiry belongs to the old one
+  if (esp_timer_get_time() >= player->dueUs_) {
+    player->schedule(player->advance());
+  }
+  portEXIT_CRITICAL(&player->lock_);
+}
+#else
+void BeepPlayer::schedule(uint32_t ms) {}
+#endif
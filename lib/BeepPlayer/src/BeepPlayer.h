@@ -0,0 +1,76 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_timer.h>
+#endif
+
+// Plays beep patterns on a buzzer pin without blocking the caller.
+//
+// A pattern is a table of on/off steps in flash, played `repeats` times or
+// until stop(). play() switches the buzzer on for the first step and returns
+// straight away; each later edge is made by a one-shot timer callback, so
+// loop() carries on sampling and drawing while the buzzer sounds.
+//
+//   const BeepPlayer::Step alarmSteps[] = {{300, 200}, {300, 1000}};
+//   const BeepPlayer::Pattern alarm = {alarmSteps, 2, BeepPlayer::FOREVER};
+//   buzzer.play(alarm);
+//
+// On the ESP32 the callbacks come from an esp_timer, which runs them in the
+// esp_timer task. On other targets nothing starts a timer: call advance()
+// when the delay it last returned is up (the host tests do).
+class BeepPlayer {
+public:
+  static const uint8_t FOREVER = 0;
+
+  struct Step {
+    uint16_t onMs;
+    uint16_t offMs; // silence after the beep, before the next step
+  };
+
+  struct Pattern {
+    const Step *steps;
+    uint8_t count;
+    uint8_t repeats; // FOREVER to play until stop()
+  };
+
+  explicit BeepPlayer(uint8_t pin) : pin_(pin) {}
+
+  // Sets the pin up (buzzer off) and creates the timer
+  bool begin();
+
+  // Starts `pattern` from its first step. Playing the pattern that is
+  // already playing carries on with it, so loop() can call this every pass
+  // while a condition holds.
+  void play(const Pattern &pattern);
+
+  // Silences the buzzer and drops the pattern
+  void stop();
+
+  bool playing() const { return pattern_ != NULL; }
+  const Pattern *current() const { return pattern_; }
+
+  // Makes the next edge of the pattern. Returns the milliseconds until the
+  // one after, or 0 when the pattern has finished.
+  uint32_t advance();
+
+private:
+  // Sounds the current step and returns its length
+  uint32_t beep();
+  void schedule(uint32_t ms);
+
+  uint8_t pin_;
+  const Pattern *pattern_ = NULL;
+  uint8_t step_ = 0;
+  uint8_t played_ = 0; // complete passes through the pattern
+  bool on_ = false;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  static void onTimer(void *arg);
+
+  esp_timer_handle_t timer_ = NULL;
+  int64_t dueUs_ = 0; // when the armed timer should fire
+  portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+#endif
+};
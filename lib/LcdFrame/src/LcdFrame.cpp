@@ -0,0 +1,99 @@
+#include "LcdFrame.h"
+
+#include <string.h>
+
+LcdFrame::LcdFrame(LiquidCrystal &lcd) : lcd_(lcd) {
+  memset(frame_, ' ', sizeof(frame_));
+  memset(glass_, ' ', sizeof(glass_));
+}
+
+void LcdFrame::begin() {
+  lcd_.clear();
+  memset(frame_, ' ', sizeof(frame_));
+  memset(glass_, ' ', sizeof(glass_));
+  col_ = 0;
+  row_ = 0;
+  glassCol_ = 0;
+  glassRow_ = 0;
+}
+
+void LcdFrame::clear() {
+  memset(frame_, ' ', sizeof(frame_));
+  col_ = 0;
+  row_ = 0;
+}
+
+void LcdFrame::setCursor(uint8_t col, uint8_t row) {
+  col_ = col;
+  row_ = row < ROWS ? row : ROWS - 1;
+}
+
+void LcdFrame::printLine(uint8_t row, const char *text) {
+  if (row >= ROWS) {
+    return;
+  }
+  uint8_t col = 0;
+  while (col < COLS && text[col] != '\0') {
+    frame_[row][col] = text[col];
+    col++;
+  }
+  while (col < COLS) {
+    frame_[row][col++] = ' ';
+  }
+}
+
+size_t LcdFrame::write(uint8_t c) {
+  if (c == '\r') {
+    return 1;
+  }
+  if (c == '\n') {
+    // Below the last row everything is dropped until setCursor() or clear()
+    col_ = 0;
+    if (row_ < ROWS) {
+      row_++;
+    }
+    return 1;
+  }
+  // The column stops at the edge, so a long print cannot wrap around
+  if (row_ < ROWS && col_ < COLS) {
+    frame_[row_][col_++] = (char)c;
+  }
+  return 1;
+}
+
+uint16_t LcdFrame::render() {
+  uint16_t sent = 0;
+
+  for (uint8_t row = 0; row < ROWS; row++) {
+    uint8_t col = 0;
+    while (col < COLS) {
+      if (frame_[row][col] == glass_[row][col]) {
+        col++;
+        continue;
+      }
+
+      // The LCD advances its cursor after each character, so a run that
+      // starts where the last one ended needs no cursor move
+      if (glassRow_ != row || glassCol_ != col) {
+        lcd_.setCursor(col, row);
+        sent++;
+      }
+      while (col < COLS && frame_[row][col] != glass_[row][col]) {
+        lcd_.write((uint8_t)frame_[row][col]);
+        glass_[row][col] = frame_[row][col];
+        sent++;
+        col++;
+      }
+
+      // Past the last column the LCD cursor is off screen, not on the next row
+      glassRow_ = row;
+      glassCol_ = col < COLS ? col : 0xFF;
+    }
+  }
+
+  return sent;
+}
+
+bool LcdFrame::dirty() const {
+  return memcmp(frame_, glass_, sizeof(frame_)) != 0;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <Arduino.h>
+#include <LiquidCrystal.h>
+
+// Shadow framebuffer for a 16x2 HD44780 LCD.
+//
+// Drawing (clear, setCursor, print) only changes a copy of the screen in RAM.
+// render() compares it with what is already on the glass and sends just the
+// cells that changed, with one cursor move per run of changed cells. That
+// avoids lcd.clear() (about 2 ms and a visible flicker) and rewriting all 32
+// characters when only a few of them change.
+class LcdFrame : public Print {
+public:
+  static const uint8_t COLS = 16;
+  static const uint8_t ROWS = 2;
+
+  explicit LcdFrame(LiquidCrystal &lcd);
+
+  // Call once after lcd.begin(). Clears the glass and both buffers.
+  void begin();
+
+  // Blank the frame. Nothing is sent until render().
+  void clear();
+
+  void setCursor(uint8_t col, uint8_t row);
+
+  // Replace a whole row, padding the rest of it with spaces
+  void printLine(uint8_t row, const char *text);
+
+  // Characters past the end of a row are dropped. '\n' moves to the start
+  // of the next row (println() does the same) and '\r' is ignored.
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Send the cells that differ from the glass. Returns bytes sent on the bus.
+  uint16_t render();
+
+  // True if render() has something to send
+  bool dirty() const;
+
+private:
+  LiquidCrystal &lcd_;
+  char frame_[ROWS][COLS]; // what should be on the glass
+  char glass_[ROWS][COLS]; // what was last sent to the glass
+  uint8_t col_ = 0;
+  uint8_t row_ = 0;
+  uint8_t glassCol_ = 0xFF; // where the LCD's own cursor is, 0xFF if unknown
+  uint8_t glassRow_ = 0xFF;
+};
@@ -0,0 +1,308 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Loop and task timing, kept in fixed-size buffers and printed on demand.
+//
+// Scopes and wake delays are short, so they are timed in raw cycles of the
+// fastest clock available:
+//   ESP32  CPU cycle counter (xthal_get_ccount), wraps after 17.9 s
+//   AVR    Timer1 running at F_CPU, widened to 32 bits by its overflow ISR.
+//          Define LOOP_PROFILER_USE_MICROS when Timer1 is already taken
+//          (the AVR Servo library uses it).
+//   other  micros()
+//
+// Periods between tick()s can be far longer (a traffic light phase lasts up
+// to 30 s), so they are timed in microseconds: esp_timer_get_time() on the
+// ESP32, which does not wrap, micros() elsewhere. Periods over 2^32 us
+// (71 minutes) are recorded as that.
+//
+// Interrupt entry latency (event to ISR) needs the time of the event, which
+// only a hardware capture gives; the ISR passes it to addIsrEntry().
+//
+// Include from one .cpp only on AVR, since the header defines the Timer1 ISR.
+// Each profiler should be written by one task; dump() from another task can
+// see a half-updated record, which is fine for diagnostics.
+
+#ifndef LOOP_PROFILER_BUCKETS
+#define LOOP_PROFILER_BUCKETS 20 // log2 microsecond buckets, 1 us .. 0.5 s+
+#endif
+
+#ifndef LOOP_PROFILER_MAX_SCOPES
+#define LOOP_PROFILER_MAX_SCOPES 4
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <xtensa/hal.h>
+#include <esp_timer.h>
+// What an ISR calls has to be in IRAM
+#define LOOP_PROFILER_IRAM IRAM_ATTR
+#else
+#define LOOP_PROFILER_IRAM
+#endif
+
+#if defined(ARDUINO_ARCH_ESP32)
+#elif defined(__AVR__) && !defined(LOOP_PROFILER_USE_MICROS)
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+volatile uint16_t loopProfilerTimer1High = 0;
+
+ISR(TIMER1_OVF_vect) {
+  loopProfilerTimer1High++;
+}
+#endif
+
+class LoopProfiler {
+public:
+  // Count, min, max and total of a series of durations
+  struct Stat {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+  };
+
+  struct Scope {
+    const char *name;
+    Stat stat;
+  };
+
+  explicit LoopProfiler(const char *name) : name_(name) {
+    reset();
+  }
+
+  // Set up the clock. Only does anything on AVR, where Timer1 has to run.
+  static void begin() {
+#if defined(__AVR__) && !defined(LOOP_PROFILER_USE_MICROS)
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10); // no prescaler
+    TCNT1 = 0;
+    TIMSK1 |= _BV(TOIE1);
+#endif
+  }
+
+  static uint32_t now() {
+#if defined(ARDUINO_ARCH_ESP32)
+    return xthal_get_ccount();
+#elif defined(__AVR__) && !defined(LOOP_PROFILER_USE_MICROS)
+    uint16_t high;
+    uint16_t low;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      low = TCNT1;
+      high = loopProfilerTimer1High;
+      // Overflow happened but its ISR has not run yet
+      if ((TIFR1 & _BV(TOV1)) && low < 0x8000) {
+        high++;
+      }
+    }
+    return ((uint32_t)high << 16) | low;
+#else
+    return micros();
+#endif
+  }
+
+  // Clock for tick() periods
+#if defined(ARDUINO_ARCH_ESP32)
+  typedef uint64_t Micros;
+  static Micros nowUs() { return esp_timer_get_time(); }
+#else
+  typedef uint32_t Micros;
+  static Micros nowUs() { return micros(); }
+#endif
+
+  static uint32_t cyclesPerMicrosecond() {
+#if defined(ARDUINO_ARCH_ESP32) || (defined(__AVR__) && !defined(LOOP_PROFILER_USE_MICROS))
+    return F_CPU / 1000000;
+#else
+    return 1;
+#endif
+  }
+
+  void reset() {
+    clearStat(period_);
+    clearStat(wakeDelay_);
+    clearStat(isrEntry_);
+    memset(periodBuckets_, 0, sizeof(periodBuckets_));
+    memset(wakeDelayBuckets_, 0, sizeof(wakeDelayBuckets_));
+    memset(isrEntryBuckets_, 0, sizeof(isrEntryBuckets_));
+    for (uint8_t i = 0; i < LOOP_PROFILER_MAX_SCOPES; i++) {
+      clearStat(scopes_[i].stat);
+    }
+    lastTickUs_ = 0;
+    ticking_ = false;
+  }
+
+  // Call once per pass of the loop. Records the time since the last call,
+  // in microseconds.
+  void tick() {
+    Micros t = nowUs();
+    if (ticking_) {
+      Micros elapsed = t - lastTickUs_;
+      uint32_t us = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+      addStat(period_, us);
+      periodBuckets_[bucketFor(us)]++;
+    }
+    lastTickUs_ = t;
+    ticking_ = true;
+  }
+
+  // How long after `since` (a now() value) a task got to run for an event
+  // it was woken for: its deadline, or the interrupt that notified it
+  void recordWakeDelay(uint32_t since) {
+    addWakeDelay(now() - since);
+  }
+
+  // Same, when the delay was measured some other way
+  void addWakeDelay(uint32_t cycles) {
+    addStat(wakeDelay_, cycles);
+    wakeDelayBuckets_[bucketFor(cycles / cyclesPerMicrosecond())]++;
+  }
+
+  // From an ISR: how long after the hardware saw its event the ISR started.
+  // Only that ISR may call it.
+  LOOP_PROFILER_IRAM void addIsrEntry(uint32_t cycles) {
+    addStat(isrEntry_, cycles);
+    isrEntryBuckets_[bucketFor(cycles / cyclesPerMicrosecond())]++;
+  }
+
+  // Register a named scope once, then time it with ProfileScope.
+  // Returns 0xFF when all scope slots are used.
+  uint8_t addScope(const char *name) {
+    for (uint8_t i = 0; i < LOOP_PROFILER_MAX_SCOPES; i++) {
+      if (scopes_[i].name == NULL || scopes_[i].name == name) {
+        scopes_[i].name = name;
+        return i;
+      }
+    }
+    return 0xFF;
+  }
+
+  void recordScope(uint8_t id, uint32_t cycles) {
+    if (id < LOOP_PROFILER_MAX_SCOPES) {
+      addStat(scopes_[id].stat, cycles);
+    }
+  }
+
+  // In microseconds
+  const Stat &period() const { return period_; }
+  // In cycles
+  const Stat &wakeDelay() const { return wakeDelay_; }
+  // In cycles
+  const Stat &isrEntry() const { return isrEntry_; }
+  const Scope &scope(uint8_t id) const { return scopes_[id]; }
+
+  // Largest difference between two loop periods, in microseconds
+  uint32_t jitter() const {
+    return period_.count ? period_.max - period_.min : 0;
+  }
+
+  void dump(Print &out) const {
+    out.print("[");
+    out.print(name_);
+    out.println("] times in us");
+    printStat(out, "period", period_, 1);
+    if (period_.count) {
+      out.print("  jitter ");
+      out.println(jitter());
+      printBuckets(out, periodBuckets_);
+    }
+    printStat(out, "wake delay", wakeDelay_, cyclesPerMicrosecond());
+    if (wakeDelay_.count) {
+      printBuckets(out, wakeDelayBuckets_);
+    }
+    // Only profilers fed by a capture ISR have it
+    if (isrEntry_.count) {
+      printStat(out, "isr entry", isrEntry_, cyclesPerMicrosecond());
+      printBuckets(out, isrEntryBuckets_);
+    }
+    for (uint8_t i = 0; i < LOOP_PROFILER_MAX_SCOPES && scopes_[i].name; i++) {
+      printStat(out, scopes_[i].name, scopes_[i].stat, cyclesPerMicrosecond());
+    }
+  }
+
+private:
+  static void clearStat(Stat &stat) {
+    stat.count = 0;
+    stat.min = UINT32_MAX;
+    stat.max = 0;
+    stat.total = 0;
+  }
+
+  LOOP_PROFILER_IRAM static void addStat(Stat &stat, uint32_t value) {
+    stat.count++;
+    stat.total += value;
+    if (value < stat.min) {
+      stat.min = value;
+    }
+    if (value > stat.max) {
+      stat.max = value;
+    }
+  }
+
+  // Bucket i holds durations of [2^(i-1), 2^i) microseconds, 0 is under 1 us
+  LOOP_PROFILER_IRAM static uint8_t bucketFor(uint32_t us) {
+    uint8_t bucket = 0;
+    while (us != 0 && bucket < LOOP_PROFILER_BUCKETS - 1) {
+      us >>= 1;
+      bucket++;
+    }
+    return bucket;
+  }
+
+  // `perUs` is the stat's units per microsecond
+  static void printStat(Print &out, const char *label, const Stat &stat, uint32_t perUs) {
+    out.print("  ");
+    out.print(label);
+    out.print(" n ");
+    out.print(stat.count);
+    if (stat.count) {
+      out.print(" min ");
+      out.print(stat.min / perUs);
+      out.print(" avg ");
+      out.print((uint32_t)(stat.total / stat.count / perUs));
+      out.print(" max ");
+      out.print(stat.max / perUs);
+    }
+    out.println();
+  }
+
+  static void printBuckets(Print &out, const uint32_t *buckets) {
+    for (uint8_t i = 0; i < LOOP_PROFILER_BUCKETS; i++) {
+      if (buckets[i] == 0) {
+        continue;
+      }
+      out.print("    <");
+      out.print(1UL << i);
+      out.print(": ");
+      out.println(buckets[i]);
+    }
+  }
+
+  const char *name_;
+  Stat period_;
+  Stat wakeDelay_;
+  Stat isrEntry_;
+  uint32_t periodBuckets_[LOOP_PROFILER_BUCKETS];
+  uint32_t wakeDelayBuckets_[LOOP_PROFILER_BUCKETS];
+  uint32_t isrEntryBuckets_[LOOP_PROFILER_BUCKETS];
+  Scope scopes_[LOOP_PROFILER_MAX_SCOPES] = {};
+  Micros lastTickUs_ = 0;
+  bool ticking_ = false;
+};
+
+// Times the enclosing block into one of a profiler's scopes
+class ProfileScope {
+public:
+  ProfileScope(LoopProfiler &profiler, uint8_t id)
+      : profiler_(profiler), id_(id), start_(LoopProfiler::now()) {}
+
+  ~ProfileScope() {
+    profiler_.recordScope(id_, LoopProfiler::now() - start_);
+  }
+
+private:
+  LoopProfiler &profiler_;
+  uint8_t id_;
+  uint32_t start_;
+};
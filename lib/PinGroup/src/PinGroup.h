@@ -0,0 +1,146 @@
+#pragma once
+
+#include <Arduino.h>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <soc/gpio_struct.h>
+#endif
+
+// A fixed set of output pins written together, with the pin-to-register
+// mapping worked out at compile time.
+//
+//   typedef PinGroup<8, 9, 10, 11> Coils;   // bit 0 = pin 8, bit 1 = pin 9 ...
+//   Coils::begin();
+//   Coils::write(0b0101);                   // pins 8 and 10 high, 9 and 11 low
+//
+// write() costs one masked read-modify-write per port instead of a
+// digitalWrite() (pin table lookups) per pin, and every pin on the same port
+// changes in the same instruction.
+//   AVR    Arduino Uno mapping: D0-D7 PORTD, D8-D13 PORTB, A0-A5 (14-19)
+//          PORTC. Interrupts are held off during the write, so an ISR that
+//          writes another pin of the same port cannot be lost.
+//   ESP32  GPIO.out_w1ts / out_w1tc for GPIO0-31 and out1_w1ts / out1_w1tc
+//          for GPIO32-39, which set and clear without a read.
+//   other  digitalWrite() per pin (the host tests).
+//
+// pattern() can be evaluated at compile time, so a table of patterns can be
+// turned into ready-made register values.
+
+namespace pin_group {
+
+// Arduino Uno pin to port and bit
+enum UnoPort : uint8_t { UNO_PORTB, UNO_PORTC, UNO_PORTD };
+
+constexpr uint8_t unoPort(uint8_t pin) {
+  return pin < 8 ? UNO_PORTD : (pin < 14 ? UNO_PORTB : UNO_PORTC);
+}
+
+constexpr uint8_t unoBit(uint8_t pin) {
+  return pin < 8 ? pin : (pin < 14 ? pin - 8 : pin - 14);
+}
+
+} // namespace pin_group
+
+template <uint8_t... Pins>
+class PinGroup {
+public:
+  static const uint8_t COUNT = sizeof...(Pins);
+  static_assert(COUNT <= 32, "PinGroup holds at most 32 pins");
+
+  // Bits of the port `port` that belong to this group and are set in `bits`
+  static constexpr uint8_t unoBits(uint8_t port, uint32_t bits, uint8_t i = 0) {
+    return i == COUNT ? 0
+                      : (uint8_t)(((pin_group::unoPort(pins_[i]) == port && ((bits >> i) & 1))
+                                       ? 1 << pin_group::unoBit(pins_[i])
+                                       : 0) |
+                                  unoBits(port, bits, i + 1));
+  }
+
+  // Same for the ESP32 output registers: bank 0 is GPIO0-31, bank 1 GPIO32-39
+  static constexpr uint32_t esp32Bits(uint8_t bank, uint32_t bits, uint8_t i = 0) {
+    return i == COUNT ? 0
+                      : ((pins_[i] / 32 == bank && ((bits >> i) & 1)) ? 1UL << (pins_[i] % 32) : 0) |
+                            esp32Bits(bank, bits, i + 1);
+  }
+
+  static const uint32_t ALL = COUNT == 32 ? 0xFFFFFFFFUL : (1UL << COUNT) - 1;
+
+#if defined(__AVR__)
+  struct Pattern {
+    uint8_t b;
+    uint8_t c;
+    uint8_t d;
+  };
+  static constexpr Pattern pattern(uint32_t bits) {
+    return {unoBits(pin_group::UNO_PORTB, bits), unoBits(pin_group::UNO_PORTC, bits),
+            unoBits(pin_group::UNO_PORTD, bits)};
+  }
+#elif defined(ARDUINO_ARCH_ESP32)
+  struct Pattern {
+    uint32_t set0;
+    uint32_t clear0;
+    uint32_t set1;
+    uint32_t clear1;
+  };
+  static constexpr Pattern pattern(uint32_t bits) {
+    return {esp32Bits(0, bits), esp32Bits(0, ALL & ~bits), esp32Bits(1, bits),
+            esp32Bits(1, ALL & ~bits)};
+  }
+#else
+  struct Pattern {
+    uint32_t bits;
+  };
+  static constexpr Pattern pattern(uint32_t bits) {
+    return {bits};
+  }
+#endif
+
+  static void begin() {
+    for (uint8_t i = 0; i < COUNT; i++) {
+      pinMode(pins_[i], OUTPUT);
+    }
+  }
+
+  static void write(uint32_t bits) {
+    write(pattern(bits));
+  }
+
+  static void write(const Pattern &p) {
+#if defined(__AVR__)
+    const uint8_t maskB = unoBits(pin_group::UNO_PORTB, ALL);
+    const uint8_t maskC = unoBits(pin_group::UNO_PORTC, ALL);
+    const uint8_t maskD = unoBits(pin_group::UNO_PORTD, ALL);
+    uint8_t sreg = SREG;
+    cli();
+    if (maskB) {
+      PORTB = (PORTB & ~maskB) | p.b;
+    }
+    if (maskC) {
+      PORTC = (PORTC & ~maskC) | p.c;
+    }
+    if (maskD) {
+      PORTD = (PORTD & ~maskD) | p.d;
+    }
+    SREG = sreg;
+#elif defined(ARDUINO_ARCH_ESP32)
+    if (esp32Bits(0, ALL)) {
+      GPIO.out_w1ts = p.set0;
+      GPIO.out_w1tc = p.clear0;
+    }
+    if (esp32Bits(1, ALL)) {
+      GPIO.out1_w1ts.val = p.set1;
+      GPIO.out1_w1tc.val = p.clear1;
+    }
+#else
+    for (uint8_t i = 0; i < COUNT; i++) {
+      digitalWrite(pins_[i], (p.bits >> i) & 1);
+    }
+#endif
+  }
+
+private:
+  static constexpr uint8_t pins_[COUNT] = {Pins...};
+};
+
+template <uint8_t... Pins>
+constexpr uint8_t PinGroup<Pins...>::pins_[PinGroup<Pins...>::COUNT];
@@ -0,0 +1,27 @@
+#include "RangeFilter.h"
+
+void AlphaBeta::reset(int32_t mm, uint32_t timeMs) {
+  x_ = mm * 256;
+  v_ = 0;
+  lastMs_ = timeMs;
+  started_ = true;
+}
+
+void AlphaBeta::update(int32_t mm, uint32_t timeMs) {
+  uint32_t dt = timeMs - lastMs_;
+  lastMs_ = timeMs;
+  if (dt == 0) {
+    dt = 1;
+  }
+  else if (dt > 1000) {
+    // After a long gap the velocity means nothing; start over
+    reset(mm, timeMs);
+    return;
+  }
+
+  // Predict where it is now, then correct by the error
+  x_ += (int32_t)((int64_t)v_ * dt / 1000);
+  int32_t error = mm * 256 - x_;
+  x_ += (int32_t)((int64_t)error * alpha_ / 256);
+  v_ += (int32_t)((int64_t)error * beta_ * 1000 / (256 * (int64_t)dt));
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Filters for a stream of distance readings, all integer and allocation
+// free. RangeFilter chains them; the stages can also be used on their own.
+//
+//   outlier gate   drops a reading that jumps more than outlierMm from the
+//                  median, unless outlierRun of them in a row agree with the
+//                  first (within outlierMm) to say something really moved;
+//                  then the later stages start over
+//   SlidingMedian  median of the last N readings
+//   AlphaBeta      smoothed distance and velocity
+
+// Median of the last N values (N odd), updated in O(log N) per value.
+//
+// The window is split into two heaps: the smaller half in a max-heap, the
+// larger half in a min-heap, so the median is the top of the first. Each
+// slot of the ring remembers where it sits in the heaps, so the oldest value
+// is replaced in place and sifted, rather than searched for.
+template <uint8_t N>
+class SlidingMedian {
+  static_assert(N % 2 == 1 && N < 128, "window must be odd and under 128");
+
+public:
+  SlidingMedian() { reset(); }
+
+  void reset() {
+    count_ = 0;
+    oldest_ = 0;
+    size_[LOWER] = 0;
+    size_[UPPER] = 0;
+  }
+
+  // Adds a value, dropping the oldest once the window is full. Returns the
+  // new median.
+  int32_t add(int32_t value) {
+    if (count_ < N) {
+      uint8_t slot = count_++;
+      values_[slot] = value;
+      push(size_[LOWER] == 0 || value <= median() ? LOWER : UPPER, slot);
+      // The low half holds the extra value when the count is odd
+      if (size_[LOWER] > size_[UPPER] + 1) {
+        push(UPPER, pop(LOWER));
+      }
+      else if (size_[UPPER] > size_[LOWER]) {
+        push(LOWER, pop(UPPER));
+      }
+      return median();
+    }
+
+    uint8_t slot = oldest_;
+    oldest_ = oldest_ + 1 == N ? 0 : oldest_ + 1;
+    values_[slot] = value;
+    uint8_t heap = heapOf_[slot];
+    siftUp(heap, indexOf_[slot]);
+    siftDown(heap, indexOf_[slot]);
+
+    // Only the new value can be on the wrong side; swapping the two tops
+    // puts it right
+    uint8_t lowTop = heaps_[LOWER][0];
+    uint8_t highTop = heaps_[UPPER][0];
+    if (size_[UPPER] > 0 && values_[lowTop] > values_[highTop]) {
+      place(LOWER, 0, highTop);
+      place(UPPER, 0, lowTop);
+      siftDown(LOWER, 0);
+      siftDown(UPPER, 0);
+    }
+    return median();
+  }
+
+  int32_t median() const { return values_[heaps_[LOWER][0]]; }
+  uint8_t size() const { return count_; }
+
+private:
+  enum { LOWER, UPPER };
+
+  // Whether a belongs above b in the heap
+  bool above(uint8_t heap, int32_t a, int32_t b) const {
+    return heap == LOWER ? a > b : a < b;
+  }
+
+  void place(uint8_t heap, uint8_t index, uint8_t slot) {
+    heaps_[heap][index] = slot;
+    heapOf_[slot] = heap;
+    indexOf_[slot] = index;
+  }
+
+  void push(uint8_t heap, uint8_t slot) {
+    uint8_t index = size_[heap]++;
+    place(heap, index, slot);
+    siftUp(heap, index);
+  }
+
+  uint8_t pop(uint8_t heap) {
+    uint8_t top = heaps_[heap][0];
+    size_[heap]--;
+    if (size_[heap] > 0) {
+      place(heap, 0, heaps_[heap][size_[heap]]);
+      siftDown(heap, 0);
+    }
+    return top;
+  }
+
+  void siftUp(uint8_t heap, uint8_t index) {
+    uint8_t slot = heaps_[heap][index];
+    while (index > 0) {
+      uint8_t parent = (index - 1) / 2;
+      if (!above(heap, values_[slot], values_[heaps_[heap][parent]])) {
+        break;
+      }
+      place(heap, index, heaps_[heap][parent]);
+      index = parent;
+    }
+    place(heap, index, slot);
+  }
+
+  void siftDown(uint8_t heap, uint8_t index) {
+    uint8_t slot = heaps_[heap][index];
+    for (;;) {
+      uint8_t child = 2 * index + 1;
+      if (child >= size_[heap]) {
+        break;
+      }
+      if (child + 1 < size_[heap] &&
+          above(heap, values_[heaps_[heap][child + 1]], values_[heaps_[heap][child]])) {
+        child++;
+      }
+      if (!above(heap, values_[heaps_[heap][child]], values_[slot])) {
+        break;
+      }
+      place(heap, index, heaps_[heap][child]);
+      index = child;
+    }
+    place(heap, index, slot);
+  }
+
+  int32_t values_[N];
+  uint8_t heapOf_[N];  // LOWER or UPPER, per ring slot
+  uint8_t indexOf_[N]; // position in that heap
+  uint8_t heaps_[2][N / 2 + 1];
+  uint8_t size_[2];
+  uint8_t count_;
+  uint8_t oldest_; // ring slot the next value replaces
+};
+
+// Alpha-beta tracker, the steady-state form of a constant-velocity Kalman
+// filter. Each reading corrects the predicted distance by alpha of the error
+// and the velocity by beta of it per unit time. Gains are in 1/256ths; more
+// alpha follows readings faster, more beta picks up speed changes faster.
+//
+// Distance and velocity are kept in 1/256 mm and 1/256 mm/s.
+class AlphaBeta {
+public:
+  AlphaBeta(uint16_t alpha, uint16_t beta) : alpha_(alpha), beta_(beta) {}
+
+  void reset(int32_t mm, uint32_t timeMs);
+  void update(int32_t mm, uint32_t timeMs);
+
+  bool started() const { return started_; }
+  int32_t position() const { return x_ / 256; } // mm
+  int32_t velocity() const { return v_ / 256; } // mm/s, negative when closing in
+
+private:
+  uint16_t alpha_;
+  uint16_t beta_;
+  bool started_ = false;
+  int32_t x_ = 0;
+  int32_t v_ = 0;
+  uint32_t lastMs_ = 0;
+};
+
+// Outlier gate, sliding median and alpha-beta tracker, in that order
+template <uint8_t N>
+class RangeFilter {
+public:
+  struct Config {
+    uint16_t outlierMm; // a jump this far from the median is suspect
+    uint8_t outlierRun; // this many agreeing suspect readings in a row are believed
+    uint16_t alpha;     // tracker gains, 1/256ths
+    uint16_t beta;
+  };
+
+  // 30 cm gate, believed on the third reading; gains for ~15 readings/s
+  RangeFilter() : RangeFilter(Config{300, 3, 128, 32}) {}
+
+  explicit RangeFilter(const Config &config)
+      : config_(config), tracker_(config.alpha, config.beta) {}
+
+  // Returns false when the reading was thrown out as an outlier
+  bool add(int32_t mm, uint32_t timeMs) {
+    if (median_.size() > 0) {
+      int32_t jump = mm - median_.median();
+      if (jump > (int32_t)config_.outlierMm || -jump > (int32_t)config_.outlierMm) {
+        // Wild readings that disagree with each other are not a new target;
+        // the run starts again from this one
+        int32_t spread = mm - suspectMm_;
+        if (suspect_ == 0 || spread > (int32_t)config_.outlierMm ||
+            -spread > (int32_t)config_.outlierMm) {
+          suspect_ = 0;
+          suspectMm_ = mm;
+        }
+        if (++suspect_ < config_.outlierRun) {
+          outliers_++;
+          return false;
+        }
+        // Something really is somewhere else now. The old readings say
+        // nothing about it, so start over from here.
+        median_.reset();
+      }
+    }
+    suspect_ = 0;
+
+    int32_t median = median_.add(mm);
+    if (median_.size() == 1) {
+      tracker_.reset(median, timeMs);
+    }
+    else {
+      tracker_.update(median, timeMs);
+    }
+    return true;
+  }
+
+  bool ready() const { return tracker_.started(); }
+  int32_t distance() const { return tracker_.position(); } // mm
+  int32_t velocity() const { return tracker_.velocity(); } // mm/s
+  uint32_t outliers() const { return outliers_; }
+
+private:
+  Config config_;
+  SlidingMedian<N> median_;
+  AlphaBeta tracker_;
+  uint8_t suspect_ = 0;    // suspect readings in a row
+  int32_t suspectMm_ = 0;  // the first of them
+  uint32_t outliers_ = 0;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+// map() for ranges known at compile time, without the divide, and clamped.
+//
+//   servoPosition = ranged_map<0, 4095, 20, 160>(potPosition);
+//
+// Gives exactly what map() gives for inputs inside the range, and the end
+// of the output range for inputs outside it, so no constrain() is needed
+// after it. Either range may run backwards (255 down to 0, say).
+//
+// The divide by the input span is folded into a multiply and a shift worked
+// out by the compiler. For an input span S, a shift of 2 * bits(S) makes
+// (d * ceil(out span << shift / S)) >> shift equal to d * out span / S for
+// every d from 0 to S (the rounding error stays under 1/S). The multiply is
+// 32 bits whenever the product fits, as it does for 12-bit ADC readings
+// mapped to anything up to 255 wide, and 64 bits otherwise.
+//
+// ranged_map() is constexpr, so it can also fill tables at compile time.
+
+namespace ranged_map_detail {
+
+constexpr uint8_t bitsFor(uint64_t n) {
+  return n == 0 ? 0 : 1 + bitsFor(n >> 1);
+}
+
+constexpr uint64_t span(long from, long to) {
+  return to > from ? (uint64_t)(to - from) : (uint64_t)(from - to);
+}
+
+template <long InMin, long InMax, long OutMin, long OutMax>
+struct Map {
+  static_assert(InMin != InMax, "ranged_map: the input range is empty");
+
+  static constexpr uint64_t inSpan() { return span(InMin, InMax); }
+  static constexpr uint64_t outSpan() { return span(OutMin, OutMax); }
+  static constexpr uint8_t shift() { return 2 * bitsFor(inSpan()); }
+  static constexpr uint64_t factor() { return (outSpan() << shift()) / inSpan() + 1; }
+
+  static_assert(bitsFor(span(OutMin, OutMax)) + 2 * bitsFor(span(InMin, InMax)) < 64,
+                "ranged_map: ranges too wide for a 64-bit multiply");
+
+  // Does the largest product, inSpan * factor, fit in 32 bits?
+  static constexpr bool narrow() { return factor() <= 0xFFFFFFFFULL / inSpan(); }
+
+  // d * outSpan / inSpan for d in 0..inSpan
+  static constexpr uint32_t scale(uint32_t d) {
+    return narrow() ? (uint32_t)(((uint32_t)d * (uint32_t)factor()) >> shift())
+                    : (uint32_t)(((uint64_t)d * factor()) >> shift());
+  }
+
+  static constexpr long fromOffset(uint32_t d) {
+    return OutMax >= OutMin ? OutMin + (long)scale(d) : OutMin - (long)scale(d);
+  }
+
+  static constexpr long apply(long x) {
+    return InMin < InMax ? (x <= InMin ? OutMin : x >= InMax ? OutMax : fromOffset(x - InMin))
+                         : (x >= InMin ? OutMin : x <= InMax ? OutMax : fromOffset(InMin - x));
+  }
+};
+
+} // namespace ranged_map_detail
+
+template <long InMin, long InMax, long OutMin, long OutMax>
+constexpr long ranged_map(long x) {
+  return ranged_map_detail::Map<InMin, InMax, OutMin, OutMax>::apply(x);
+}
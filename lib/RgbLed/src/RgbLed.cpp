@@ -0,0 +1,136 @@
+#include "RgbLed.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <driver/ledc.h>
+#endif
+
+#define RGB_GAMMA_4(i) gammaDuty(i), gammaDuty(i + 1), gammaDuty(i + 2), gammaDuty(i + 3)
+#define RGB_GAMMA_16(i) RGB_GAMMA_4(i), RGB_GAMMA_4(i + 4), RGB_GAMMA_4(i + 8), RGB_GAMMA_4(i + 12)
+
+const uint16_t RgbLed::GAMMA[256] = {
+  RGB_GAMMA_16(0),   RGB_GAMMA_16(16),  RGB_GAMMA_16(32),  RGB_GAMMA_16(48),
+  RGB_GAMMA_16(64),  RGB_GAMMA_16(80),  RGB_GAMMA_16(96),  RGB_GAMMA_16(112),
+  RGB_GAMMA_16(128), RGB_GAMMA_16(144), RGB_GAMMA_16(160), RGB_GAMMA_16(176),
+  RGB_GAMMA_16(192), RGB_GAMMA_16(208), RGB_GAMMA_16(224), RGB_GAMMA_16(240),
+};
+
+static_assert(RgbLed::gammaDuty(0) == 0 && RgbLed::gammaDuty(255) == RgbLed::MAX_DUTY,
+              "gamma table must span the full duty range");
+
+uint8_t RgbLed::channelsUsed_ = 0;
+
+// Low-speed channels in the LEDC
+static const uint8_t LOW_SPEED_CHANNELS = 8;
+
+RgbLed::RgbLed(uint8_t redPin, uint8_t greenPin, uint8_t bluePin) {
+  pins_[0] = redPin;
+  pins_[1] = greenPin;
+  pins_[2] = bluePin;
+}
+
+bool RgbLed::begin(UBaseType_t priority, BaseType_t core) {
+  if (channelsUsed_ + 3 > LOW_SPEED_CHANNELS) {
+    return false;
+  }
+  firstChannel_ = channelsUsed_;
+  channelsUsed_ += 3;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  ledc_timer_config_t timer = {};
+  timer.speed_mode = LEDC_LOW_SPEED_MODE;
+  timer.duty_resolution = (ledc_timer_bit_t)RGB_LED_BITS;
+  timer.timer_num = (ledc_timer_t)RGB_LED_TIMER;
+  timer.freq_hz = RGB_LED_FREQ_HZ;
+  timer.clk_cfg = LEDC_AUTO_CLK;
+  if (ledc_timer_config(&timer) != ESP_OK) {
+    return false;
+  }
+
+  for (uint8_t i = 0; i < 3; i++) {
+    ledc_channel_config_t channel = {};
+    channel.gpio_num = pins_[i];
+    channel.speed_mode = LEDC_LOW_SPEED_MODE;
+    channel.channel = (ledc_channel_t)(firstChannel_ + i);
+    channel.timer_sel = (ledc_timer_t)RGB_LED_TIMER;
+    channel.duty = 0;
+    if (ledc_channel_config(&channel) != ESP_OK) {
+      return false;
+    }
+  }
+
+  // Already installed is fine: a second RgbLed shares the fade service
+  esp_err_t err = ledc_fade_func_install(0);
+  if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {
+    return false;
+  }
+#endif
+
+  mailbox_ = xQueueCreate(1, sizeof(Target));
+  if (mailbox_ == NULL) {
+    return false;
+  }
+#if defined(ARDUINO_ARCH_ESP32)
+  return xTaskCreatePinnedToCore(taskMain, "rgb", 2048, this, priority, NULL, core) == pdPASS;
+#else
+  // No task on the host: service() stands in for it
+  return true;
+#endif
+}
+
+void RgbLed::setColor(uint8_t red, uint8_t green, uint8_t blue, uint16_t fadeMs) {
+  if (red == target_.color.red && green == target_.color.green && blue == target_.color.blue) {
+    return;
+  }
+  target_.color.red = red;
+  target_.color.green = green;
+  target_.color.blue = blue;
+  target_.fadeMs = fadeMs;
+  if (mailbox_ != NULL) {
+    xQueueOverwrite(mailbox_, &target_);
+  }
+}
+
+#if defined(ARDUINO_ARCH_ESP32)
+void RgbLed::taskMain(void *arg) {
+  RgbLed *self = static_cast<RgbLed *>(arg);
+  Target target;
+
+  for (;;) {
+    if (xQueueReceive(self->mailbox_, &target, portMAX_DELAY) == pdTRUE) {
+      self->apply(target);
+    }
+  }
+}
+
+void RgbLed::apply(const Target &target) {
+  const uint8_t levels[3] = {target.color.red, target.color.green, target.color.blue};
+
+  for (uint8_t i = 0; i < 3; i++) {
+    ledc_channel_t channel = (ledc_channel_t)(firstChannel_ + i);
+    uint32_t duty = GAMMA[levels[i]];
+    // Both wait for a fade still running on the channel, here in the task
+    if (target.fadeMs == 0) {
+      ledc_set_duty(LEDC_LOW_SPEED_MODE, channel, duty);
+      ledc_update_duty(LEDC_LOW_SPEED_MODE, channel);
+    }
+    else {
+      ledc_set_fade_with_time(LEDC_LOW_SPEED_MODE, channel, duty, target.fadeMs);
+      ledc_fade_start(LEDC_LOW_SPEED_MODE, channel, LEDC_FADE_NO_WAIT);
+    }
+  }
+}
+#else
+bool RgbLed::service() {
+  Target target;
+  if (mailbox_ == NULL || xQueueReceive(mailbox_, &target, 0) != pdTRUE) {
+    return false;
+  }
+  apply(target);
+  return true;
+}
+
+void RgbLed::apply(const Target &target) {
+  // No LEDC on the host: the target is only recorded
+  applied_ = target;
+}
+#endif
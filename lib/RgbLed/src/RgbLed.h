@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// PWM resolution. 13 bits is the most the LEDC gives at 5 kHz (80 MHz APB),
+// and keeps the dim end of the gamma curve from collapsing into a few steps.
+#ifndef RGB_LED_BITS
+#define RGB_LED_BITS 13
+#endif
+
+#ifndef RGB_LED_FREQ_HZ
+#define RGB_LED_FREQ_HZ 5000
+#endif
+
+// LEDC low-speed timer the LEDs share
+#ifndef RGB_LED_TIMER
+#define RGB_LED_TIMER 3
+#endif
+
+// Common-cathode RGB LED on the ESP32's LEDC, with hardware fades.
+//
+// Colors are 0-255 per channel as before, and go through a gamma table so
+// equal steps look like equal changes in brightness. GAMMA is the CIE 1931
+// lightness curve scaled to RGB_LED_BITS, worked out by the compiler and
+// kept in flash.
+//
+// setColor() only posts the target to a one-slot mailbox. A small task
+// hands it to the LEDC fade engine, which ramps the duty in hardware, so a
+// fade takes no CPU time once started. The ESP32 cannot change a channel's
+// duty while it is fading: a color set mid-fade starts when the fade ends,
+// and any set in between are skipped.
+//
+// The host build has the mailbox but no task or LEDC: service() does what
+// the task would with one posted target, and applied() shows what it got.
+//
+// The sketches' own ledcSetup() channels (0-7, and channel 0 for tone())
+// are the LEDC's high-speed group. RgbLeds take low-speed channels instead,
+// three per LED from 0 up, which Arduino numbers 8-15, on low-speed timer
+// RGB_LED_TIMER. So at most two RgbLeds.
+class RgbLed {
+public:
+  static const uint8_t BITS = RGB_LED_BITS;
+  static const uint16_t MAX_DUTY = (1 << RGB_LED_BITS) - 1;
+
+  // Duty for each 0-255 level
+  static const uint16_t GAMMA[256];
+
+  // CIE 1931: L* 0-100 to relative luminance 0-1
+  static constexpr double luminance(double lightness) {
+    return lightness <= 8 ? lightness / 903.3
+                          : ((lightness + 16) / 116) * ((lightness + 16) / 116) * ((lightness + 16) / 116);
+  }
+
+  static constexpr uint16_t gammaDuty(uint8_t level) {
+    return (uint16_t)(luminance(level * 100.0 / 255) * MAX_DUTY + 0.5);
+  }
+
+  struct Color {
+    uint8_t red;
+    uint8_t green;
+    uint8_t blue;
+  };
+
+  // What setColor() posts to the task
+  struct Target {
+    Color color;
+    uint16_t fadeMs;
+  };
+
+  RgbLed(uint8_t redPin, uint8_t greenPin, uint8_t bluePin);
+
+  // Sets up the timer and channels with the LED off and starts the task.
+  // Returns false when no channels are left or the LEDC refuses.
+  bool begin(UBaseType_t priority = 1, BaseType_t core = 0);
+
+  // Goes to the color over `fadeMs`, or straight away for 0. Setting the
+  // color it is already going to does nothing.
+  void setColor(uint8_t red, uint8_t green, uint8_t blue, uint16_t fadeMs = 0);
+  void off(uint16_t fadeMs = 0) { setColor(0, 0, 0, fadeMs); }
+
+  // Color most recently asked for
+  Color color() const { return target_.color; }
+
+#if !defined(ARDUINO_ARCH_ESP32)
+  // Hands the posted target, if there is one, to apply(). Returns false
+  // when nothing was posted.
+  bool service();
+  // Target apply() last got
+  Target applied() const { return applied_; }
+  // Gives every channel back, so each test can start with none used
+  static void resetChannels() { channelsUsed_ = 0; }
+#endif
+
+private:
+  static void taskMain(void *arg);
+  void apply(const Target &target);
+
+  uint8_t pins_[3];
+  uint8_t firstChannel_ = 0;
+  Target target_ = {};
+  QueueHandle_t mailbox_ = NULL;
+#if !defined(ARDUINO_ARCH_ESP32)
+  Target applied_ = {};
+#endif
+
+  static uint8_t channelsUsed_;
+};
@@ -0,0 +1,162 @@
+#include "Scheduler.h"
+
+uint8_t Scheduler::every(unsigned long period, Callback callback, unsigned long now) {
+  if (period == 0) {
+    return NO_TASK;
+  }
+  return arm(create(period, callback), now + period);
+}
+
+uint8_t Scheduler::after(unsigned long delay, Callback callback, unsigned long now) {
+  return arm(create(0, callback), now + delay);
+}
+
+uint8_t Scheduler::add(Callback callback) {
+  return create(0, callback);
+}
+
+uint8_t Scheduler::create(unsigned long period, Callback callback) {
+  if (taskCount_ >= SCHEDULER_MAX_TASKS) {
+    return NO_TASK;
+  }
+  uint8_t id = taskCount_++;
+  Task &task = tasks_[id];
+  task.callback = callback;
+  task.deadline = 0;
+  task.period = period;
+  task.heapIndex = NO_TASK;
+  task.stats.runs = 0;
+  task.stats.overruns = 0;
+  task.stats.maxLate = 0;
+  return id;
+}
+
+uint8_t Scheduler::arm(uint8_t id, unsigned long deadline) {
+  if (id != NO_TASK) {
+    tasks_[id].deadline = deadline;
+    push(id);
+  }
+  return id;
+}
+
+void Scheduler::restart(uint8_t id, unsigned long delay, unsigned long now) {
+  if (id >= taskCount_) {
+    return;
+  }
+  remove(id);
+  tasks_[id].deadline = now + delay;
+  push(id);
+}
+
+void Scheduler::cancel(uint8_t id) {
+  if (id < taskCount_) {
+    remove(id);
+  }
+}
+
+bool Scheduler::pending(uint8_t id) const {
+  return id < taskCount_ && tasks_[id].heapIndex != NO_TASK;
+}
+
+unsigned long Scheduler::nextDeadline() const {
+  return tasks_[heap_[0]].deadline;
+}
+
+unsigned long Scheduler::run(unsigned long now, unsigned long idleLimit) {
+  while (heapSize_ > 0) {
+    uint8_t id = heap_[0];
+    Task &task = tasks_[id];
+    unsigned long late = now - task.deadline;
+    if ((long)late < 0) {
+      break;
+    }
+
+    task.stats.runs++;
+    if (late > task.stats.maxLate) {
+      task.stats.maxLate = late;
+    }
+
+    // Reschedule before the callback, so it can restart or cancel itself
+    remove(id);
+    if (task.period != 0) {
+      unsigned long missed = late / task.period;
+      task.stats.overruns += missed;
+      task.deadline += (missed + 1) * task.period;
+      push(id);
+    }
+    task.callback();
+  }
+
+  if (heapSize_ == 0) {
+    return idleLimit;
+  }
+  long wait = (long)(nextDeadline() - now);
+  if (wait <= 0) {
+    return 0;
+  }
+  return (unsigned long)wait < idleLimit ? wait : idleLimit;
+}
+
+void Scheduler::push(uint8_t id) {
+  uint8_t index = heapSize_++;
+  place(index, id);
+  siftUp(index);
+}
+
+void Scheduler::remove(uint8_t id) {
+  uint8_t index = tasks_[id].heapIndex;
+  if (index == NO_TASK) {
+    return;
+  }
+  tasks_[id].heapIndex = NO_TASK;
+  heapSize_--;
+  if (index == heapSize_) {
+    return;
+  }
+  // Fill the hole with the last task, which may belong above or below it
+  uint8_t moved = heap_[heapSize_];
+  place(index, moved);
+  siftUp(index);
+  siftDown(tasks_[moved].heapIndex);
+}
+
+bool Scheduler::before(uint8_t a, uint8_t b) const {
+  return (long)(tasks_[a].deadline - tasks_[b].deadline) < 0;
+}
+
+void Scheduler::siftUp(uint8_t index) {
+  uint8_t id = heap_[index];
+  while (index > 0) {
+    uint8_t parent = (index - 1) / 2;
+    if (!before(id, heap_[parent])) {
+      break;
+    }
+    place(index, heap_[parent]);
+    index = parent;
+  }
+  place(index, id);
+}
+
+void Scheduler::siftDown(uint8_t index) {
+  uint8_t id = heap_[index];
+  for (;;) {
+    uint8_t child = 2 * index + 1;
+    if (child >= heapSize_) {
+      break;
+    }
+    if (child + 1 < heapSize_ && before(heap_[child + 1], heap_[child])) {
+      child++;
+    }
+    if (!before(heap_[child], id)) {
+      break;
+    }
+    place(index, heap_[child]);
+    index = child;
+  }
+  place(index, id);
+}
+
+void Scheduler::place(uint8_t index, uint8_t id) {
+  heap_[index] = id;
+  tasks_[id].heapIndex = index;
+}
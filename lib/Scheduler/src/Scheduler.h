@@ -0,0 +1,93 @@
+#pragma once
+
+#include <Arduino.h>
+
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+// Runs callbacks at deadlines instead of every pass of loop() checking
+// `if (now - lastX >= period)` for each of them.
+//
+// Tasks sit in a binary min-heap ordered by deadline, so the next deadline is
+// the root (O(1)) and adding, running or cancelling a task is O(log n). Slots
+// are fixed at SCHEDULER_MAX_TASKS, nothing is allocated.
+//
+// Times are in whatever unit the caller passes as `now` (millis() in the
+// sketches) and may wrap. Deadlines are compared by their difference, so they
+// must stay within half the range of unsigned long of `now`.
+//
+//   periodic  runs every period. Deadlines advance by whole periods, so a late
+//             run does not push the rest later. When a run is so late that
+//             whole periods went by, those runs are skipped and counted as
+//             overruns.
+//   one-shot  runs once, then keeps its slot so restart() can arm it again.
+//             add() makes one that waits for restart() from the start.
+//
+// Callbacks may add, restart or cancel tasks, including their own.
+class Scheduler {
+public:
+  typedef void (*Callback)();
+
+  static const uint8_t NO_TASK = 0xFF;
+
+  struct Stats {
+    uint32_t runs;
+    uint32_t overruns; // periods skipped because a run came too late
+    unsigned long maxLate; // latest a run started after its deadline
+  };
+
+  // Runs `callback` every `period`, first one period from `now`.
+  // Returns the task id, or NO_TASK when all slots are used.
+  uint8_t every(unsigned long period, Callback callback, unsigned long now);
+
+  // Runs `callback` once, `delay` from `now`
+  uint8_t after(unsigned long delay, Callback callback, unsigned long now);
+
+  // A one-shot task that does not run until restart() arms it
+  uint8_t add(Callback callback);
+
+  // Arms a task to run next `delay` from `now`, whether or not it was pending.
+  // A periodic task carries on with its period from there.
+  void restart(uint8_t id, unsigned long delay, unsigned long now);
+
+  // Stops a task from running until it is restarted
+  void cancel(uint8_t id);
+
+  bool pending(uint8_t id) const;
+
+  // Runs every task that is due, in deadline order. Returns how long until
+  // the next deadline, 0 when one is already due again, or `idleLimit` when
+  // nothing is pending (or the next deadline is further away).
+  unsigned long run(unsigned long now, unsigned long idleLimit = 1000);
+
+  // Deadline of the next task due; only meaningful when pendingCount() > 0
+  unsigned long nextDeadline() const;
+  uint8_t pendingCount() const { return heapSize_; }
+
+  const Stats &stats(uint8_t id) const { return tasks_[id].stats; }
+
+private:
+  struct Task {
+    Callback callback;
+    unsigned long deadline;
+    unsigned long period; // 0 for one-shot
+    uint8_t heapIndex;    // NO_TASK when not pending
+    Stats stats;
+  };
+
+  // Takes a slot for a task, not yet pending
+  uint8_t create(unsigned long period, Callback callback);
+  uint8_t arm(uint8_t id, unsigned long deadline);
+  void push(uint8_t id);
+  void remove(uint8_t id);
+  bool before(uint8_t a, uint8_t b) const;
+  void siftUp(uint8_t index);
+  void siftDown(uint8_t index);
+  void place(uint8_t index, uint8_t id);
+
+  Task tasks_[SCHEDULER_MAX_TASKS];
+  uint8_t heap_[SCHEDULER_MAX_TASKS]; // task ids
+  uint8_t taskCount_ = 0;
+  uint8_t heapSize_ = 0;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Sits in front of a hobby servo and only calls its write() when the pulse
+// actually has to change.
+//
+// Servo::write() is not free: on AVR it turns interrupts off while it updates
+// the Timer1 pulse table, on ESP32 it reprograms an LEDC channel. Sketches
+// that write the same angle every pass, or a mapped ADC reading that flickers
+// by a degree, pay for that and make the servo chatter.
+//
+//   deadband   a new target within this many degrees of the current one is
+//              ignored, which filters out ADC noise. 0 still skips writing
+//              the same angle twice.
+//   slew rate  degrees per second the servo is walked towards its target.
+//              update() does the walking and is meant to run from a periodic
+//              scheduler task (every 20 ms, one servo frame, is plenty).
+//              0 sends targets straight to the servo.
+//
+// Works with Servo (AVR) and ESP32Servo, or anything with write(int).
+template <class ServoT>
+class SmoothServo {
+public:
+  enum { MAX_STEP_MS = 100 };
+
+  explicit SmoothServo(ServoT &servo, uint8_t deadband = 0, uint16_t slewRate = 0)
+      : servo_(servo), deadband_(deadband), slewRate_(slewRate) {}
+
+  void setDeadband(uint8_t degrees) { deadband_ = degrees; }
+  void setSlewRate(uint16_t degreesPerSecond) { slewRate_ = degreesPerSecond; }
+
+  // Moves to `angle` now, whatever the deadband or slew rate. Use it once to
+  // say where the servo starts.
+  void jumpTo(int angle) {
+    target_ = angle;
+    position_ = (long)angle * 1000;
+    send(angle);
+  }
+
+  // Sets where the servo should go
+  void write(int angle) {
+    if (!started_) {
+      jumpTo(angle);
+      return;
+    }
+    int change = angle > target_ ? angle - target_ : target_ - angle;
+    if (change <= deadband_) {
+      return;
+    }
+    target_ = angle;
+    if (slewRate_ == 0) {
+      position_ = (long)angle * 1000;
+      send(angle);
+    }
+  }
+
+  // Walks the servo towards its target for the time since the last call.
+  // Returns true while it is still on its way.
+  bool update(unsigned long nowMs) {
+    unsigned long elapsed = nowMs - lastUpdate_;
+    lastUpdate_ = nowMs;
+    long target = (long)target_ * 1000;
+    if (!started_ || position_ == target) {
+      return false;
+    }
+    if (slewRate_ == 0) {
+      position_ = target;
+    }
+    else {
+      // Degrees per second times milliseconds is millidegrees. A long gap
+      // since the last call (the first one, or a stalled loop) counts as
+      // MAX_STEP_MS so the servo does not leap.
+      long step = (long)slewRate_ * (long)(elapsed < MAX_STEP_MS ? elapsed : (unsigned long)MAX_STEP_MS);
+      if (position_ < target) {
+        position_ = position_ + step < target ? position_ + step : target;
+      }
+      else {
+        position_ = position_ - step > target ? position_ - step : target;
+      }
+    }
+    int angle = (int)((position_ + (position_ < 0 ? -500 : 500)) / 1000);
+    if (angle != written_) {
+      send(angle);
+    }
+    return position_ != target;
+  }
+
+  int target() const { return target_; }
+  int read() const { return written_; }
+  bool moving() const { return position_ != (long)target_ * 1000; }
+
+  // How many times write() or update() actually reached the servo
+  uint32_t writes() const { return writes_; }
+
+private:
+  void send(int angle) {
+    servo_.write(angle);
+    written_ = angle;
+    started_ = true;
+    writes_++;
+  }
+
+  ServoT &servo_;
+  uint8_t deadband_;
+  uint16_t slewRate_;
+  bool started_ = false;
+  int target_ = 0;
+  int written_ = 0;
+  long position_ = 0; // millidegrees
+  unsigned long lastUpdate_ = 0;
+  uint32_t writes_ = 0;
+};
@@ -0,0 +1,193 @@
+#include "SpeedStats.h"
+
+#include <string.h>
+
+SpeedStats::SpeedStats() {
+  reset();
+}
+
+void SpeedStats::reset() {
+  count_ = 0;
+  mean_ = 0;
+  m2_ = 0;
+  min_ = UINT16_MAX;
+  max_ = 0;
+  memset(histogram_, 0, sizeof(histogram_));
+  memset(minutes_, 0, sizeof(minutes_));
+}
+
+uint16_t SpeedStats::bucketOf(uint16_t value) {
+  if (value < 2 * SUB_COUNT) {
+    return value;
+  }
+  uint8_t shift = (31 - __builtin_clz(value)) - SUB_BITS;
+  return shift * SUB_COUNT + (value >> shift);
+}
+
+uint16_t SpeedStats::bucketLow(uint16_t bucket) {
+  if (bucket < 2 * SUB_COUNT) {
+    return bucket;
+  }
+  uint8_t shift = bucket / SUB_COUNT - 1;
+  return (bucket - shift * SUB_COUNT) << shift;
+}
+
+uint16_t SpeedStats::bucketHigh(uint16_t bucket) {
+  if (bucket < 2 * SUB_COUNT) {
+    return bucket;
+  }
+  uint8_t shift = bucket / SUB_COUNT - 1;
+  return bucketLow(bucket) + ((1 << shift) - 1);
+}
+
+void SpeedStats::add(uint32_t centiKmh, uint32_t nowMs) {
+  uint16_t value = centiKmh > UINT16_MAX ? UINT16_MAX : centiKmh;
+
+  // Welford, with the divide rounded to nearest so the mean does not drift
+  int64_t scaled = (int64_t)value << MEAN_SHIFT;
+  count_++;
+  int64_t delta = scaled - mean_;
+  mean_ += delta >= 0 ? (delta + count_ / 2) / count_ : (delta - count_ / 2) / count_;
+  int64_t product = delta * (scaled - mean_); // scaled twice over
+  m2_ += (product + (1 << (2 * MEAN_SHIFT - 1))) >> (2 * MEAN_SHIFT);
+
+  if (value < min_) {
+    min_ = value;
+  }
+  if (value > max_) {
+    max_ = value;
+  }
+
+  uint16_t &bucket = histogram_[bucketOf(value)];
+  if (bucket < UINT16_MAX) {
+    bucket++;
+  }
+
+  uint32_t minuteNumber = nowMs / 60000;
+  Minute &slot = minutes_[minuteNumber % MINUTES];
+  if (slot.minute != minuteNumber || slot.count == 0) {
+    slot.minute = minuteNumber;
+    slot.count = 0;
+    slot.maxCentiKmh = 0;
+    slot.sumCentiKmh = 0;
+  }
+  if (slot.count < UINT16_MAX) {
+    slot.count++;
+  }
+  slot.sumCentiKmh += value;
+  if (value > slot.maxCentiKmh) {
+    slot.maxCentiKmh = value;
+  }
+}
+
+uint16_t SpeedStats::mean() const {
+  return (uint16_t)((mean_ + (1 << (MEAN_SHIFT - 1))) >> MEAN_SHIFT);
+}
+
+// Square root rounded to nearest, by the digit-by-digit method
+static uint32_t roundedSqrt(uint64_t value) {
+  uint64_t root = 0;
+  uint64_t bit = 1ULL << 62;
+  while (bit > value) {
+    bit >>= 2;
+  }
+  uint64_t rest = value;
+  while (bit != 0) {
+    if (rest >= root + bit) {
+      rest -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  // (root + 0.5)^2 = root^2 + root + 0.25
+  return (uint32_t)(rest > root ? root + 1 : root);
+}
+
+uint16_t SpeedStats::stddev() const {
+  if (count_ < 2 || m2_ <= 0) {
+    return 0;
+  }
+  uint64_t variance = ((uint64_t)m2_ + (count_ - 1) / 2) / (count_ - 1);
+  uint32_t root = roundedSqrt(variance);
+  return root > UINT16_MAX ? UINT16_MAX : root;
+}
+
+uint16_t SpeedStats::percentile(uint8_t percent) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // Rank of the wanted car, rounded up so p100 is the fastest one
+  uint32_t total = 0;
+  for (uint16_t i = 0; i < BUCKETS; i++) {
+    total += histogram_[i];
+  }
+  uint32_t rank = (total * percent + 99) / 100;
+  if (rank == 0) {
+    rank = 1;
+  }
+  if (rank >= total) {
+    return max_;
+  }
+
+  uint32_t seen = 0;
+  for (uint16_t i = 0; i < BUCKETS; i++) {
+    seen += histogram_[i];
+    if (seen >= rank) {
+      // Middle of the bucket, kept inside what was actually measured
+      uint16_t value = bucketLow(i) + (bucketHigh(i) - bucketLow(i)) / 2;
+      return constrain(value, min_, max_);
+    }
+  }
+  return max_;
+}
+
+SpeedStats::Minute SpeedStats::minute(uint32_t nowMs, uint8_t minutesAgo) const {
+  uint32_t wanted = nowMs / 60000 - minutesAgo;
+  Minute slot = minutes_[wanted % MINUTES];
+  if (minutesAgo >= MINUTES || slot.minute != wanted) {
+    slot.minute = wanted;
+    slot.count = 0;
+    slot.maxCentiKmh = 0;
+    slot.sumCentiKmh = 0;
+  }
+  return slot;
+}
+
+uint16_t SpeedStats::carsPerMinute(uint32_t nowMs) const {
+  return minute(nowMs, 1).count;
+}
+
+SpeedStats::Summary SpeedStats::summary(uint32_t nowMs) const {
+  Summary s;
+  s.count = count_;
+  s.meanCentiKmh = mean();
+  s.stddevCentiKmh = stddev();
+  s.minCentiKmh = minSpeed();
+  s.maxCentiKmh = maxSpeed();
+  s.p50CentiKmh = percentile(50);
+  s.p85CentiKmh = percentile(85);
+  s.carsLastMinute = carsPerMinute(nowMs);
+  return s;
+}
+
+void SpeedStats::print(Print &out, const Summary &s) {
+  out.print("stats n=");
+  out.print(s.count);
+  out.print(" mean=");
+  out.print(s.meanCentiKmh / 100.0, 2);
+  out.print(" sd=");
+  out.print(s.stddevCentiKmh / 100.0, 2);
+  out.print(" min=");
+  out.print(s.minCentiKmh / 100.0, 2);
+  out.print(" max=");
+  out.print(s.maxCentiKmh / 100.0, 2);
+  out.print(" p50=");
+  out.print(s.p50CentiKmh / 100.0, 2);
+  out.print(" p85=");
+  out.print(s.p85CentiKmh / 100.0, 2);
+  out.print(" cpm=");
+  out.println(s.carsLastMinute);
+}
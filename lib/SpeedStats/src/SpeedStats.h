@@ -0,0 +1,83 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Running statistics over measured vehicle speeds, in fixed RAM.
+//
+// Speeds are in 0.01 km/h. Count, mean and variance are kept with Welford's
+// update in integers (the ESP32 has no double precision FPU): the mean in
+// 1/256 of a unit and the sum of squared differences in whole units squared,
+// which holds 2^31 cars even at the widest spread. Percentiles come from a log-bucketed (HDR style) histogram with
+// about 3% resolution, and a ring keeps one aggregate per minute for the last
+// hour. Nothing allocates, and add() is constant time.
+class SpeedStats {
+public:
+  static const uint8_t MINUTES = 60;
+
+  // Everything a report needs, small enough to pass through a queue
+  struct Summary {
+    uint32_t count;
+    uint16_t meanCentiKmh;
+    uint16_t stddevCentiKmh;
+    uint16_t minCentiKmh;
+    uint16_t maxCentiKmh;
+    uint16_t p50CentiKmh;
+    uint16_t p85CentiKmh;
+    uint16_t carsLastMinute;
+  };
+
+  struct Minute {
+    uint32_t minute;      // millis() / 60000 this slot belongs to
+    uint16_t count;
+    uint16_t maxCentiKmh;
+    uint32_t sumCentiKmh;
+  };
+
+  SpeedStats();
+
+  void reset();
+  void add(uint32_t centiKmh, uint32_t nowMs);
+
+  uint32_t count() const { return count_; }
+  uint16_t mean() const;
+  uint16_t stddev() const;
+  uint16_t minSpeed() const { return count_ ? min_ : 0; }
+  uint16_t maxSpeed() const { return max_; }
+
+  // Speed below which `percent` of cars were measured, e.g. 85
+  uint16_t percentile(uint8_t percent) const;
+
+  // Cars in the last complete minute
+  uint16_t carsPerMinute(uint32_t nowMs) const;
+
+  // Aggregate for `minutesAgo` complete minutes back (1 = last minute).
+  // Minutes without cars come back with count 0.
+  Minute minute(uint32_t nowMs, uint8_t minutesAgo) const;
+
+  Summary summary(uint32_t nowMs) const;
+
+  // One line: "stats n=.. mean=.. sd=.. min=.. max=.. p50=.. p85=.. cpm=.."
+  static void print(Print &out, const Summary &summary);
+
+private:
+  // Values below 2^SUB_BITS get one bucket each, above that every power of
+  // two is split into 2^SUB_BITS buckets
+  static const uint8_t SUB_BITS = 5;
+  static const uint16_t SUB_COUNT = 1 << SUB_BITS;
+  static const uint16_t BUCKETS = (16 - SUB_BITS + 1) * SUB_COUNT;
+
+  // Fraction bits of mean_
+  static const uint8_t MEAN_SHIFT = 8;
+
+  static uint16_t bucketOf(uint16_t value);
+  static uint16_t bucketLow(uint16_t bucket);
+  static uint16_t bucketHigh(uint16_t bucket);
+
+  uint32_t count_;
+  int64_t mean_; // 1/256 centi-km/h
+  int64_t m2_;   // (centi-km/h)^2
+  uint16_t min_;
+  uint16_t max_;
+  uint16_t histogram_[BUCKETS];
+  Minute minutes_[MINUTES];
+};
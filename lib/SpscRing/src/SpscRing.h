@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Single-producer / single-consumer ring buffer.
+//
+// One side (usually an interrupt) only calls push(), the other side only
+// calls pop(). Neither side ever blocks or disables interrupts, so it is safe
+// to use between an ISR and loop(). N must be a power of two.
+//
+// Each index must be read and written in one instruction. On AVR that means
+// 8-bit indices, so N is at most 128 there; the indices wrap at 256, which N
+// divides.
+template <typename T, size_t N>
+class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+#if defined(__AVR__)
+  typedef uint8_t Index;
+  static_assert(N <= 128, "SpscRing on AVR holds at most 128 items");
+#else
+  typedef size_t Index;
+#endif
+
+public:
+  // Producer side. Returns false (and counts a drop) when the ring is full.
+  bool push(const T &item) {
+    Index head = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+    Index tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+    if ((Index)(head - tail) >= N) {
+      dropped_++;
+      return false;
+    }
+    items_[head & (N - 1)] = item;
+    __atomic_store_n(&head_, (Index)(head + 1), __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer side. Returns false when the ring is empty.
+  bool pop(T &item) {
+    Index tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+    Index head = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+    if (head == tail) {
+      return false;
+    }
+    item = items_[tail & (N - 1)];
+    __atomic_store_n(&tail_, (Index)(tail + 1), __ATOMIC_RELEASE);
+    return true;
+  }
+
+  // Consumer side. Pops up to maxItems in one go and returns how many.
+  size_t popBatch(T *out, size_t maxItems) {
+    Index tail = __atomic_load_n(&tail_, __ATOMIC_RELAXED);
+    Index head = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+    size_t count = (Index)(head - tail);
+    if (count > maxItems) {
+      count = maxItems;
+    }
+    for (size_t i = 0; i < count; i++) {
+      out[i] = items_[(tail + i) & (N - 1)];
+    }
+    __atomic_store_n(&tail_, (Index)(tail + count), __ATOMIC_RELEASE);
+    return count;
+  }
+
+  size_t size() const {
+    return (Index)(__atomic_load_n(&head_, __ATOMIC_ACQUIRE) - __atomic_load_n(&tail_, __ATOMIC_ACQUIRE));
+  }
+
+  bool empty() const { return size() == 0; }
+
+  size_t capacity() const { return N; }
+
+  // Number of pushes rejected because the ring was full
+  uint32_t dropped() const { return dropped_; }
+
+private:
+  T items_[N];
+  Index head_ = 0;  // written by the producer only
+  Index tail_ = 0;  // written by the consumer only
+  volatile uint32_t dropped_ = 0;
+};
@@ -0,0 +1,294 @@
+#include "StepperEngine.h"
+
+// Bit n = INn+1. Full steps are the even half steps.
+static const uint8_t fullStepSequence[4] = {0b0101, 0b0110, 0b1010, 0b1001};
+static const uint8_t halfStepSequence[8] = {0b0101, 0b0100, 0b0110, 0b0010,
+                                            0b1010, 0b1000, 0b1001, 0b0001};
+
+static_assert((STEPPER_ENGINE_MICROSTEPS & (STEPPER_ENGINE_MICROSTEPS - 1)) == 0 &&
+                  STEPPER_ENGINE_MICROSTEPS >= 2 && STEPPER_ENGINE_MICROSTEPS <= 64,
+              "STEPPER_ENGINE_MICROSTEPS must be a power of two from 2 to 64");
+
+StepperEngine steppers;
+
+#if defined(__AVR__)
+// 16 MHz / 8 = 2 ticks per microsecond, and OCR2A is 8 bits
+static_assert(F_CPU / 8000000UL * STEPPER_ENGINE_TICK_US <= 256,
+              "STEPPER_ENGINE_TICK_US too long for Timer2");
+
+ISR(TIMER2_COMPA_vect) {
+  steppers.tick();
+}
+#endif
+
+int8_t StepperEngine::addMotor(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4) {
+  if (motorCount_ >= STEPPER_ENGINE_MAX_MOTORS) {
+    return -1;
+  }
+  Motor &motor = motors_[motorCount_];
+  motor.pins[0] = in1;
+  motor.pins[1] = in2;
+  motor.pins[2] = in3;
+  motor.pins[3] = in4;
+  motor.writeGroup = NULL;
+  motor.mode = FULL_STEP;
+  motor.shift = 0;
+  motor.phase = 0;
+  motor.direction = 1;
+  motor.periodUs = 0;
+  motor.countdownUs = 0;
+  motor.position = 0;
+  motor.ramp = NULL;
+  motor.remaining = 0;
+  motor.rampStep = 0;
+  return motorCount_++;
+}
+
+uint8_t StepperEngine::stepsPerFullStep(DriveMode mode) {
+  return mode == FULL_STEP ? 1 : (mode == HALF_STEP ? 2 : STEPPER_ENGINE_MICROSTEPS);
+}
+
+bool StepperEngine::setDriveMode(uint8_t motor, DriveMode mode) {
+  if (mode == MICROSTEP && PWM_HZ < STEPPER_ENGINE_MIN_PWM_HZ) {
+    return false;
+  }
+  noInterrupts();
+  Motor &m = motors_[motor];
+  m.mode = mode;
+  m.shift = 0;
+  while ((1 << m.shift) < stepsPerFullStep(mode)) {
+    m.shift++;
+  }
+  m.phase = 0;
+  interrupts();
+  return true;
+}
+
+void StepperEngine::begin() {
+  for (uint8_t i = 0; i <= STEPPER_ENGINE_MICROSTEPS; i++) {
+    sine_[i] = lround(STEPPER_ENGINE_PWM_LEVELS * sin(i * (M_PI / 2) / STEPPER_ENGINE_MICROSTEPS));
+  }
+
+  for (uint8_t i = 0; i < motorCount_; i++) {
+    for (uint8_t p = 0; p < 4; p++) {
+      pinMode(motors_[i].pins[p], OUTPUT);
+    }
+    writeCoils(motors_[i]);
+  }
+
+#if defined(__AVR__)
+  noInterrupts();
+  TCCR2A = _BV(WGM21); // CTC, TOP = OCR2A
+  TCCR2B = _BV(CS21);  // F_CPU / 8
+  TCNT2 = 0;
+  OCR2A = F_CPU / 8000000UL * TICK_US - 1;
+  TIMSK2 |= _BV(OCIE2A);
+  interrupts();
+#endif
+}
+
+void StepperEngine::setPeriod(uint8_t motor, uint32_t periodUs) {
+  noInterrupts();
+  Motor &m = motors_[motor];
+  // Starting from a stop, the first step is one full period away
+  if (m.periodUs == 0) {
+    m.countdownUs = periodUs;
+  }
+  m.periodUs = periodUs;
+  interrupts();
+}
+
+void StepperEngine::setDirection(uint8_t motor, int8_t direction) {
+  // One byte, so the ISR always sees either the old or the new value
+  motors_[motor].direction = direction < 0 ? -1 : 1;
+}
+
+long StepperEngine::position(uint8_t motor) const {
+  noInterrupts();
+  long position = motors_[motor].position;
+  interrupts();
+  return position;
+}
+
+void StepperEngine::setRamp(uint8_t motor, const StepperRamp *ramp) {
+  motors_[motor].ramp = ramp;
+}
+
+bool StepperEngine::move(uint8_t motor, long steps) {
+  if (steps == 0) {
+    return true;
+  }
+  return motors_[motor].moves.push(steps);
+}
+
+bool StepperEngine::isMoving(uint8_t motor) const {
+  // Queue first: the ISR pops a move before it sets remaining
+  if (!motors_[motor].moves.empty()) {
+    return true;
+  }
+  noInterrupts();
+  bool moving = motors_[motor].remaining != 0;
+  interrupts();
+  return moving;
+}
+
+uint8_t StepperEngine::coilsFor(const Motor &motor) const {
+  if (motor.mode == FULL_STEP) {
+    return fullStepSequence[motor.phase];
+  }
+  if (motor.mode == HALF_STEP) {
+    return halfStepSequence[motor.phase];
+  }
+
+  // Coil A carries cos, coil B sin of the electrical angle. Each is on for
+  // the first |duty| ticks of the PWM period, on the side its sign picks.
+  const uint8_t micro = STEPPER_ENGINE_MICROSTEPS;
+  uint8_t coils = 0;
+  uint8_t sinAt = motor.phase;
+  uint8_t cosAt = (motor.phase + micro) & (4 * micro - 1);
+  uint8_t quadrant = sinAt / micro;
+  uint8_t sinDuty = (quadrant & 1) ? sine_[micro - sinAt % micro] : sine_[sinAt % micro];
+  if (sinDuty > pwmCount_) {
+    coils |= quadrant < 2 ? 0b0100 : 0b1000;
+  }
+  quadrant = cosAt / micro;
+  uint8_t cosDuty = (quadrant & 1) ? sine_[micro - cosAt % micro] : sine_[cosAt % micro];
+  if (cosDuty > pwmCount_) {
+    coils |= quadrant < 2 ? 0b0001 : 0b0010;
+  }
+  return coils;
+}
+
+void StepperEngine::writeCoils(const Motor &motor) {
+  uint8_t coils = coilsFor(motor);
+  if (motor.writeGroup) {
+    motor.writeGroup(coils);
+    return;
+  }
+  for (uint8_t p = 0; p < 4; p++) {
+    digitalWrite(motor.pins[p], (coils >> p) & 1);
+  }
+}
+
+void StepperEngine::step(Motor &motor) {
+  motor.phase = (motor.phase + motor.direction) & ((4 << motor.shift) - 1);
+  motor.position += motor.direction;
+  writeCoils(motor);
+}
+
+void StepperEngine::tick() {
+  pwmCount_ = pwmCount_ + 1 < STEPPER_ENGINE_PWM_LEVELS ? pwmCount_ + 1 : 0;
+
+  for (uint8_t i = 0; i < motorCount_; i++) {
+    Motor &motor = motors_[i];
+    if (motor.periodUs == 0) {
+      if (motor.ramp) {
+        tickMove(motor);
+      }
+    }
+    else {
+      motor.countdownUs -= TICK_US;
+      if (motor.countdownUs <= 0) {
+        motor.countdownUs += motor.periodUs;
+        step(motor);
+      }
+    }
+    // Microstepping PWMs the coils on every tick, stepping or not
+    if (motor.mode == MICROSTEP) {
+      writeCoils(motor);
+    }
+  }
+}
+
+void StepperEngine::tickMove(Motor &motor) {
+  const StepperRamp &ramp = *motor.ramp;
+
+  if (motor.remaining == 0) {
+    long steps;
+    if (!motor.moves.pop(steps)) {
+      return;
+    }
+    motor.direction = steps < 0 ? -1 : 1;
+    motor.remaining = steps < 0 ? -steps : steps;
+    motor.rampStep = 0;
+    motor.countdownUs = ramp.interval(0) >> motor.shift;
+  }
+
+  motor.countdownUs -= TICK_US;
+  if (motor.countdownUs > 0) {
+    return;
+  }
+  step(motor);
+  motor.remaining--;
+  if (motor.remaining == 0) {
+    return;
+  }
+
+  // Brake once the steps left are no more than it took to get this fast,
+  // otherwise speed up until the ramp runs out. The ramp is in full steps, so
+  // finer modes spend 2^shift steps on each entry at 2^-shift of its interval.
+  if ((unsigned long)motor.remaining <= motor.rampStep) {
+    motor.rampStep--;
+  }
+  else if (((motor.rampStep + 1) >> motor.shift) < ramp.length()) {
+    motor.rampStep++;
+  }
+  motor.countdownUs += ramp.interval(motor.rampStep >> motor.shift) >> motor.shift;
+}
+
+uint16_t StepperRamp::build(uint32_t minPeriodUs, uint32_t accelStepsPerSec2, Shape shape) {
+  length_ = 0;
+  if (shape == TRAPEZOID) {
+    // First interval sqrt(2 / a), times 0.676 to make up for the recurrence
+    // overshooting on its first steps. Kept in 1/256 us so it rounds well.
+    uint32_t c0 = 0.676 * sqrt(2.0 / accelStepsPerSec2) * 1e6;
+    uint32_t c = (c0 > UINT16_MAX ? UINT16_MAX : c0) << 8;
+    uint32_t rest = 0;
+    for (uint16_t n = 1; length_ < STEPPER_ENGINE_RAMP_STEPS; n++) {
+      uint32_t us = (c + 128) >> 8;
+      if (us <= minPeriodUs) {
+        break;
+      }
+      intervals_[length_++] = us;
+      uint32_t numerator = 2 * c + rest;
+      c -= numerator / (4 * n + 1);
+      rest = numerator % (4 * n + 1);
+    }
+  }
+  else {
+    // v(t) = vmax * smoothstep(t / T), which peaks at the given acceleration
+    // when T = 1.5 vmax / a. Position is vmax * T * (u^3 - u^4 / 2), u = t / T,
+    // and each step's time is found by bisection.
+    double vmax = 1e6 / minPeriodUs;
+    double rampTime = 1.5 * vmax / accelStepsPerSec2;
+    double lastU = 0;
+    for (uint16_t k = 1; length_ < STEPPER_ENGINE_RAMP_STEPS; k++) {
+      double low = lastU;
+      double high = 1;
+      if (vmax * rampTime * 0.5 <= k) {
+        break; // at top speed
+      }
+      for (uint8_t i = 0; i < 40; i++) {
+        double u = (low + high) / 2;
+        if (vmax * rampTime * (u * u * u - u * u * u * u / 2) < k) {
+          low = u;
+        }
+        else {
+          high = u;
+        }
+      }
+      double us = (high - lastU) * rampTime * 1e6;
+      lastU = high;
+      if (us <= minPeriodUs) {
+        break;
+      }
+      intervals_[length_++] = us > UINT16_MAX ? UINT16_MAX : (uint16_t)us;
+    }
+  }
+
+  // Always end on the top speed itself
+  if (length_ < STEPPER_ENGINE_RAMP_STEPS) {
+    intervals_[length_++] = minPeriodUs > UINT16_MAX ? UINT16_MAX : minPeriodUs;
+  }
+  return length_;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SpscRing.h>
+#include <PinGroup.h>
+
+// Timer tick in microseconds. Step times are exact multiples of the tick on
+// average and never more than one tick late.
+#ifndef STEPPER_ENGINE_TICK_US
+#define STEPPER_ENGINE_TICK_US 100
+#endif
+
+#ifndef STEPPER_ENGINE_MAX_MOTORS
+#define STEPPER_ENGINE_MAX_MOTORS 4
+#endif
+
+// Longest acceleration ramp, in steps. Faster top speeds or gentler
+// accelerations need more; a ramp that does not fit tops out early.
+#ifndef STEPPER_ENGINE_RAMP_STEPS
+#define STEPPER_ENGINE_RAMP_STEPS 128
+#endif
+
+// Moves that can wait behind the one running, per motor (power of two)
+#ifndef STEPPER_ENGINE_MOVE_QUEUE
+#define STEPPER_ENGINE_MOVE_QUEUE 4
+#endif
+
+// MICROSTEP mode: microsteps per full step (power of two) and coil PWM duty
+// levels. The PWM period is STEPPER_ENGINE_PWM_LEVELS ticks, so microstepping
+// wants a shorter tick, e.g. -D STEPPER_ENGINE_TICK_US=25 for 2.5 kHz.
+#ifndef STEPPER_ENGINE_MICROSTEPS
+#define STEPPER_ENGINE_MICROSTEPS 4
+#endif
+
+#ifndef STEPPER_ENGINE_PWM_LEVELS
+#define STEPPER_ENGINE_PWM_LEVELS 16
+#endif
+
+// Slowest coil PWM MICROSTEP runs at. Slower than this the coil current
+// ripples with the PWM and the motor whines and loses torque; at the default
+// 16 levels it takes a tick of 25 us or less.
+#ifndef STEPPER_ENGINE_MIN_PWM_HZ
+#define STEPPER_ENGINE_MIN_PWM_HZ 2500
+#endif
+
+// Step intervals from standstill up to a top speed, worked out once in
+// build() so the interrupt only looks them up. Several motors can share one.
+//
+//   TRAPEZOID  constant acceleration, from the integer recurrence
+//              c[n] = c[n-1] - 2 c[n-1] / (4n + 1)   (D. Austin, 2005)
+//   S_CURVE    acceleration eases in and out (velocity follows a smoothstep),
+//              for loads that jerk at the start of a trapezoid ramp
+class StepperRamp {
+public:
+  enum Shape { TRAPEZOID, S_CURVE };
+
+  // Returns the ramp length in steps
+  uint16_t build(uint32_t minPeriodUs, uint32_t accelStepsPerSec2, Shape shape = TRAPEZOID);
+
+  uint16_t length() const { return length_; }
+  // Interval before step n+1 when n steps into the ramp
+  uint16_t interval(uint16_t n) const { return intervals_[n]; }
+
+private:
+  uint16_t intervals_[STEPPER_ENGINE_RAMP_STEPS];
+  uint16_t length_ = 0;
+};
+
+// Steps 4-wire stepper motors (28BYJ-48 on a ULN2003, or an H-bridge) from a
+// timer interrupt, so step timing does not depend on what loop() is doing.
+//
+// On AVR, Timer2 runs in CTC mode and calls tick() every
+// STEPPER_ENGINE_TICK_US. Timer1 stays free for the Servo library, but tone()
+// cannot be used at the same time. On other targets nothing starts the timer;
+// call tick() every STEPPER_ENGINE_TICK_US yourself (the host tests do).
+//
+// Each motor has its own step period in microseconds. Every tick the ISR
+// counts the period down and moves the coils one step when it runs out,
+// carrying the remainder over so periods that are not a multiple of the tick
+// still average out exactly.
+//
+// IN1/IN2 drive the two ends (or halves) of coil A and IN3/IN4 coil B. Each
+// motor has a drive mode:
+//   FULL_STEP  both coils always on, 4 phases
+//   HALF_STEP  alternates two coils and one coil, 8 phases, half the step
+//   MICROSTEP  coil currents follow cosine/sine, STEPPER_ENGINE_MICROSTEPS per
+//              full step. The ISR PWMs the coils from a precomputed sine table
+//              on every tick, so current and step timing share one clock.
+//              Only with a tick short enough for STEPPER_ENGINE_MIN_PWM_HZ.
+// Periods, moves and positions count steps of the motor's mode. Ramps are
+// built in full steps and scaled to the mode, so one ramp suits every mode.
+//
+// A motor either runs at a constant speed (setPeriod) or, with a ramp set,
+// works through queued moves: each one accelerates along the ramp, cruises
+// and brakes to a stop on its last step, so reversing is just queueing a move
+// the other way.
+class StepperEngine {
+public:
+  static const uint16_t TICK_US = STEPPER_ENGINE_TICK_US;
+  // Coil PWM frequency in MICROSTEP mode
+  static const uint32_t PWM_HZ = 1000000UL / (STEPPER_ENGINE_TICK_US * STEPPER_ENGINE_PWM_LEVELS);
+
+  enum DriveMode : uint8_t { FULL_STEP, HALF_STEP, MICROSTEP };
+
+  // Register a motor before begin(). Returns its id, or -1 if full.
+  int8_t addMotor(uint8_t in1, uint8_t in2, uint8_t in3, uint8_t in4);
+
+  // Same, with the pins known at compile time. The coils are then switched
+  // together by one port write (PinGroup) instead of four digitalWrite()s.
+  template <uint8_t In1, uint8_t In2, uint8_t In3, uint8_t In4>
+  int8_t addMotor() {
+    int8_t id = addMotor(In1, In2, In3, In4);
+    if (id >= 0) {
+      motors_[id].writeGroup = &writeGroup<PinGroup<In1, In2, In3, In4> >;
+    }
+    return id;
+  }
+
+  // Sets the pins up and starts the timer
+  void begin();
+
+  // Set while the motor is stopped. Returns false, leaving the mode as it
+  // was, for MICROSTEP when PWM_HZ is under STEPPER_ENGINE_MIN_PWM_HZ.
+  bool setDriveMode(uint8_t motor, DriveMode mode);
+  // Steps of a mode per full step: 1, 2 or STEPPER_ENGINE_MICROSTEPS
+  static uint8_t stepsPerFullStep(DriveMode mode);
+
+  // Time between steps, 0 stops the motor (coils stay energised)
+  void setPeriod(uint8_t motor, uint32_t periodUs);
+  // 1 = forward, -1 = reverse
+  void setDirection(uint8_t motor, int8_t direction);
+  // Steps taken, forward minus reverse
+  long position(uint8_t motor) const;
+
+  // Ramp for move(). Stop the motor (period 0) before changing it.
+  void setRamp(uint8_t motor, const StepperRamp *ramp);
+  // Queue a relative move. Returns false if the queue is full.
+  bool move(uint8_t motor, long steps);
+  // Moves waiting behind the current one
+  size_t queuedMoves(uint8_t motor) const { return motors_[motor].moves.size(); }
+  // True while a move is running or queued
+  bool isMoving(uint8_t motor) const;
+
+  // Called from the timer interrupt
+  void tick();
+
+private:
+  struct Motor {
+    uint8_t pins[4];
+    void (*writeGroup)(uint8_t coils); // NULL = digitalWrite() per pin
+    DriveMode mode;
+    uint8_t shift;       // log2(stepsPerFullStep(mode))
+    uint8_t phase;       // electrical position, 0 .. 4 << shift
+    int8_t direction;
+    uint32_t periodUs;   // 0 = stopped
+    int32_t countdownUs; // until the next step
+    long position;
+
+    const StepperRamp *ramp;
+    SpscRing<long, STEPPER_ENGINE_MOVE_QUEUE> moves;
+    volatile long remaining; // steps left in the current move
+    uint16_t rampStep;       // steps into the ramp, i.e. current speed
+  };
+
+  uint8_t coilsFor(const Motor &motor) const;
+  void writeCoils(const Motor &motor);
+  template <class Group>
+  static void writeGroup(uint8_t coils) {
+    Group::write(coils);
+  }
+  void step(Motor &motor);
+  void tickMove(Motor &motor);
+
+  Motor motors_[STEPPER_ENGINE_MAX_MOTORS];
+  uint8_t motorCount_ = 0;
+  uint8_t pwmCount_ = 0;                           // 0 .. PWM_LEVELS - 1
+  uint8_t sine_[STEPPER_ENGINE_MICROSTEPS + 1];   // quarter wave, in duty levels
+};
+
+extern StepperEngine steppers;
@@ -0,0 +1,168 @@
+#include "Telemetry.h"
+
+#include <string.h>
+
+Telemetry::Telemetry(Print &out) : out_(out) {}
+
+void Telemetry::putVarint(uint32_t value) {
+  while (value >= 0x80) {
+    frame_[length_++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  frame_[length_++] = (uint8_t)value;
+}
+
+void Telemetry::beginFrame(uint32_t timeMs) {
+  timeMs_ = timeMs;
+  records_ = 0;
+}
+
+void Telemetry::add(uint8_t channel, int32_t value) {
+  if (records_ >= MAX_RECORDS) {
+    return;
+  }
+  channels_[records_] = channel;
+  values_[records_] = value;
+  records_++;
+}
+
+uint8_t Telemetry::findLayout() const {
+  for (uint8_t slot = 0; slot < TELEMETRY_LAYOUTS; slot++) {
+    const Layout &layout = layouts_[slot];
+    if (layout.used && layout.count == records_ &&
+        memcmp(layout.channels, channels_, records_) == 0) {
+      return slot;
+    }
+  }
+  return TELEMETRY_LAYOUTS;
+}
+
+bool Telemetry::endFrame() {
+  uint8_t slot = findLayout();
+  bool known = slot < TELEMETRY_LAYOUTS;
+  if (!known) {
+    slot = nextSlot_;
+  }
+  Layout &layout = layouts_[slot];
+
+  uint32_t interval = timeMs_ - layout.timeMs;
+  uint32_t intervalChange = telemetryZigzag((int32_t)(interval - layout.intervalMs));
+  // The change has to fit in the head above the layout and flags
+  bool key = !known || layout.sinceKey >= TELEMETRY_KEY_INTERVAL || intervalChange >= (1UL << 27);
+
+  length_ = 0;
+  uint8_t crc;
+  if (key) {
+    putVarint((slot << 2) | 1);
+    putVarint(timeMs_);
+    frame_[length_++] = records_;
+    for (uint8_t i = 0; i < records_; i++) {
+      frame_[length_++] = channels_[i];
+    }
+    for (uint8_t i = 0; i < records_; i++) {
+      putVarint(telemetryZigzag(values_[i]));
+    }
+    crc = telemetryCrc8(frame_, length_);
+  }
+  else {
+    bool repeat = memcmp(layout.values, values_, records_ * sizeof(values_[0])) == 0;
+    putVarint((intervalChange << 5) | (slot << 2) | (repeat ? 2 : 0));
+    if (!repeat) {
+      for (uint8_t i = 0; i < records_; i++) {
+        putVarint(telemetryZigzag((int32_t)((uint32_t)values_[i] - (uint32_t)layout.values[i])));
+      }
+    }
+    crc = telemetryCrc8(frame_, length_, layout.crc);
+  }
+  frame_[length_++] = crc;
+
+  if (!queue()) {
+    droppedFrames_++;
+    return false;
+  }
+
+  // The reader has this frame now, so the next one is against it
+  if (!known) {
+    layout.used = true;
+    layout.count = records_;
+    memcpy(layout.channels, channels_, records_);
+    nextSlot_ = (nextSlot_ + 1) % TELEMETRY_LAYOUTS;
+  }
+  memcpy(layout.values, values_, records_ * sizeof(values_[0]));
+  layout.intervalMs = key ? 0 : interval;
+  layout.timeMs = timeMs_;
+  layout.sinceKey = key ? 0 : layout.sinceKey + 1;
+  layout.crc = crc;
+  return true;
+}
+
+bool Telemetry::queue() {
+  // COBS: each code byte says how far it is to the next zero, so the encoded
+  // frame has no zeros and 0x00 can end it. Frames are shorter than 254
+  // bytes, so one code byte per zero is all it costs.
+  uint8_t encoded[MAX_FRAME + 2];
+  uint8_t codeAt = 0;
+  uint8_t out = 1;
+  uint8_t code = 1;
+  for (uint8_t i = 0; i < length_; i++) {
+    if (frame_[i] == 0) {
+      encoded[codeAt] = code;
+      codeAt = out++;
+      code = 1;
+    }
+    else {
+      encoded[out++] = frame_[i];
+      code++;
+    }
+  }
+  encoded[codeAt] = code;
+  encoded[out++] = 0;
+
+  size_t needed = out + (textOpen_ ? 1 : 0);
+  if (tx_.capacity() - tx_.size() < needed) {
+    return false;
+  }
+  if (textOpen_) {
+    tx_.push(0);
+    textOpen_ = false;
+  }
+  for (uint8_t i = 0; i < out; i++) {
+    tx_.push(encoded[i]);
+  }
+  return true;
+}
+
+bool Telemetry::send(uint32_t timeMs, uint8_t channel, int32_t value) {
+  beginFrame(timeMs);
+  add(channel, value);
+  return endFrame();
+}
+
+size_t Telemetry::write(uint8_t c) {
+  if (!tx_.push(c)) {
+    return 0;
+  }
+  textOpen_ = true;
+  return 1;
+}
+
+size_t Telemetry::pump() {
+  size_t moved = 0;
+  uint8_t chunk[32];
+
+  for (;;) {
+    int room = out_.availableForWrite();
+    size_t count = room < (int)sizeof(chunk) ? (room > 0 ? room : 0) : sizeof(chunk);
+    if (count > 0) {
+      count = tx_.popBatch(chunk, count);
+    }
+    if (count == 0) {
+      break;
+    }
+    out_.write(chunk, count);
+    moved += count;
+  }
+
+  bytesSent_ += moved;
+  return moved;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Arduino.h>
+#include <SpscRing.h>
+
+// Bytes of frames and text waiting for the UART. Must be a power of two.
+#ifndef TELEMETRY_TX_RING
+#define TELEMETRY_TX_RING 512
+#endif
+
+// Delta frames since a layout's last key frame before it sends another, so
+// a reader that lost a frame picks the layout up again
+#ifndef TELEMETRY_KEY_INTERVAL
+#define TELEMETRY_KEY_INTERVAL 32
+#endif
+
+#include "TelemetryDecoder.h"
+
+// Compact binary logging that never blocks the caller.
+//
+// A frame is a timestamp plus one or more (channel, value) records. Sketches
+// send the same few kinds of frame over and over, so the encoder remembers
+// the channel list of each kind (its layout, up to TELEMETRY_LAYOUTS of them)
+// and after the first frame sends only what changed:
+//
+//   key frame    head (layout << 2) | 1, absolute time in ms, record count,
+//                the channels, each value as a zigzag varint
+//   delta frame  head (interval change << 5) | (layout << 2) | repeat << 1,
+//                then unless `repeat` (no value changed) each value's change
+//                as a zigzag varint
+//   crc          CRC-8 (poly 0x07); a delta frame's carries on from the
+//                previous frame of its layout
+//
+// Times and values are deltas against the previous frame of the same layout.
+// The interval change is this frame's gap from that one minus the gap before
+// it (zigzag), so a periodic frame costs one head byte, and an unchanged
+// value one zero byte. A layout sends a key frame when it is new and every
+// TELEMETRY_KEY_INTERVAL frames after. The chained CRC means a delta frame
+// read after a lost one fails its check instead of decoding to wrong values.
+//
+// The frame is COBS encoded and ends with a 0x00, so a reader can always find
+// the next frame. Frames go into a RAM ring and pump() hands them to the UART
+// only as fast as its TX buffer has room, so nothing ever waits for the wire.
+// A frame that does not fit in the ring is dropped whole and counted; the
+// next frame of its layout is a delta against the last one that went out.
+//
+// Plain text can still be printed (it is a Print). It is ended with a 0x00
+// before the next frame, and the decoder passes it through as text.
+// TelemetryDecoder turns the stream back into records; see tools/ for CSV.
+class Telemetry : public Print {
+public:
+  static const uint8_t MAX_RECORDS = TELEMETRY_MAX_RECORDS;
+
+  explicit Telemetry(Print &out);
+
+  void beginFrame(uint32_t timeMs);
+  void add(uint8_t channel, int32_t value);
+  // Queues the frame. Returns false if it was dropped.
+  bool endFrame();
+
+  // A frame with a single record
+  bool send(uint32_t timeMs, uint8_t channel, int32_t value);
+
+  // Text, queued like frames
+  size_t write(uint8_t c) override;
+  using Print::write;
+
+  // Moves queued bytes to the output while it has room. Returns bytes moved.
+  size_t pump();
+
+  uint32_t droppedFrames() const { return droppedFrames_; }
+  uint32_t bytesSent() const { return bytesSent_; }
+
+private:
+  // Worst case, a key frame: head, 5 byte time, count, channels, 5 bytes per
+  // value, crc
+  static const uint8_t MAX_FRAME = 1 + 5 + 1 + MAX_RECORDS * 6 + 1;
+
+  // What the reader last got with a layout
+  struct Layout {
+    bool used;
+    uint8_t count;
+    uint8_t channels[MAX_RECORDS];
+    int32_t values[MAX_RECORDS];
+    uint32_t timeMs;
+    uint32_t intervalMs;
+    uint8_t sinceKey; // delta frames since the last key frame
+    uint8_t crc;
+  };
+
+  // Slot whose channels match the frame's, or TELEMETRY_LAYOUTS
+  uint8_t findLayout() const;
+  void putVarint(uint32_t value);
+  bool queue();
+
+  Print &out_;
+  SpscRing<uint8_t, TELEMETRY_TX_RING> tx_;
+  uint8_t channels_[MAX_RECORDS];
+  int32_t values_[MAX_RECORDS];
+  uint8_t records_ = 0;
+  uint32_t timeMs_ = 0;
+  uint8_t frame_[MAX_FRAME];
+  uint8_t length_ = 0;
+  Layout layouts_[TELEMETRY_LAYOUTS] = {};
+  uint8_t nextSlot_ = 0; // reused next when a new layout turns up
+  bool textOpen_ = false;
+  uint32_t droppedFrames_ = 0;
+  uint32_t bytesSent_ = 0;
+};
@@ -0,0 +1,157 @@
+#include "TelemetryDecoder.h"
+
+uint8_t telemetryCrc8(const uint8_t *data, size_t length, uint8_t crc) {
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Reads a varint at data[*pos], false if it runs past the end
+static bool readVarint(const uint8_t *data, size_t length, size_t *pos, uint32_t *value) {
+  *value = 0;
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+    if (*pos >= length) {
+      return false;
+    }
+    uint8_t byte = data[(*pos)++];
+    *value |= (uint32_t)(byte & 0x7F) << shift;
+    if (!(byte & 0x80)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+TelemetryDecoder::TelemetryDecoder(RecordFn onRecord, TextFn onText, void *context)
+    : onRecord_(onRecord), onText_(onText), context_(context) {}
+
+void TelemetryDecoder::feed(const uint8_t *data, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (data[i] == 0) {
+      endChunk();
+      continue;
+    }
+    if (length_ == MAX_CHUNK) {
+      flushText();
+      overflowed_ = true;
+    }
+    chunk_[length_++] = data[i];
+  }
+}
+
+void TelemetryDecoder::finish() {
+  flushText();
+  overflowed_ = false;
+}
+
+void TelemetryDecoder::flushText() {
+  if (length_ > 0 && onText_) {
+    onText_(context_, (const char *)chunk_, length_);
+  }
+  length_ = 0;
+}
+
+void TelemetryDecoder::endChunk() {
+  if (overflowed_ || !decodeFrame(chunk_, length_)) {
+    flushText();
+  }
+  length_ = 0;
+  overflowed_ = false;
+}
+
+bool TelemetryDecoder::decodeFrame(uint8_t *frame, size_t length) {
+  // Undo COBS into a separate buffer so the chunk survives as text on failure
+  uint8_t raw[MAX_CHUNK];
+  size_t rawLength = 0;
+  size_t pos = 0;
+  while (pos < length) {
+    uint8_t code = frame[pos++];
+    if (code == 0 || pos + code - 1 > length) {
+      return false;
+    }
+    for (uint8_t i = 1; i < code; i++) {
+      raw[rawLength++] = frame[pos++];
+    }
+    if (code < 0xFF && pos < length) {
+      raw[rawLength++] = 0;
+    }
+  }
+
+  if (rawLength < 2) {
+    return false;
+  }
+  rawLength--;
+  uint8_t crc = raw[rawLength];
+
+  // Work on a copy of the layout, kept only if the whole frame checks out
+  size_t at = 0;
+  uint32_t head;
+  if (!readVarint(raw, rawLength, &at, &head)) {
+    return false;
+  }
+  uint8_t slot = (head >> 2) % TELEMETRY_LAYOUTS;
+  Layout layout = layouts_[slot];
+
+  if (head & 1) {
+    // Key frame: absolute time, the channel list, absolute values
+    uint32_t time;
+    if (!readVarint(raw, rawLength, &at, &time) || at >= rawLength) {
+      return false;
+    }
+    layout.count = raw[at++];
+    if (layout.count > TELEMETRY_MAX_RECORDS || at + layout.count > rawLength) {
+      return false;
+    }
+    for (uint8_t i = 0; i < layout.count; i++) {
+      layout.channels[i] = raw[at++];
+    }
+    for (uint8_t i = 0; i < layout.count; i++) {
+      uint32_t zigzag;
+      if (!readVarint(raw, rawLength, &at, &zigzag)) {
+        return false;
+      }
+      layout.values[i] = telemetryUnzigzag(zigzag);
+    }
+    layout.timeMs = time;
+    layout.intervalMs = 0;
+  }
+  else {
+    // Delta frame: change in interval, then changes in value unless repeated.
+    // Its CRC carries on from the layout's previous frame, so it only checks
+    // out if that is the frame decoded last.
+    if (!layout.known || telemetryCrc8(raw, rawLength, layout.crc) != crc) {
+      skippedFrames_++;
+      return false;
+    }
+    layout.intervalMs += telemetryUnzigzag(head >> 5);
+    layout.timeMs += layout.intervalMs;
+    if (!(head & 2)) {
+      for (uint8_t i = 0; i < layout.count; i++) {
+        uint32_t zigzag;
+        if (!readVarint(raw, rawLength, &at, &zigzag)) {
+          return false;
+        }
+        layout.values[i] = (int32_t)((uint32_t)layout.values[i] + (uint32_t)telemetryUnzigzag(zigzag));
+      }
+    }
+  }
+
+  if (at != rawLength || ((head & 1) && telemetryCrc8(raw, rawLength) != crc)) {
+    return false;
+  }
+  layout.known = true;
+  layout.crc = crc;
+  layouts_[slot] = layout;
+  frames_++;
+
+  for (uint8_t i = 0; i < layout.count; i++) {
+    if (onRecord_) {
+      onRecord_(context_, layout.timeMs, layout.channels[i], layout.values[i]);
+    }
+  }
+  return true;
+}
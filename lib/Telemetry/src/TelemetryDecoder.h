@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Records in one frame
+static const uint8_t TELEMETRY_MAX_RECORDS = 12;
+// Layouts both ends remember. The frame head has three bits for the slot.
+static const uint8_t TELEMETRY_LAYOUTS = 8;
+
+// Reads the stream written by Telemetry. Bytes can be fed in any chunk size.
+// Every record in a valid frame goes to the record callback. Anything between
+// delimiters that is not a valid frame (text from print(), or a frame with a
+// bad CRC) goes to the text callback as-is.
+//
+// A delta frame only decodes against the frame before it in its layout, so
+// after a lost frame that layout is skipped until its next key frame.
+//
+// Plain C++ with no Arduino dependencies, so it also builds on the host.
+class TelemetryDecoder {
+public:
+  typedef void (*RecordFn)(void *context, uint32_t timeMs, uint8_t channel, int32_t value);
+  typedef void (*TextFn)(void *context, const char *text, size_t length);
+
+  TelemetryDecoder(RecordFn onRecord, TextFn onText, void *context);
+
+  void feed(const uint8_t *data, size_t length);
+  // Flushes text that was not followed by a delimiter
+  void finish();
+
+  uint32_t frames() const { return frames_; }
+  // Delta frames that did not follow on from the last frame of their layout
+  // seen here, so a frame before them was lost (or sent before the capture
+  // started). They go to the text callback.
+  uint32_t skippedFrames() const { return skippedFrames_; }
+
+private:
+  static const size_t MAX_CHUNK = 128;
+
+  // What the encoder last sent with a layout
+  struct Layout {
+    bool known;
+    uint8_t count;
+    uint8_t channels[TELEMETRY_MAX_RECORDS];
+    int32_t values[TELEMETRY_MAX_RECORDS];
+    uint32_t timeMs;
+    uint32_t intervalMs;
+    uint8_t crc;
+  };
+
+  void endChunk();
+  bool decodeFrame(uint8_t *frame, size_t length);
+  void flushText();
+
+  RecordFn onRecord_;
+  TextFn onText_;
+  void *context_;
+  uint8_t chunk_[MAX_CHUNK];
+  size_t length_ = 0;
+  bool overflowed_ = false; // chunk too long to be a frame, so it is text
+  Layout layouts_[TELEMETRY_LAYOUTS] = {};
+  uint32_t frames_ = 0;
+  uint32_t skippedFrames_ = 0;
+};
+
+// CRC-8 (poly 0x07), carried on from `crc`
+uint8_t telemetryCrc8(const uint8_t *data, size_t length, uint8_t crc = 0);
+
+inline uint32_t telemetryZigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+inline int32_t telemetryUnzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
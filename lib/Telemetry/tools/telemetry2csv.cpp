@@ -0,0 +1,45 @@
+// Host tool: turns a Telemetry byte stream back into CSV.
+//
+//   g++ -O2 -I../src telemetry2csv.cpp ../src/TelemetryDecoder.cpp -o telemetry2csv
+//   ./telemetry2csv capture.bin > capture.csv
+//   ./telemetry2csv < /dev/ttyUSB0
+//
+// Records go to stdout as "time_ms,channel,value". Text printed by the sketch
+// goes to stderr, so it stays readable without mixing into the CSV.
+
+#include "TelemetryDecoder.h"
+
+#include <stdio.h>
+
+static void printRecord(void *context, uint32_t timeMs, uint8_t channel, int32_t value) {
+  printf("%lu,%u,%ld\n", (unsigned long)timeMs, (unsigned)channel, (long)value);
+}
+
+static void printText(void *context, const char *text, size_t length) {
+  fwrite(text, 1, length, stderr);
+}
+
+int main(int argc, char **argv) {
+  FILE *in = stdin;
+  if (argc > 1) {
+    in = fopen(argv[1], "rb");
+    if (!in) {
+      perror(argv[1]);
+      return 1;
+    }
+  }
+
+  TelemetryDecoder decoder(printRecord, printText, NULL);
+  printf("time_ms,channel,value\n");
+
+  uint8_t buffer[256];
+  size_t count;
+  while ((count = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+    decoder.feed(buffer, count);
+    fflush(stdout);
+  }
+  decoder.finish();
+
+  fprintf(stderr, "%lu frames\n", (unsigned long)decoder.frames());
+  return 0;
+}
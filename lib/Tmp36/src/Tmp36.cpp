@@ -0,0 +1,61 @@
+#include "Tmp36.h"
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_adc_cal.h>
+#endif
+
+// (mV - 500) * 10 at codes 0, 128, ... 4096 for the nominal curve above.
+// test/test_tmp36 checks these against it.
+const int16_t Tmp36::NOMINAL_TABLE[TABLE_POINTS] = {
+  -3580, -2549, -1518,  -486,   545,  1576,  2607,  3638,
+   4670,  5701,  6732,  7763,  8795,  9826, 10857, 11888,
+  12919, 13951, 14982, 16013, 17044, 18075, 19107, 20138,
+  21169, 22200, 23231, 24263, 25294, 26325, 27356, 28388,
+  29419,
+};
+
+#if defined(ARDUINO_ARCH_ESP32)
+bool Tmp36::begin() {
+  esp_adc_cal_characteristics_t characteristics;
+  esp_adc_cal_value_t source = esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12,
+                                                        1100, &characteristics);
+  if (source == ESP_ADC_CAL_VAL_DEFAULT_VREF) {
+    // Nothing burnt in: the nominal table is exactly what it would compute
+    table_ = NOMINAL_TABLE;
+    return false;
+  }
+
+  for (uint8_t i = 0; i < TABLE_POINTS; i++) {
+    // The last point stands for code 4096, one past the top; 4095 is close
+    // enough for a sensor that never gets near it
+    uint32_t code = (uint32_t)i << SEGMENT_BITS;
+    int32_t mv = esp_adc_cal_raw_to_voltage(code > 4095 ? 4095 : code, &characteristics);
+    calibratedTable_[i] = (mv - 500) * 10;
+  }
+  table_ = calibratedTable_;
+  return true;
+}
+#else
+// No eFuse on the host
+bool Tmp36::begin() {
+  table_ = NOMINAL_TABLE;
+  return false;
+}
+#endif
+
+int16_t Tmp36::centiCelsius(uint32_t reading, uint8_t bits) const {
+  if (bits < 12) {
+    reading <<= 12 - bits;
+    bits = 12;
+  }
+  uint8_t fractionBits = bits - 12 + SEGMENT_BITS;
+  uint32_t index = reading >> fractionBits;
+  if (index >= TABLE_POINTS - 1) {
+    return table_[TABLE_POINTS - 1];
+  }
+
+  int32_t fraction = reading & ((1UL << fractionBits) - 1);
+  int32_t low = table_[index];
+  int32_t high = table_[index + 1];
+  return low + (((high - low) * fraction + (1L << (fractionBits - 1))) >> fractionBits);
+}
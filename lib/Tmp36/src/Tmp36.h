@@ -0,0 +1,47 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Converts ADC1 readings of a TMP36 (10 mV/C, 500 mV at 0 C) to 0.01 C in
+// integer math.
+//
+// The curve from ADC code to temperature is a piecewise-linear table with a
+// point every 128 codes. NOMINAL_TABLE, in flash, is what esp_adc_cal
+// assumes at 11 dB when a chip has no calibration: Vref 1100 mV, so
+// mV = 52798 * code / 65536 + 142. That 142 mV offset at code 0 is why the
+// old float conversion needed its +14 C fudge.
+//
+// On the ESP32, begin() characterizes ADC1 from the chip's eFuse values and
+// rebuilds the table in RAM from esp_adc_cal_raw_to_voltage(), which also
+// corrects the ADC's bend above about 2.6 V. Converting is then one lookup
+// and one multiply, the same cost for every reading.
+class Tmp36 {
+public:
+  static const uint8_t SEGMENT_BITS = 7; // 128 codes between table points
+  static const uint8_t TABLE_POINTS = (4096 >> SEGMENT_BITS) + 1;
+
+  static const int16_t NOMINAL_TABLE[TABLE_POINTS];
+
+  // Switches to the chip's own calibration when its eFuse has one. Returns
+  // whether it did.
+  bool begin();
+
+  bool calibrated() const { return table_ != NOMINAL_TABLE; }
+
+  // Temperature in 0.01 C for an ADC1 reading at 11 dB. `bits` is the
+  // reading's width: 12 for analogRead(), AdcService::BITS for oversampled
+  // values.
+  int16_t centiCelsius(uint32_t reading, uint8_t bits = 12) const;
+
+  // Saturates above 327.67 F, which a floating pin can read as
+  static int16_t toCentiFahrenheit(int16_t centiCelsius) {
+    int32_t centiFahrenheit = (int32_t)centiCelsius * 9 / 5 + 3200;
+    return centiFahrenheit > INT16_MAX ? INT16_MAX : centiFahrenheit;
+  }
+
+  const int16_t *table() const { return table_; }
+
+private:
+  const int16_t *table_ = NOMINAL_TABLE;
+  int16_t calibratedTable_[TABLE_POINTS];
+};
@@ -0,0 +1,93 @@
+#include "SonarArray.h"
+
+namespace {
+
+uint8_t gcd(uint8_t a, uint8_t b) {
+  while (b != 0) {
+    uint8_t t = a % b;
+    a = b;
+    b = t;
+  }
+  return a;
+}
+
+} // namespace
+
+int8_t SonarArray::add(Ultrasonic &sensor, int16_t bearing) {
+  if (count_ >= ULTRASONIC_MAX_SENSORS) {
+    return -1;
+  }
+  sensors_[count_] = &sensor;
+  bearings_[count_] = bearing;
+  stats_[count_] = {0, 0, 0, false};
+  return count_++;
+}
+
+bool SonarArray::begin() {
+  bool ok = true;
+  for (uint8_t i = 0; i < count_; i++) {
+    ok = sensors_[i]->begin() && ok;
+    sensors_[i]->setCallback(onReading, this);
+  }
+
+  // Largest step up to half the ring that still visits every sensor
+  stride_ = 1;
+  for (uint8_t s = count_ / 2; s > 1; s--) {
+    if (gcd(s, count_) == 1) {
+      stride_ = s;
+      break;
+    }
+  }
+  // So the first ping is sensor 0
+  last_ = count_ > 0 ? (count_ - stride_) % count_ : 0;
+  echoDoneUs_ = micros() - ULTRASONIC_GUARD_US;
+  return ok;
+}
+
+void SonarArray::update() {
+  if (pinging_) {
+    Ultrasonic &sensor = *sensors_[last_];
+    sensor.poll();
+    Ultrasonic::Reading reading;
+    if (!sensor.read(reading)) {
+      return;
+    }
+    SensorStats &stats = stats_[last_];
+    stats.readings++;
+    stats.inRange = reading.status == Ultrasonic::OK;
+    if (stats.inRange) {
+      stats.lastMm = reading.mm();
+    }
+    else {
+      stats.noEcho++;
+    }
+    pinging_ = false;
+  }
+
+  if (count_ == 0 || micros() - echoDoneUs_ < ULTRASONIC_GUARD_US) {
+    return;
+  }
+  // A sensor still inside its own ping cycle holds the round up, so every
+  // sensor gets the same share
+  uint8_t next = (last_ + stride_) % count_;
+  if (sensors_[next]->trigger()) {
+    last_ = next;
+    pinging_ = true;
+  }
+}
+
+SonarArray::Target SonarArray::closest() const {
+  Target target = {-1, 0, 0};
+  for (uint8_t i = 0; i < count_; i++) {
+    if (stats_[i].inRange && (target.sensor < 0 || stats_[i].lastMm < target.mm)) {
+      target.sensor = i;
+      target.mm = stats_[i].lastMm;
+      target.bearing = bearings_[i];
+    }
+  }
+  return target;
+}
+
+void IRAM_ATTR SonarArray::onReading(const Ultrasonic::Reading &reading, void *arg) {
+  static_cast<SonarArray *>(arg)->echoDoneUs_ = micros();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Ultrasonic.h"
+
+#ifndef ULTRASONIC_MAX_SENSORS
+#define ULTRASONIC_MAX_SENSORS 8
+#endif
+
+// Quiet time after one sensor's echo before the next sensor pings, so
+// reflections of the last ping still bouncing around are not taken for the
+// next one's echo. Sound covers about 1.7 m in 5 ms.
+#ifndef ULTRASONIC_GUARD_US
+#define ULTRASONIC_GUARD_US 5000
+#endif
+
+// Several HC-SR04s pinging one at a time, as a perimeter.
+//
+// Only one sensor is ever pinging, so no sensor hears another's burst. The
+// next one goes as soon as the echo is in and the guard time has passed,
+// rather than on a fixed slot, so near objects give a faster sample rate.
+// Sensors take turns in a fixed order that steps by about half the ring
+// (0, 3, 6, 1, 4, 7, 2, 5 for eight), so consecutive pings face away from
+// each other.
+//
+// Each sensor keeps its own echo interrupt or capture channel. update()
+// moves the round along; call it every millisecond or so, e.g. from a
+// scheduler task. The array sets the sensors' callbacks, so do not set your
+// own on them.
+class SonarArray {
+public:
+  struct Target {
+    int8_t sensor;   // -1 when nothing is in range of any sensor
+    uint32_t mm;     // distance from that sensor
+    int16_t bearing; // direction that sensor faces, degrees
+  };
+
+  struct SensorStats {
+    uint32_t readings; // pings answered, in range or not
+    uint32_t noEcho;   // of which nothing was in range
+    uint32_t lastMm;   // last distance in range
+    bool inRange;      // whether the last reading was
+  };
+
+  // Adds a sensor facing `bearing` degrees. Returns its index, or -1 when
+  // ULTRASONIC_MAX_SENSORS are already in.
+  int8_t add(Ultrasonic &sensor, int16_t bearing);
+
+  // Starts the sensors. Returns false if one of them could not start.
+  bool begin();
+
+  // Collects the running ping's echo and fires the next ping when it is due
+  void update();
+
+  // Closest object any sensor saw on its last ping
+  Target closest() const;
+
+  uint8_t count() const { return count_; }
+  const SensorStats &stats(uint8_t sensor) const { return stats_[sensor]; }
+
+private:
+  static void IRAM_ATTR onReading(const Ultrasonic::Reading &reading, void *arg);
+
+  Ultrasonic *sensors_[ULTRASONIC_MAX_SENSORS];
+  int16_t bearings_[ULTRASONIC_MAX_SENSORS];
+  SensorStats stats_[ULTRASONIC_MAX_SENSORS];
+  uint8_t count_ = 0;
+  uint8_t stride_ = 1;
+  uint8_t last_ = 0;         // sensor that pinged last
+  bool pinging_ = false;     // last_ is still waiting for its echo
+  volatile uint32_t echoDoneUs_ = 0; // micros() when the last echo ended
+};
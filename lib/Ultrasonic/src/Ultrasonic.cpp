@@ -0,0 +1,157 @@
+#include "Ultrasonic.h"
+
+namespace {
+
+// The echo starts once the sensor has sent its 40 kHz burst, well under this
+// after the trigger
+const uint32_t ECHO_START_US = 2000;
+
+#if ULTRASONIC_CAPTURE_HW
+const uint32_t TICKS_PER_US = 80; // APB clock
+const uint8_t CAPTURE_CHANNELS = 6; // 3 per MCPWM unit
+#else
+const uint32_t TICKS_PER_US = 1;  // micros()
+#endif
+
+} // namespace
+
+#if defined(ARDUINO_ARCH_ESP32)
+// The echo interrupt or capture callback can run on the other core, where
+// noInterrupts() would not hold it off
+#define ULTRASONIC_LOCK() portENTER_CRITICAL(&lock_)
+#define ULTRASONIC_UNLOCK() portEXIT_CRITICAL(&lock_)
+#define ULTRASONIC_LOCK_ISR() portENTER_CRITICAL_ISR(&lock_)
+#define ULTRASONIC_UNLOCK_ISR() portEXIT_CRITICAL_ISR(&lock_)
+#else
+// AVR: interrupts are already off inside the ISR
+#define ULTRASONIC_LOCK() noInterrupts()
+#define ULTRASONIC_UNLOCK() interrupts()
+#define ULTRASONIC_LOCK_ISR()
+#define ULTRASONIC_UNLOCK_ISR()
+#endif
+
+#if ULTRASONIC_CAPTURE_HW
+uint8_t Ultrasonic::captureChannels_ = 0;
+#endif
+
+bool Ultrasonic::begin() {
+  pinMode(trigPin_, OUTPUT);
+  digitalWrite(trigPin_, LOW);
+  pinMode(echoPin_, INPUT);
+
+#if ULTRASONIC_CAPTURE_HW
+  if (captureChannels_ >= CAPTURE_CHANNELS) {
+    return false;
+  }
+  uint8_t n = captureChannels_++;
+  mcpwm_unit_t unit = n < 3 ? MCPWM_UNIT_0 : MCPWM_UNIT_1;
+  uint8_t channel = n % 3;
+  mcpwm_gpio_init(unit, (mcpwm_io_signals_t)(MCPWM_CAP_0 + channel), echoPin_);
+
+  mcpwm_capture_config_t config = {};
+  config.cap_edge = MCPWM_BOTH_EDGE;
+  config.cap_prescale = 1;
+  config.capture_cb = onCapture;
+  config.user_data = this;
+  mcpwm_capture_enable_channel(unit, (mcpwm_capture_channel_id_t)(MCPWM_SELECT_CAP0 + channel), &config);
+#else
+  attachInterruptArg(digitalPinToInterrupt(echoPin_), onEchoChange, this, CHANGE);
+#endif
+  return true;
+}
+
+bool Ultrasonic::trigger() {
+  uint32_t now = micros();
+  if (state_ != IDLE || (pinged_ && now - triggerUs_ < ULTRASONIC_CYCLE_US)) {
+    return false;
+  }
+  triggerUs_ = now;
+  pinged_ = true;
+  state_ = WAIT_RISE;
+
+  digitalWrite(trigPin_, HIGH);
+  delayMicroseconds(10);
+  digitalWrite(trigPin_, LOW);
+  return true;
+}
+
+void Ultrasonic::poll() {
+  if (state_ == IDLE || micros() - triggerUs_ <= ECHO_START_US + ULTRASONIC_TIMEOUT_US) {
+    return;
+  }
+  // The echo interrupt may be finishing the same ping: whichever gets the
+  // lock first ends it, the other sees IDLE
+  Reading reading;
+  ULTRASONIC_LOCK();
+  bool overdue = state_ != IDLE;
+  if (overdue) {
+    state_ = IDLE;
+    reading = publish(NO_ECHO, 0);
+  }
+  ULTRASONIC_UNLOCK();
+  if (overdue) {
+    notify(reading);
+  }
+}
+
+bool Ultrasonic::read(Reading &reading) {
+  ULTRASONIC_LOCK();
+  bool fresh = sequence_ != readSequence_;
+  if (fresh) {
+    reading = mailbox_;
+    readSequence_ = sequence_;
+  }
+  ULTRASONIC_UNLOCK();
+  return fresh;
+}
+
+void IRAM_ATTR Ultrasonic::onEchoChange(void *arg) {
+  Ultrasonic *sensor = static_cast<Ultrasonic *>(arg);
+  sensor->onEdge(digitalRead(sensor->echoPin_) == HIGH, micros());
+}
+
+#if ULTRASONIC_CAPTURE_HW
+bool IRAM_ATTR Ultrasonic::onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                     const cap_event_data_t *edata, void *arg) {
+  static_cast<Ultrasonic *>(arg)->onEdge(edata->cap_edge == MCPWM_POS_EDGE, edata->cap_value);
+  return false;
+}
+#endif
+
+void IRAM_ATTR Ultrasonic::onEdge(bool high, uint32_t ticks) {
+  Reading reading;
+  bool ended = false;
+
+  ULTRASONIC_LOCK_ISR();
+  if (high) {
+    if (state_ == WAIT_RISE) {
+      riseTicks_ = ticks;
+      state_ = WAIT_FALL;
+    }
+  }
+  else if (state_ == WAIT_FALL) {
+    state_ = IDLE;
+    uint32_t echoUs = (ticks - riseTicks_) / TICKS_PER_US;
+    reading = publish(echoUs <= ULTRASONIC_TIMEOUT_US ? OK : NO_ECHO, echoUs);
+    ended = true;
+  }
+  ULTRASONIC_UNLOCK_ISR();
+
+  if (ended) {
+    notify(reading);
+  }
+}
+
+// Called with the lock held
+Ultrasonic::Reading IRAM_ATTR Ultrasonic::publish(Status status, uint32_t echoUs) {
+  Reading reading = {status, echoUs, triggerUs_};
+  mailbox_ = reading;
+  sequence_++;
+  return reading;
+}
+
+void IRAM_ATTR Ultrasonic::notify(const Reading &reading) {
+  if (callback_ != NULL) {
+    callback_(reading, callbackArg_);
+  }
+}
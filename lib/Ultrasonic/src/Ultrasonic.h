@@ -0,0 +1,115 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Echo edges are timestamped with micros() in a GPIO interrupt by default.
+// Build with -DULTRASONIC_CAPTURE_HW=1 (ESP32) to have the MCPWM capture
+// units latch the APB timer (12.5 ns) at both edges in hardware instead,
+// which also takes interrupt latency out of the reading. There are six
+// capture channels, so at most six sensors in that mode.
+#ifndef ULTRASONIC_CAPTURE_HW
+#define ULTRASONIC_CAPTURE_HW 0
+#endif
+
+// Echo pulses longer than this count as nothing in range. An HC-SR04 holds
+// the echo high for about 38 ms when nothing reflects; 25 ms is ~4.3 m.
+#ifndef ULTRASONIC_TIMEOUT_US
+#define ULTRASONIC_TIMEOUT_US 25000
+#endif
+
+// Shortest time from one trigger to the next, so echoes of the last ping
+// have died away (the datasheet asks for 60 ms)
+#ifndef ULTRASONIC_CYCLE_US
+#define ULTRASONIC_CYCLE_US 60000
+#endif
+
+#if ULTRASONIC_CAPTURE_HW
+#include <driver/mcpwm.h>
+#endif
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR
+#endif
+
+// HC-SR04 ranging that never waits for the echo.
+//
+// trigger() sends the 10 us trigger pulse and returns. The echo pin's edges
+// are timestamped in an interrupt, and when the echo ends the reading goes
+// into a one-slot mailbox (read()) and to the callback, if one is set. poll()
+// gives up on a ping whose echo never came, so call it now and then, e.g.
+// from the same scheduler task that triggers.
+//
+// The callback runs in the interrupt, or in poll() for a ping that timed out,
+// so it should only hand the reading on (a queue, a task notification).
+class Ultrasonic {
+public:
+  enum Status : uint8_t {
+    OK,      // something reflected the ping
+    NO_ECHO, // nothing in range, or no sensor answering
+  };
+
+  struct Reading {
+    Status status;
+    uint32_t echoUs;    // echo pulse width, the sound's round trip
+    uint32_t triggerUs; // micros() when the ping was sent
+
+    // Distance at 343 m/s (20 C)
+    uint32_t mm() const { return echoUs * 343 / 2000; }
+  };
+
+  typedef void (*Callback)(const Reading &reading, void *arg);
+
+  Ultrasonic(uint8_t trigPin, uint8_t echoPin) : trigPin_(trigPin), echoPin_(echoPin) {}
+
+  // Sets up the pins and the echo interrupt or capture channel. Returns
+  // false when no capture channel is left.
+  bool begin();
+
+  void setCallback(Callback callback, void *arg = NULL) {
+    callbackArg_ = arg;
+    callback_ = callback;
+  }
+
+  // Sends a ping. Returns false, and does nothing, while the last one is
+  // still running or less than ULTRASONIC_CYCLE_US ago.
+  bool trigger();
+
+  // Ends a ping whose echo is overdue with a NO_ECHO reading
+  void poll();
+
+  bool busy() const { return state_ != IDLE; }
+
+  // Copies out the newest reading. Returns false if there has been none
+  // since the last call.
+  bool read(Reading &reading);
+
+private:
+  enum State : uint8_t { IDLE, WAIT_RISE, WAIT_FALL };
+
+  static void IRAM_ATTR onEchoChange(void *arg);
+#if ULTRASONIC_CAPTURE_HW
+  static bool IRAM_ATTR onCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                                  const cap_event_data_t *edata, void *arg);
+#endif
+  void IRAM_ATTR onEdge(bool high, uint32_t ticks);
+  Reading IRAM_ATTR publish(Status status, uint32_t echoUs);
+  void IRAM_ATTR notify(const Reading &reading);
+
+  uint8_t trigPin_;
+  uint8_t echoPin_;
+  volatile State state_ = IDLE;
+  bool pinged_ = false;
+  uint32_t triggerUs_ = 0;
+  uint32_t riseTicks_ = 0; // capture clock at the rising edge
+  Reading mailbox_ = {NO_ECHO, 0, 0};
+  volatile uint8_t sequence_ = 0; // bumped for each reading
+  uint8_t readSequence_ = 0;
+  Callback callback_ = NULL;
+  void *callbackArg_ = NULL;
+#if defined(ARDUINO_ARCH_ESP32)
+  portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED; // state_ and the mailbox
+#endif
+#if ULTRASONIC_CAPTURE_HW
+  static uint8_t captureChannels_;
+#endif
+};
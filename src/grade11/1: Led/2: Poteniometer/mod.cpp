@@ -1,13 +1,21 @@
 #include <Arduino.h>
-
+#include <Telemetry.h>
+#include <RangedMap.h>
 
 const int potentiometerPin = 34; // potentiometer
 const int ledPin = 21;           // LED
 const int buzzerPin = 22;        // Buzzer
 int adcValue = 0;                // potentiometer reading
 
+// Telemetry channels, decode with lib/Telemetry/tools/telemetry2csv
+const uint8_t CH_FREQUENCY = 1;  // Hz
+const uint8_t CH_DELAY = 2;      // ms
+
+Telemetry telemetry(Serial);
+
 void setup()
 {
+    Serial.setTxBufferSize(256);
     Serial.begin(9600);
     pinMode(ledPin, OUTPUT);
 }
@@ -16,18 +24,19 @@ void loop()
 {
     adcValue = analogRead(potentiometerPin);
 
-    int frequency = map(adcValue, 0, 4095, 200, 2000);
+    int frequency = ranged_map<0, 4095, 200, 2000>(adcValue);
     tone(buzzerPin, frequency);
 
-    int percentDelay = map(adcValue, 0, 4095, 1000, 100);
+    int percentDelay = ranged_map<0, 4095, 1000, 100>(adcValue);
 
     digitalWrite(ledPin, HIGH);
     delay(percentDelay);
     digitalWrite(ledPin, LOW);
     delay(percentDelay);
 
-    Serial.print("Frequency: ");
-    Serial.print(frequency);
-    Serial.print(" Hz | Delay: ");
-    Serial.println(percentDelay);
+    telemetry.beginFrame(millis());
+    telemetry.add(CH_FREQUENCY, frequency);
+    telemetry.add(CH_DELAY, percentDelay);
+    telemetry.endFrame();
+    telemetry.pump();
 }
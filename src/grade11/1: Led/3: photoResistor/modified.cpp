@@ -1,5 +1,9 @@
 #include <Arduino.h>
 #include <ESP32Servo.h>
+#include <Telemetry.h>
+#include <SmoothServo.h>
+#include <AdcService.h>
+#include <RangedMap.h>
 
 const int photoresistorPin = 32; // photoresistor
 const int ledPin = 13;           // LED
@@ -10,32 +14,62 @@ int threshold = 700;
 int photoresistorValue = 0;
 int servoPosition = 0;
 
-int minServoAngle = 0;
-int maxServoAngle = 180;
-int minLightValue = 500;
-int maxLightValue = 4000;
+const int minServoAngle = 0;
+const int maxServoAngle = 180;
+const int minLightValue = 500;
+const int maxLightValue = 4000;
+
+// The photoresistor is sampled in the background and averaged 256 to a
+// reading, which also takes out most of the flicker
+AdcService adc;
+int8_t photoresistorIndex;
 
 Servo myServo;
+// Light readings flicker by a few degrees' worth, so the servo only moves
+// when the mapped angle changes by more than servoDeadband
+const uint8_t servoDeadband = 2;
+SmoothServo<Servo> servo(myServo, servoDeadband);
+
+// Telemetry: readings are sent ten to a frame, 100 ms apart, stamped with
+// the time of the first one. Decode with lib/Telemetry/tools/telemetry2csv.
+const uint8_t CH_LIGHT = 1;      // raw ADC reading
+const int readingsPerFrame = 10;
+int readingsInFrame = 0;
+
+Telemetry telemetry(Serial);
 
 void setup()
 {
+    Serial.setTxBufferSize(256);
     Serial.begin(9600);
     delay(1000);
 
     pinMode(ledPin, OUTPUT);
     digitalWrite(ledPin, LOW);
 
+    photoresistorIndex = adc.addPin(photoresistorPin);
+    adc.begin();
 
     myServo.attach(servoPin);
-    myServo.write(90);
+    servo.jumpTo(90);
     delay(500);
 }
 
 void loop()
 {
-    photoresistorValue = analogRead(photoresistorPin);
+    photoresistorValue = adc.read12(photoresistorIndex);
 
-    Serial.println(photoresistorValue);
+    if (readingsInFrame == 0)
+    {
+        telemetry.beginFrame(millis());
+    }
+    telemetry.add(CH_LIGHT, photoresistorValue);
+    if (++readingsInFrame == readingsPerFrame)
+    {
+        telemetry.endFrame();
+        readingsInFrame = 0;
+    }
+    telemetry.pump();
 
     if (photoresistorValue < threshold)
     {
@@ -46,10 +80,9 @@ void loop()
         digitalWrite(ledPin, LOW);
     }
 
-    servoPosition = map(photoresistorValue, minLightValue, maxLightValue, minServoAngle, maxServoAngle);
-    servoPosition = constrain(servoPosition, minServoAngle, maxServoAngle);
+    servoPosition = ranged_map<minLightValue, maxLightValue, minServoAngle, maxServoAngle>(photoresistorValue);
 
-    myServo.write(servoPosition);
+    servo.write(servoPosition);
 
     delay(100);
 }
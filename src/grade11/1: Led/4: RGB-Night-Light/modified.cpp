@@ -1,4 +1,7 @@
 #include <Arduino.h>
+#include <AdcService.h>
+#include <RgbLed.h>
+#include <RangedMap.h>
 
 // Pins
 const int photoresistorPin = 32;
@@ -11,67 +14,51 @@ const int signalPin = 5;
 // photoresistor
 const int threshold = 3500;
 
-// PWM settings
-const int pwmFreq = 5000;
-const int pwmResolution = 8; // 0-255
-const int RedChannel = 0;
-const int GreenChannel = 1;
-const int BlueChannel = 2;
+// The LED follows the pot with short hardware fades, and fades out when
+// the room gets bright
+const uint16_t followFadeMs = 100;
+const uint16_t offFadeMs = 500;
+RgbLed led(RedPin, GreenPin, BluePin);
 
-// Function declaration
-void turnOff();
+// Both inputs are sampled in the background, so loop() never waits on the ADC
+AdcService adc;
+int8_t photoresistorIndex;
+int8_t potentiometerIndex;
 
 void setup()
 {
     Serial.begin(9600);
 
-    ledcSetup(RedChannel, pwmFreq, pwmResolution);
-    ledcAttachPin(RedPin, RedChannel);
-
-    ledcSetup(GreenChannel, pwmFreq, pwmResolution);
-    ledcAttachPin(GreenPin, GreenChannel);
-
-    ledcSetup(BlueChannel, pwmFreq, pwmResolution);
-    ledcAttachPin(BluePin, BlueChannel);
+    led.begin();
 
     pinMode(signalPin, OUTPUT);
     digitalWrite(signalPin, LOW);
 
+    photoresistorIndex = adc.addPin(photoresistorPin);
+    potentiometerIndex = adc.addPin(potentiometerPin);
+    adc.begin();
 }
 
 void loop()
 {
-    int photoresistor = analogRead(photoresistorPin);
-    int potentiometer = analogRead(potentiometerPin);
+    int photoresistor = adc.read12(photoresistorIndex);
+    int potentiometer = adc.read12(potentiometerIndex);
 
     if (photoresistor > threshold)
     {
         digitalWrite(signalPin, LOW);
-        int redValue = map(potentiometer, 0, 4095, 255, 0);
-        int greenValue = map(potentiometer, 0, 4095, 0, 255);
-        int blueValue = map(potentiometer, 2048, 4095, 0, 255);
-
-        if (potentiometer < 2048)
-        {
-            blueValue = 0;
-        }
+        int redValue = ranged_map<0, 4095, 255, 0>(potentiometer);
+        int greenValue = ranged_map<0, 4095, 0, 255>(potentiometer);
+        // Saturates at 0 for the bottom half of the pot's travel
+        int blueValue = ranged_map<2048, 4095, 0, 255>(potentiometer);
 
-        ledcWrite(RedChannel, redValue);
-        ledcWrite(GreenChannel, greenValue);
-        ledcWrite(BlueChannel, blueValue);
+        led.setColor(redValue, greenValue, blueValue, followFadeMs);
     }
     else
     {
-        turnOff();
+        led.off(offFadeMs);
         digitalWrite(signalPin, HIGH);
     }
 
     delay(100);
 }
-
-void turnOff()
-{
-    ledcWrite(RedChannel, 0);
-    ledcWrite(GreenChannel, 0);
-    ledcWrite(BlueChannel, 0);
-}
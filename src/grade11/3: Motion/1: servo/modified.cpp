@@ -1,12 +1,17 @@
 #include <Arduino.h>
 #include <ESP32Servo.h>
+#include <PinGroup.h>
+#include <SmoothServo.h>
+#include <RangedMap.h>
 
 
 const int potPin = 34;
 const int servoPin = 23;
 
 // 7-segment display pins
-const int segmentPins[7] = {13, 12, 14, 27, 26, 25, 33}; // a,b,c,d,e,f,g
+// Written as one group, so a digit is two register writes (GPIO33 is in the
+// second bank) instead of seven digitalWrite() calls
+typedef PinGroup<13, 12, 14, 27, 26, 25, 33> Segments; // a,b,c,d,e,f,g
 const int digitPin = 9;
 
 byte digits[10][7] = {
@@ -29,6 +34,9 @@ int displayValue;
 bool isCommonCathode = true;
 
 Servo myservo;
+// ADC noise moves the mapped angle by about a degree; ignore changes that
+// small so the servo holds still
+SmoothServo<Servo> servo(myservo, 1);
 
 void displayDigit(int num);
 void clearDisplay();
@@ -46,11 +54,8 @@ void setup()
     myservo.attach(servoPin, 500, 2400);
 
     // Initialize display segments
-    for (int i = 0; i < 7; i++)
-    {
-        pinMode(segmentPins[i], OUTPUT);
-        digitalWrite(segmentPins[i], isCommonCathode ? LOW : HIGH);
-    }
+    Segments::begin();
+    clearDisplay();
 
     // Initialize common pin
     pinMode(digitPin, OUTPUT);
@@ -63,8 +68,8 @@ void setup()
 void loop()
 {
     potPosition = analogRead(potPin);
-    servoPosition = map(potPosition, 0, 4095, 20, 160);
-    myservo.write(servoPosition);
+    servoPosition = ranged_map<0, 4095, 20, 160>(potPosition);
+    servo.write(servoPosition);
 
     displayValue = servoPosition / 20;
     if (displayValue > 9)
@@ -81,18 +86,16 @@ void displayDigit(int num)
     if (num < 0 || num > 9)
         return;
 
+    uint8_t bits = 0;
     for (int i = 0; i < 7; i++)
     {
-        digitalWrite(segmentPins[i], isCommonCathode ?
-                    digits[num][i] : !digits[num][i]);
+        bits |= digits[num][i] << i;
     }
+    Segments::write(isCommonCathode ? bits : ~bits & 0x7F);
 }
 
 // Clear the display
 void clearDisplay()
 {
-    for (int i = 0; i < 7; i++)
-    {
-        digitalWrite(segmentPins[i], isCommonCathode ? LOW : HIGH);
-    }
+    Segments::write(isCommonCathode ? 0 : 0x7F);
 }
@@ -1,4 +1,8 @@
 #include <Arduino.h>
+#include <Ultrasonic.h>
+#include <AdcService.h>
+#include <RgbLed.h>
+#include <RangedMap.h>
 
 const int trigPin = 26;
 const int echoPin = 27;
@@ -8,37 +12,36 @@ const int redPin = 19;
 const int greenPin = 21;
 const int bluePin = 18;
 
-const int freq = 5000;
-const int redChannel = 0;
-const int greenChannel = 1;
-const int blueChannel = 2;
-const int resolution = 8;
+// Zone changes fade in hardware over this long
+const uint16_t colorFadeMs = 200;
 
-float distance = 0;
+// Nothing in range reads as this far (inches), so it counts as all clear
+const float noEchoDistance = 1000;
+
+float distance = noEchoDistance;
 int potValue = 0;
 int threshold1 = 10;
 int threshold2 = 20;
 int maxDistance = 60;
 
+Ultrasonic sonar(trigPin, echoPin);
+RgbLed led(redPin, greenPin, bluePin);
+
+// The pot is sampled in the background, so loop() never waits on the ADC
+AdcService adc;
+int8_t potIndex;
+
 float getDistance();
-void setColor(int red, int green, int blue);
 void updateThresholds();
 
 void setup()
 {
     Serial.begin(115200);
 
-    pinMode(trigPin, OUTPUT);
-    pinMode(echoPin, INPUT);
-    pinMode(potPin, INPUT);
-
-    ledcSetup(redChannel, freq, resolution);
-    ledcSetup(greenChannel, freq, resolution);
-    ledcSetup(blueChannel, freq, resolution);
-
-    ledcAttachPin(redPin, redChannel);
-    ledcAttachPin(greenPin, greenChannel);
-    ledcAttachPin(bluePin, blueChannel);
+    sonar.begin();
+    potIndex = adc.addPin(potPin);
+    adc.begin();
+    led.begin();
 }
 
 void loop()
@@ -47,23 +50,24 @@ void loop()
     distance = getDistance();
 
     if (distance <= threshold1) {
-        setColor(255, 0, 0);
+        led.setColor(255, 0, 0, colorFadeMs);
     }
     else if (distance > threshold1 && distance < threshold2) {
-        setColor(255, 50, 0);
+        led.setColor(255, 50, 0, colorFadeMs);
     }
     else {
-        setColor(0, 255, 0);
+        led.setColor(0, 255, 0, colorFadeMs);
     }
 
-    delay(50);
+    // Readings arrive about every 60 ms, the sensor's ping cycle
+    delay(10);
 }
 
 void updateThresholds()
 {
-    potValue = analogRead(potPin);
+    potValue = adc.read12(potIndex);
 
-    threshold1 = map(potValue, 0, 4095, 1, 30);
+    threshold1 = ranged_map<0, 4095, 1, 30>(potValue);
     threshold2 = threshold1 + 10;
     if (threshold2 > maxDistance)
     {
@@ -71,26 +75,18 @@ void updateThresholds()
     }
 }
 
-void setColor(int red, int green, int blue)
-{
-    ledcWrite(redChannel, red);
-    ledcWrite(greenChannel, green);
-    ledcWrite(blueChannel, blue);
-}
-
+// Latest distance in inches (148 us of echo per inch). Pings go out in the
+// background and their echoes are timed by interrupt, so this never waits.
 float getDistance()
 {
-    float echoTime;
-    float calculatedDistance;
-
-    digitalWrite(trigPin, LOW);
-    delayMicroseconds(2);
-    digitalWrite(trigPin, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trigPin, LOW);
+    Ultrasonic::Reading reading;
 
-    echoTime = pulseIn(echoPin, HIGH);
-    calculatedDistance = echoTime / 148.0;
+    sonar.poll();
+    if (sonar.read(reading))
+    {
+        distance = reading.status == Ultrasonic::OK ? reading.echoUs / 148.0 : noEchoDistance;
+    }
+    sonar.trigger();
 
-    return calculatedDistance;
+    return distance;
 }
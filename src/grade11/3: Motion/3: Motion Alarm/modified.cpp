@@ -1,5 +1,9 @@
 #include <Arduino.h>
 #include <ESP32Servo.h>
+#include <Scheduler.h>
+#include <SonarArray.h>
+#include <RangeFilter.h>
+#include <RgbLed.h>
 
 const int trigPin = 26;
 const int echoPin = 27;
@@ -11,23 +15,59 @@ const int servoPin = 23;
 const int buttonPin = 15;
 
 // PWM settings
-const int freq = 5000;
 const int buzzerChannel = 3;
-const int redChannel = 0;
-const int greenChannel = 1;
-const int blueChannel = 2;
 const int resolution = 8;
 
-float distance = 0;
+// Color changes while monitoring fade in hardware over this long
+const uint16_t colorFadeMs = 250;
+
+const unsigned long monitorInterval = 10; // ms between distance checks
+const unsigned long sonarInterval = 1;    // ms between sonar round updates
+
+// Nothing in range reads as this far (inches), so it counts as all clear
+const float noEchoDistance = 1000;
+
+// Alarm when something is this close (inches), or inside the warning
+// distance and closing in faster than approachAlarmSpeed (inches per second)
+const float alarmDistance = 10;
+const float warningDistance = 20;
+const float approachAlarmSpeed = 20;
+
+float distance = noEchoDistance;
 bool alarmActive = false;
 unsigned long alarmStartTime = 0;
-unsigned long lastServoMove = 0;
 int servoPosition = 90;
 int jerkCounter = 0;
 
 Servo myservo;
+RgbLed led(redPin, greenPin, bluePin);
+
+// Perimeter sensors, pinged one after another. Add a sensor (up to 8) with
+// its own trigger and echo pins, and the direction it faces in degrees.
+Ultrasonic sonars[] = {
+    Ultrasonic(trigPin, echoPin),
+};
+const int16_t sonarBearings[] = {0};
+const int sonarCount = sizeof(sonars) / sizeof(sonars[0]);
+SonarArray perimeter;
+
+// Each sensor's readings are filtered before the alarm looks at them, so one
+// stray echo cannot set it off. Nothing in range is filtered as the
+// furthest the sensor can see.
+const int32_t noEchoMm = ULTRASONIC_TIMEOUT_US * 343L / 2000;
+RangeFilter<5> filters[sonarCount];
+uint32_t filteredReadings[sonarCount]; // readings already passed to the filter
+int closestSensor = -1;                // sensor with the nearest filtered distance
+
+// loop() runs these when they are due and sleeps the rest of the time
+Scheduler scheduler;
+uint8_t monitorTask = Scheduler::NO_TASK;
+uint8_t jerkTask = Scheduler::NO_TASK;
+
+void monitor();
+void updateSonars();
 float getDistance();
-void setColor(int red, int green, int blue);
+float getApproachSpeed();
 void triggerAlarm();
 void stopAlarm();
 bool checkButtonPress();
@@ -37,18 +77,15 @@ void setup()
 {
     Serial.begin(115200);
 
-    pinMode(trigPin, OUTPUT);
-    pinMode(echoPin, INPUT);
+    for (int i = 0; i < sonarCount; i++)
+    {
+        perimeter.add(sonars[i], sonarBearings[i]);
+    }
+    perimeter.begin();
     pinMode(buttonPin, INPUT_PULLUP);
 
-    ledcSetup(redChannel, freq, resolution);
-    ledcSetup(greenChannel, freq, resolution);
-    ledcSetup(blueChannel, freq, resolution);
+    led.begin();
     ledcSetup(buzzerChannel, 2000, resolution);
-
-    ledcAttachPin(redPin, redChannel);
-    ledcAttachPin(greenPin, greenChannel);
-    ledcAttachPin(bluePin, blueChannel);
     ledcAttachPin(buzzerPin, buzzerChannel);
 
     // Initialize servo
@@ -64,12 +101,24 @@ void setup()
     delay(500);
 
     // Startup indication
-    setColor(0, 0, 255); // Blue for startup
+    led.setColor(0, 0, 255); // Blue for startup
     delay(1000);
-    setColor(0, 255, 0); // Green for monitoring
+    led.setColor(0, 255, 0, colorFadeMs); // Green for monitoring
+
+    unsigned long now = millis();
+    monitorTask = scheduler.every(monitorInterval, monitor, now);
+    scheduler.every(sonarInterval, updateSonars, now);
+    // The servo only jerks while the alarm is going
+    jerkTask = scheduler.add(servoJerk);
 }
 
 void loop()
+{
+    // delay() lets FreeRTOS idle the CPU until the next task is due
+    delay(scheduler.run(millis()));
+}
+
+void monitor()
 {
     if (alarmActive && checkButtonPress())
     {
@@ -79,89 +128,92 @@ void loop()
     if (!alarmActive)
     {
         distance = getDistance();
-        if (distance <= 10)
+        if (distance <= alarmDistance ||
+            (distance < warningDistance && getApproachSpeed() >= approachAlarmSpeed))
         {
             triggerAlarm();
         }
-        else if (10 < distance && distance < 20)
+        else if (distance < warningDistance)
         {
-            setColor(255, 50, 0);
+            led.setColor(255, 50, 0, colorFadeMs);
         }
         else
         {
-            setColor(0, 255, 0);
+            led.setColor(0, 255, 0, colorFadeMs);
         }
     }
     else
     {
         unsigned long currentMillis = millis();
-        servoJerk();
 
         if ((currentMillis - alarmStartTime) % 300 < 150)
         {
             ledcWriteTone(buzzerChannel, 800);
-            setColor(255, 0, 0);
+            led.setColor(255, 0, 0);
         }
         else
         {
             ledcWriteTone(buzzerChannel, 400);
-            setColor(200, 0, 0);
+            led.setColor(200, 0, 0);
         }
     }
-
-    delay(10);
 }
 
+// Runs as a one-shot task that re-arms itself after a random 50-150 ms
 void servoJerk()
 {
-    unsigned long currentMillis = millis();
+    jerkCounter++;
 
-    if (currentMillis - lastServoMove >= 50 + random(0, 100))
+    switch (jerkCounter % 5)
     {
-        jerkCounter++;
-
-        switch (jerkCounter % 5)
-        {
-        case 0:
-            servoPosition = 20;  // Far left
-            break;
-        case 1:
-            servoPosition = 160; // Far right
-            break;
-        case 2:
-            servoPosition += random(-30, 30);
-            break;
-        case 3:
-            servoPosition = random(20, 160);
-            break;
-        case 4:
-            servoPosition = 90; // Center
-            break;
-        }
-
-        servoPosition = constrain(servoPosition, 20, 160);
-        myservo.write(servoPosition);
-        lastServoMove = currentMillis;
+    case 0:
+        servoPosition = 20;  // Far left
+        break;
+    case 1:
+        servoPosition = 160; // Far right
+        break;
+    case 2:
+        servoPosition += random(-30, 30);
+        break;
+    case 3:
+        servoPosition = random(20, 160);
+        break;
+    case 4:
+        servoPosition = 90; // Center
+        break;
     }
+
+    servoPosition = constrain(servoPosition, 20, 160);
+    myservo.write(servoPosition);
+    scheduler.restart(jerkTask, 50 + random(0, 100), millis());
 }
 
 void triggerAlarm()
 {
+    Serial.print("Intruder at ");
+    Serial.print(distance);
+    Serial.print(" in, bearing ");
+    Serial.print(sonarBearings[closestSensor]);
+    Serial.print(", closing at ");
+    Serial.print(getApproachSpeed());
+    Serial.println(" in/s");
+
     alarmActive = true;
     alarmStartTime = millis();
-    lastServoMove = millis();
     jerkCounter = 0;
+    scheduler.restart(jerkTask, 50 + random(0, 100), alarmStartTime);
 }
 
 void stopAlarm()
 {
 
     ledcWrite(buzzerChannel, 0);
+    scheduler.cancel(jerkTask);
     myservo.write(90);
 
-    setColor(0, 0, 255);
+    led.setColor(0, 0, 255);
     delay(500);
-    setColor(0, 255, 0);
+    led.setColor(0, 255, 0, colorFadeMs);
 
     alarmActive = false;
 }
@@ -187,28 +239,43 @@ bool checkButtonPress()
     return false;
 }
 
-void setColor(int red, int green, int blue)
+void updateSonars()
 {
-    ledcWrite(redChannel, red);
-    ledcWrite(greenChannel, green);
-    ledcWrite(blueChannel, blue);
+    perimeter.update();
+
+    for (int i = 0; i < sonarCount; i++)
+    {
+        const SonarArray::SensorStats &stats = perimeter.stats(i);
+        if (stats.readings != filteredReadings[i])
+        {
+            filteredReadings[i] = stats.readings;
+            filters[i].add(stats.inRange ? stats.lastMm : noEchoMm, millis());
+        }
+    }
 }
 
+// Closest filtered distance any sensor sees, in inches. Pings go out in the
+// background and their echoes are timed by interrupt, so this never waits.
 float getDistance()
 {
-    float echoTime;
-    float calculatedDistance;
-
-    // Send trigger pulse
-    digitalWrite(trigPin, LOW);
-    delayMicroseconds(2);
-    digitalWrite(trigPin, HIGH);
-    delayMicroseconds(10);
-    digitalWrite(trigPin, LOW);
-
-    echoTime = pulseIn(echoPin, HIGH);
-
-    calculatedDistance = echoTime / 148.0;
+    closestSensor = -1;
+    for (int i = 0; i < sonarCount; i++)
+    {
+        if (filters[i].ready() &&
+            (closestSensor < 0 || filters[i].distance() < filters[closestSensor].distance()))
+        {
+            closestSensor = i;
+        }
+    }
+    return closestSensor >= 0 ? filters[closestSensor].distance() / 25.4 : noEchoDistance;
+}
 
-    return calculatedDistance;
+// How fast the nearest object is coming closer, in inches per second
+float getApproachSpeed()
+{
+    if (closestSensor < 0 || filters[closestSensor].velocity() >= 0)
+    {
+        return 0;
+    }
+    return -filters[closestSensor].velocity() / 25.4;
 }
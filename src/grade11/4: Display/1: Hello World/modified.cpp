@@ -1,6 +1,8 @@
 #include <Arduino.h>
 #include <LiquidCrystal.h>
+#include <LcdFrame.h>
 LiquidCrystal lcd(13, 12, 14, 27, 26, 25);
+LcdFrame screen(lcd);
 
 const int buttonPin = 22;
 
@@ -12,17 +14,18 @@ int counter = 0;
 void setup()
 {
     lcd.begin(16, 2);
-    lcd.clear();
+    screen.begin();
 
     pinMode(buttonPin, INPUT_PULLUP);
 
     // Initial display
-    lcd.setCursor(0, 0);
-    lcd.print("Hello, world!");
+    screen.setCursor(0, 0);
+    screen.print("Hello, world!");
 
-    lcd.setCursor(0, 1);
-    lcd.print("Counter: ");
-    lcd.print(counter);
+    screen.setCursor(0, 1);
+    screen.print("Counter: ");
+    screen.print(counter);
+    screen.render();
 }
 
 void loop()
@@ -33,9 +36,10 @@ void loop()
         counter++;
 
         // Update counter on LCD
-        lcd.setCursor(9, 1);
-        lcd.print(counter);
-        lcd.print("      ");
+        screen.setCursor(9, 1);
+        screen.print(counter);
+        screen.print("      ");
+        screen.render();
     }
 
     lastButtonState = buttonState;
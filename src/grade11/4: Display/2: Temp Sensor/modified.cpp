@@ -1,75 +1,107 @@
 #include <Arduino.h>
 #include <LiquidCrystal.h>
+#include <LcdFrame.h>
+#include <AdcService.h>
+#include <Tmp36.h>
+#include <BeepPlayer.h>
 
 LiquidCrystal lcd(13, 12, 14, 27, 26, 25);
+LcdFrame screen(lcd);
 
 const int tempSensorPin = 34;
 const int buzzerPin = 22;
 
-const float alarmTemperature = 25.0;
+// Temperatures are in 0.01 degrees
+const int16_t alarmTemperature = 2500;
+// Once on, the alarm stays on until the temperature is this far back under
+// alarmTemperature, so a reading hovering at the threshold cannot toggle it
+const int16_t alarmHysteresis = 50;
+bool alarmOn = false;
 
-float voltage = 0;
-float degreesC = 0;
-float degreesF = 0;
+int16_t degreesC = 0;
+int16_t degreesF = 0;
 
-void soundAlarm();
+// The sensor is sampled in the background and averaged 256 to a reading
+AdcService adc;
+int8_t tempSensorIndex;
+Tmp36 tempSensor;
+
+// Two beeps, then a second's quiet, until the alarm clears. The buzzer is
+// switched from timer callbacks, so loop() keeps sampling and drawing.
+const BeepPlayer::Step alarmSteps[] = {{300, 200}, {300, 1000}};
+const BeepPlayer::Pattern alarmPattern = {alarmSteps, 2, BeepPlayer::FOREVER};
+BeepPlayer buzzer(buzzerPin);
+
+void printDegrees(int16_t centiDegrees);
 
 void setup()
 {
     lcd.begin(16, 2);
-    lcd.clear();
+    screen.begin();
 
     Serial.begin(9600);
 
-    pinMode(buzzerPin, OUTPUT);
-    digitalWrite(buzzerPin, LOW);
+    buzzer.begin();
 
-    analogSetWidth(12);
-    analogSetAttenuation(ADC_11db);
+    tempSensorIndex = adc.addPin(tempSensorPin);
+    adc.begin();
+    tempSensor.begin();
 }
 
 void loop()
 {
-    int sensorValue = analogRead(tempSensorPin);
-
-    voltage = sensorValue * (3.3 / 4095.0);
+    uint16_t sensorValue = adc.read(tempSensorIndex);
 
-    // Calculate temperature values
-    degreesC = ((voltage - 0.5) * 100.0) + 14;
-    degreesF = degreesC * (9.0 / 5.0) + 32.0;
+    // Calibrated table lookup, no floats
+    degreesC = tempSensor.centiCelsius(sensorValue, AdcService::BITS);
+    degreesF = Tmp36::toCentiFahrenheit(degreesC);
 
     // Display temperature on LCD
-    lcd.clear();
+    screen.clear();
 
-    lcd.setCursor(0, 0);
-    lcd.print("Degrees C: ");
-    lcd.print(degreesC, 1);
+    screen.setCursor(0, 0);
+    screen.print("Degrees C: ");
+    printDegrees(degreesC);
 
-    lcd.setCursor(0, 1);
-    lcd.print("Degrees F: ");
-    lcd.print(degreesF, 1);
+    screen.setCursor(0, 1);
+    screen.print("Degrees F: ");
+    printDegrees(degreesF);
 
     if (degreesC > alarmTemperature)
     {
-        lcd.setCursor(14, 0);
-        lcd.print("!");
-        soundAlarm();
+        alarmOn = true;
+    }
+    else if (degreesC < alarmTemperature - alarmHysteresis)
+    {
+        alarmOn = false;
     }
-    else
+
+    if (alarmOn)
+    {
+        screen.setCursor(14, 0);
+        screen.print("!");
+        buzzer.play(alarmPattern);
+    }
+    else if (buzzer.playing())
     {
-        digitalWrite(buzzerPin, LOW);
+        buzzer.stop();
     }
+    screen.render();
 
-    delay(1000);
+    // Only changed characters go to the LCD, so redrawing often is cheap
+    delay(100);
 }
 
-void soundAlarm()
+// Prints 0.01 degrees to one decimal place, rounded
+void printDegrees(int16_t centiDegrees)
 {
-    digitalWrite(buzzerPin, HIGH);
-    delay(300);
-    digitalWrite(buzzerPin, LOW);
-    delay(200);
-    digitalWrite(buzzerPin, HIGH);
-    delay(300);
-    digitalWrite(buzzerPin, LOW);
+    int16_t tenths = (centiDegrees + (centiDegrees < 0 ? -5 : 5)) / 10;
+    if (tenths < 0)
+    {
+        screen.print('-');
+        tenths = -tenths;
+    }
+    screen.print(tenths / 10);
+    screen.print('.');
+    screen.print(tenths % 10);
 }
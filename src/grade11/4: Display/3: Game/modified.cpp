@@ -1,7 +1,12 @@
 #include <Arduino.h>
 #include <LiquidCrystal.h>
+#include <LcdFrame.h>
+#include <AsyncLcd.h>
+#include <RgbLed.h>
 
 LiquidCrystal lcd(13, 12, 14, 27, 26, 25);
+LcdFrame frame(lcd);
+AsyncLcd screen(frame); // drawn by a task on core 0
 
 const int buttonPin = 22;
 const int buzzerPin = 23;
@@ -11,12 +16,10 @@ const int redPin = 19;
 const int greenPin = 18;
 const int bluePin = 5;
 
-// PWM settings
-const int freq = 5000;
-const int redChannel = 0;
-const int greenChannel = 1;
-const int blueChannel = 2;
-const int resolution = 8;
+// Faded in hardware, off the LEDC channels tone() uses
+RgbLed led(redPin, greenPin, bluePin);
+// The countdown fades from one band's color to the next over this long
+const uint16_t countdownFadeMs = 1000;
 
 int buttonPressTime = 0;
 long timeLimit = 15000;
@@ -37,25 +40,17 @@ void showStartSequence();
 void generateRandomOrder();
 void gameOver();
 void winner();
-void setRgbColor(int red, int green, int blue);
 void updateRgbCountdown(int timeRemaining);
 
 void setup() {
   pinMode(buttonPin, INPUT_PULLUP);
 
   lcd.begin(16, 2);
+  screen.begin();
 
   Serial.begin(9600);
 
-  ledcSetup(redChannel, freq, resolution);
-  ledcSetup(greenChannel, freq, resolution);
-  ledcSetup(blueChannel, freq, resolution);
-
-  ledcAttachPin(redPin, redChannel);
-  ledcAttachPin(greenPin, greenChannel);
-  ledcAttachPin(bluePin, blueChannel);
-
-  setRgbColor(0, 0, 0);
+  led.begin();
 
   for (int i = 0; i < arraySize; i++) {
     sequence[i] = -1;
@@ -69,12 +64,13 @@ void setup() {
 
 void loop() {
   for (int i = 0; i < arraySize; i++) {
-    lcd.clear();
+    screen.clear();
 
     roundNumber = i + 1;
-    lcd.print(roundNumber);
-    lcd.print(": ");
-    lcd.print(words[sequence[i]]);
+    screen.print(roundNumber);
+    screen.print(": ");
+    screen.print(words[sequence[i]]);
+    screen.render();
 
 
     startTime = millis();
@@ -85,10 +81,11 @@ void loop() {
 
       updateRgbCountdown(timeRemaining);
 
-      lcd.setCursor(14, 1);
-      lcd.print("  ");
-      lcd.setCursor(14, 1);
-      lcd.print(roundedTime);
+      screen.setCursor(14, 1);
+      screen.print("  ");
+      screen.setCursor(14, 1);
+      screen.print(roundedTime);
+      screen.render();
       delay(15);
 
       if (millis() - startTime > timeLimit) {
@@ -100,7 +97,7 @@ void loop() {
       }
     }
 
-    setRgbColor(0, 0, 0);
+    led.setColor(0, 0, 0);
     delay(500);
   }
 
@@ -108,42 +105,47 @@ void loop() {
 }
 
 void showStartSequence() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Category:");
-  lcd.setCursor(0, 1);
-  lcd.print("Animals");
+  screen.clear();
+  screen.setCursor(0, 0);
+  screen.print("Category:");
+  screen.setCursor(0, 1);
+  screen.print("Animals");
+  screen.render();
 
   for (int i = 0; i < 4; i++) {
-    setRgbColor(0, 255, 0);
+    led.setColor(0, 255, 0);
     delay(250);
-    setRgbColor(0, 0, 0);
+    led.setColor(0, 0, 0);
     delay(250);
   }
 
   delay(1000);
 
-  lcd.clear();
-  lcd.print("Get ready!");
-  setRgbColor(0, 0, 255);
+  screen.clear();
+  screen.print("Get ready!");
+  screen.render();
+  led.setColor(0, 0, 255);
   delay(1000);
 
-  lcd.clear();
-  lcd.print("3");
-  setRgbColor(0, 255, 0);
+  screen.clear();
+  screen.print("3");
+  screen.render();
+  led.setColor(0, 255, 0);
   delay(1000);
 
-  lcd.clear();
-  lcd.print("2");
-  setRgbColor(255, 255, 0);
+  screen.clear();
+  screen.print("2");
+  screen.render();
+  led.setColor(255, 255, 0);
   delay(1000);
 
-  lcd.clear();
-  lcd.print("1");
-  setRgbColor(255, 0, 0);
+  screen.clear();
+  screen.print("1");
+  screen.render();
+  led.setColor(255, 0, 0);
   delay(1000);
 
-  setRgbColor(0, 0, 0);
+  led.setColor(0, 0, 0);
 }
 
 void generateRandomOrder() {
@@ -173,20 +175,21 @@ void generateRandomOrder() {
 }
 
 void gameOver() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Game Over");
-  lcd.setCursor(0, 1);
-  lcd.print("Score: ");
-  lcd.print(roundNumber);
+  screen.clear();
+  screen.setCursor(0, 0);
+  screen.print("Game Over");
+  screen.setCursor(0, 1);
+  screen.print("Score: ");
+  screen.print(roundNumber);
+  screen.render();
 
   Serial.print("Game Over! Final Score: ");
   Serial.println(roundNumber);
 
   for (int i = 0; i < 5; i++) {
-    setRgbColor(255, 0, 0);
+    led.setColor(255, 0, 0);
     delay(200);
-    setRgbColor(0, 0, 0);
+    led.setColor(0, 0, 0);
     delay(200);
   }
 
@@ -199,34 +202,35 @@ void gameOver() {
   tone(buzzerPin, 98, 500);
   delay(500);
 
-  setRgbColor(255, 0, 0);
+  led.setColor(255, 0, 0);
 
   while (true) {}
 }
 
 void winner() {
-  lcd.clear();
-  lcd.setCursor(7, 0);
-  lcd.print("YOU");
-  lcd.setCursor(7, 1);
-  lcd.print("WIN!");
+  screen.clear();
+  screen.setCursor(7, 0);
+  screen.print("YOU");
+  screen.setCursor(7, 1);
+  screen.print("WIN!");
+  screen.render();
 
   Serial.println("YOU WIN!");
 
   for (int i = 0; i < 3; i++) {
-    setRgbColor(255, 0, 0);    // Red
+    led.setColor(255, 0, 0);    // Red
     delay(200);
-    setRgbColor(255, 165, 0);  // Orange
+    led.setColor(255, 165, 0);  // Orange
     delay(200);
-    setRgbColor(255, 255, 0);  // Yellow
+    led.setColor(255, 255, 0);  // Yellow
     delay(200);
-    setRgbColor(0, 255, 0);    // Green
+    led.setColor(0, 255, 0);    // Green
     delay(200);
-    setRgbColor(0, 0, 255);    // Blue
+    led.setColor(0, 0, 255);    // Blue
     delay(200);
-    setRgbColor(75, 0, 130);   // Indigo
+    led.setColor(75, 0, 130);   // Indigo
     delay(200);
-    setRgbColor(238, 130, 238);// Violet
+    led.setColor(238, 130, 238);// Violet
     delay(200);
   }
 
@@ -244,41 +248,35 @@ void winner() {
   tone(buzzerPin, 3135, 500);
   delay(500);
 
-  setRgbColor(0, 255, 0);
+  led.setColor(0, 255, 0);
 
   while (true) {}
 }
 
-void setRgbColor(int red, int green, int blue) {
-  ledcWrite(redChannel, red);
-  ledcWrite(greenChannel, green);
-  ledcWrite(blueChannel, blue);
-}
-
 void updateRgbCountdown(int timeRemaining) {
   int percentage = (timeRemaining * 100) / timeLimit;
 
   if (percentage > 75) {
-    setRgbColor(0, 255, 0);
+    led.setColor(0, 255, 0, countdownFadeMs);
   }
   else if (percentage > 50) {
-    setRgbColor(128, 255, 0);
+    led.setColor(128, 255, 0, countdownFadeMs);
   }
   else if (percentage > 25) {
-    setRgbColor(255, 255, 0);
+    led.setColor(255, 255, 0, countdownFadeMs);
   }
   else if (percentage > 10) {
-    setRgbColor(255, 128, 0);
+    led.setColor(255, 128, 0, countdownFadeMs);
   }
   else {
     if (percentage < 5) {
       if (millis() % 300 < 150) {
-        setRgbColor(255, 0, 0);
+        led.setColor(255, 0, 0);
       } else {
-        setRgbColor(0, 0, 0);
+        led.setColor(0, 0, 0);
       }
     } else {
-      setRgbColor(255, 0, 0);
+      led.setColor(255, 0, 0);
     }
   }
 }
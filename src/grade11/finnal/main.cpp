@@ -1,5 +1,30 @@
 #include <Arduino.h>
 #include <LiquidCrystal.h>
+#include <LcdFrame.h>
+#include <AsyncLcd.h>
+#include <SpscRing.h>
+#include <LoopProfiler.h>
+#include <AdaptiveSignal.h>
+#include <SpeedStats.h>
+#include <Telemetry.h>
+#include <Scheduler.h>
+#include <esp_timer.h>
+
+// Speed sensor edges are timestamped with a 64-bit clock. By default that is
+// esp_timer (1 us) read inside the GPIO interrupt. Build with
+// -DSPEED_CAPTURE_HW=1 to have the MCPWM capture unit latch the APB timer
+// (12.5 ns) in hardware at the edge instead, which also removes ISR latency
+// from the speed and lets the profiler measure that latency.
+#ifndef SPEED_CAPTURE_HW
+#define SPEED_CAPTURE_HW 0
+#endif
+
+#if SPEED_CAPTURE_HW
+#include <driver/mcpwm.h>
+#include <driver/gpio.h>
+#include <hal/mcpwm_ll.h>
+#include <soc/mcpwm_struct.h>
+#endif
 
 // Traffic Light Pins (output) [red, yellow, green]
 const int trafficLight1[3] = {19, 2, 4};   // GPIO19, GPIO2, GPIO4
@@ -8,10 +33,10 @@ const int trafficLight2[3] = {5, 15, 18};  // GPIO5, GPIO15, GPIO18
 // Speed checker pins (input) [sensor1, sensor2]
 const int speedSensors[2] = {22, 23};      // GPIO22, GPIO23
 
-// Pedestrian pins (not implemented in this version) [ped1, ped2]
+// Pedestrian pins (input) [ped1, ped2]
 const int pedestrians[2] = {32, 21};       // GPIO32, GPIO21
 
-// Night light sensor (not implemented in this version)
+// Night light sensor (input)
 const int nightSensor = 33;  // GPIO33
 
 // LCD pins [RS, EN, D4, D5, D6, D7]
@@ -23,6 +48,17 @@ const int yellowTime = 3000;
 const int redTime = 2000;
 const int allRedTime = 2000;
 
+// Adaptive green times. Each green is sized from the cars queued on that road
+// and its recent arrival rate, between minGreenTime and maxGreenTime; the
+// table's greenTime is only used with adaptive timing off (serial 'a').
+// Road 1 cars are counted by the speed sensors. Road 2 has no vehicle
+// detector, so the pedestrian button for crossing road 1 is its call input.
+const int minGreenTime = 5000;
+const int maxGreenTime = 30000;
+const int dischargeHeadway = 2000; // ms per queued car once moving
+const int startupLostTime = 2000;  // ms before the first car moves
+bool adaptiveTiming = true;
+
 // Traffic light states
 const int STATE_1_GREEN = 0;
 const int STATE_1_YELLOW = 1;
@@ -31,16 +67,27 @@ const int STATE_2_GREEN = 3;
 const int STATE_2_YELLOW = 4;
 const int STATE_2_RED = 5;
 
-// Light combinations for each state [light1_color, light2_color]
-// where color index: 0=red, 1=yellow, 2=green
-const int lightStates[6][2] = {
-  {2, 0}, // STATE_1_GREEN:  Light1=Green, Light2=Red
-  {1, 0}, // STATE_1_YELLOW: Light1=Yellow, Light2=Red
-  {0, 0}, // STATE_1_RED:    Light1=Red, Light2=Red
-  {0, 2}, // STATE_2_GREEN:  Light1=Red, Light2=Green
-  {0, 1}, // STATE_2_YELLOW: Light1=Red, Light2=Yellow
-  {0, 0}  // STATE_2_RED:    Light1=Red, Light2=Red
+// Phase table, one row per state [light1_color, light2_color, duration_ms]
+// where color index: 0=red, 1=yellow, 2=green.
+// States run in row order and wrap around, so adding a phase is adding a row.
+const int lightStates[][3] = {
+  {2, 0, greenTime},  // STATE_1_GREEN:  Light1=Green, Light2=Red
+  {1, 0, yellowTime}, // STATE_1_YELLOW: Light1=Yellow, Light2=Red
+  {0, 0, allRedTime}, // STATE_1_RED:    Light1=Red, Light2=Red
+  {0, 2, greenTime},  // STATE_2_GREEN:  Light1=Red, Light2=Green
+  {0, 1, yellowTime}, // STATE_2_YELLOW: Light1=Red, Light2=Yellow
+  {0, 0, allRedTime}  // STATE_2_RED:    Light1=Red, Light2=Red
 };
+const int STATE_COUNT = sizeof(lightStates) / sizeof(lightStates[0]);
+
+// Columns of lightStates
+const int PHASE_LIGHT1 = 0;
+const int PHASE_LIGHT2 = 1;
+const int PHASE_DURATION = 2;
+
+// Approaches for AdaptiveSignal
+const uint8_t ROAD_1 = 0;
+const uint8_t ROAD_2 = 1;
 
 // Billboard messages
 const char* messages[] = {
@@ -51,44 +98,222 @@ const char* messages[] = {
 };
 const int messageCount = 4;
 const int messageChangeInterval = 5000; // 5 seconds per message
+const int speedMessageTime = 5000;      // how long a measured speed stays up
+
+// After the messages the billboard shows these, once a car has been measured
+const int VIEW_85TH_PERCENTILE = messageCount;
+const int VIEW_CARS_PER_MINUTE = messageCount + 1;
+const int billboardViewCount = messageCount + 2;
 
 // Create LCD instance
 LiquidCrystal lcd(lcdPins[0], lcdPins[1], lcdPins[2], lcdPins[3], lcdPins[4], lcdPins[5]);
 
+// Everything is drawn here and only the changed cells are sent to the LCD.
+// The sending happens on a task on core 0 so no other task waits for the LCD.
+LcdFrame frame(lcd);
+AsyncLcd screen(frame);
+
 // Speed calculation parameters
-const float sensorDistance = 1.0; // Distance between photoresistors in meters
-volatile unsigned long firstSensorTime = 0;
-volatile unsigned long secondSensorTime = 0;
-volatile bool speedMeasurementActive = false;
-volatile bool displaySpeed = false;
-float vehicleSpeed = 0.0;
-
-// State tracking variables
+const uint32_t sensorDistanceMm = 1000; // Distance between photoresistors
+const uint32_t sensorToleranceMm = 5;   // How accurately they are placed
+#if SPEED_CAPTURE_HW
+const uint32_t captureTicksPerSecond = 80000000; // APB clock
+const uint32_t captureErrorTicks = 2;            // one tick of quantization per edge
+const int captureClockChannel = 2;               // spare, latched from software
+#else
+const uint32_t captureTicksPerSecond = 1000000;  // esp_timer microseconds
+const uint32_t captureErrorTicks = 10;           // quantization plus ISR entry jitter
+#endif
+uint64_t firstSensorTime = 0;
+uint64_t secondSensorTime = 0;
+bool speedMeasurementActive = false;
+bool displaySpeed = false;
+uint32_t vehicleSpeed = 0;      // in 0.01 km/h
+
+// One measured car
+struct SpeedReading {
+  uint32_t centiKmh;            // speed in 0.01 km/h
+  uint32_t uncertaintyCentiKmh; // +/- bound on centiKmh
+};
+
+// A falling edge on one of the speed sensors, timestamped in the ISR
+struct SensorEdge {
+  uint8_t sensor; // 0 = first sensor, 1 = second sensor
+  uint64_t time;  // capture clock ticks at the edge
+};
+
+// The ISRs only push edges here; the sensor task pairs them and does the math
+const int sensorEdgeBatch = 16;
+SpscRing<SensorEdge, 64> sensorEdges;
+uint32_t reportedEdgeDrops = 0;
+
+// Task layout. Core 1 only runs signal timing, so nothing on core 0 (LCD
+// bit-banging, serial output) can delay a light change or a speed timestamp.
+//
+//   core 1  sensors  prio 6  pairs speed sensor edges, woken by the ISRs
+//   core 1  lights   prio 5  runs the phase table, sleeps until the next phase
+//   core 0  display  prio 3  billboard rotation and the speed message
+//   core 0  log      prio 2  serial output and the periodic task report
+//   core 0  lcd      prio 1  AsyncLcd drawing task
+//
+// Tasks only talk through queues and task notifications.
+const BaseType_t SIGNAL_CORE = 1;
+const BaseType_t SERVICE_CORE = 0;
+const UBaseType_t SENSOR_TASK_PRIORITY = 6;
+const UBaseType_t LIGHTS_TASK_PRIORITY = 5;
+const UBaseType_t DISPLAY_TASK_PRIORITY = 3;
+const UBaseType_t LOG_TASK_PRIORITY = 2;
+const UBaseType_t LCD_TASK_PRIORITY = 1;
+const uint32_t TASK_STACK_SIZE = 3072;
+const unsigned long taskReportInterval = 10000; // ms between task reports
+const unsigned long serialPollInterval = 250;   // ms between checks for commands
+
+// Notification bits for the lights task, one per pedestrian button
+const uint32_t NOTIFY_PEDESTRIAN_1 = 1 << 0;
+const uint32_t NOTIFY_PEDESTRIAN_2 = 1 << 1;
+
+// Events for the log task, so core 1 never waits on the UART
+enum LogType : uint8_t {
+  LOG_STATE,         // value = new light state
+  LOG_FIRST_SENSOR,  // first speed sensor tripped
+  LOG_SPEED,         // value = 0.01 km/h, extra = uncertainty
+  LOG_EDGES_DROPPED, // value = total sensor edges dropped
+  LOG_PEDESTRIAN,    // value = pedestrian button index
+  LOG_GREEN          // value = road index, extra = green time in ms
+};
+
+struct LogEvent {
+  LogType type;
+  uint32_t timeMs;
+  uint32_t value;
+  uint32_t extra;
+};
+
+// Serial output is binary telemetry frames (lib/Telemetry). Decode it on the
+// PC with lib/Telemetry/tools/telemetry2csv. Answers to serial commands stay
+// plain text and come out of the decoder as-is.
+enum Channel : uint8_t {
+  CH_STATE = 1,             // new light state
+  CH_FIRST_SENSOR,          // 1 when the first speed sensor trips
+  CH_SPEED,                 // 0.01 km/h
+  CH_SPEED_UNCERTAINTY,     // +/- 0.01 km/h
+  CH_EDGES_DROPPED,         // total sensor edges dropped
+  CH_PEDESTRIAN,            // pedestrian button, 1 or 2
+  CH_GREEN_ROAD,            // road given green, 1 or 2
+  CH_GREEN_TIME,            // its green time in ms
+  CH_NIGHT_SENSOR,          // raw ADC reading
+  CH_STATS_COUNT,           // speed statistics ('s'), speeds in 0.01 km/h
+  CH_STATS_MEAN,
+  CH_STATS_STDDEV,
+  CH_STATS_MIN,
+  CH_STATS_MAX,
+  CH_STATS_P50,
+  CH_STATS_P85,
+  CH_STATS_CARS_PER_MINUTE,
+  CH_TASK_LOAD = 32,        // + task index, CPU load in 0.01 %
+  CH_TASK_STACK = 48        // + task index, stack never used
+};
+
+// Busy time per task, for the CPU load report
+enum TaskId { TASK_SENSORS, TASK_LIGHTS, TASK_DISPLAY, TASK_LOG, TASK_COUNT };
+
+struct TaskInfo {
+  const char *name;
+  TaskHandle_t handle;
+  uint64_t busyUs; // written only by the task itself
+};
+
+TaskInfo tasks[TASK_COUNT] = {
+  {"sensors", NULL, 0},
+  {"lights", NULL, 0},
+  {"display", NULL, 0},
+  {"log", NULL, 0}
+};
+
+// Timing of the core 1 tasks. Send 'p' over serial to print them.
+//   lights   period between wake-ups, wake delay = phase deadline to task
+//   sensors  period between wake-ups, wake delay = last edge interrupt to task,
+//            isr entry = edge to capture interrupt (SPEED_CAPTURE_HW only)
+LoopProfiler lightsProfile("lights");
+LoopProfiler sensorProfile("sensors");
+uint8_t phaseScope = lightsProfile.addScope("phase change");
+uint8_t pairingScope = sensorProfile.addScope("edge pairing");
+volatile uint32_t lastEdgeCycles = 0; // LoopProfiler::now() in the last edge ISR
+
+QueueHandle_t speedQueue = NULL; // SpeedReading, sensors -> display
+QueueHandle_t logQueue = NULL;   // LogEvent, any task -> log
+QueueHandle_t statsQueue = NULL; // latest SpeedStats::Summary, display -> log
+
+// Only the log task writes to it
+Telemetry telemetry(Serial);
+
+// State tracking variables (lights task)
 int currentState = STATE_1_GREEN;
+unsigned long nextStateTime = 0;       // when the current phase ends
+uint8_t lightOutputs = 0;              // bits 0-2 = light1 [R,Y,G], bits 3-5 = light2
+bool pedestrianWaiting[2] = {false, false};
+AdaptiveSignal adaptive({minGreenTime, maxGreenTime, dischargeHeadway, startupLostTime});
+
+// Cars measured by the sensor task since the lights task last looked
+uint32_t vehicleArrivals = 0;
+
+// State tracking variables (display task)
+SpeedStats speedStats;
 int currentMessage = 0;
-unsigned long stateChangeTime = 0;
-unsigned long messageChangeTime = 0;
+Scheduler displayScheduler;
+uint8_t billboardTask = Scheduler::NO_TASK;   // rotates the billboard
+uint8_t speedMessageTask = Scheduler::NO_TASK; // takes the speed message down
 
 // Function prototypes
 void updateTrafficLights(int newState);
 void setAllLightsRed();
-void calculateSpeed();
+void writeLightOutputs(uint8_t outputs);
+uint8_t stateOutputs(int state);
+SpeedReading calculateSpeed();
 void displayBillboardMessage();
 void displaySpeedMessage();
-void handleTrafficLights();
-void updateDisplay();
+unsigned long handleTrafficLights(unsigned long currentTime);
+void showSpeed(unsigned long currentTime);
+void rotateBillboard();
+void endSpeedMessage();
+void handlePedestrians(uint32_t notifyBits, unsigned long currentTime);
+int greenRoad(int state);
+unsigned long phaseDuration(int state, unsigned long startTime);
+void processSensorEdges();
+void beginSpeedCapture();
+void sensorOneTriggered();
+void sensorTwoTriggered();
+void pedestrianOnePressed();
+void pedestrianTwoPressed();
+void logEvent(LogType type, uint32_t value, uint32_t extra = 0);
+void sendLogEvent(const LogEvent &event);
+void sendSpeedStats();
+void sendTaskReport(unsigned long elapsedMs);
+void handleSerialCommands();
+TickType_t ticksUntil(unsigned long wakeTime);
+void sensorTask(void *arg);
+void lightsTask(void *arg);
+void displayTask(void *arg);
+void logTask(void *arg);
 
 void setup() {
-  // Initialize serial for debugging
+  // Initialize serial for telemetry. The UART driver buffers this much, so
+  // Telemetry::pump() hands over a whole burst without waiting.
+  Serial.setTxBufferSize(1024);
   Serial.begin(115200);
 
   // Initialize LCD
   lcd.begin(16, 2);
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Traffic System");
-  lcd.setCursor(0, 1);
-  lcd.print("Initializing...");
+  screen.begin(LCD_TASK_PRIORITY, SERVICE_CORE);
+  screen.printLine(0, "Traffic System");
+  screen.printLine(1, "Initializing...");
+  screen.render();
+
+  speedQueue = xQueueCreate(8, sizeof(SpeedReading));
+  logQueue = xQueueCreate(32, sizeof(LogEvent));
+  statsQueue = xQueueCreate(1, sizeof(SpeedStats::Summary));
+  SpeedStats::Summary noCars = speedStats.summary(millis());
+  xQueueOverwrite(statsQueue, &noCars);
 
   // Initialize traffic light pins
   for (int i = 0; i < 3; i++) {
@@ -96,79 +321,332 @@ void setup() {
     pinMode(trafficLight2[i], OUTPUT);
   }
 
-  // Initialize speed sensor pins with pull-up resistors
-  pinMode(speedSensors[0], INPUT_PULLUP);
-  pinMode(speedSensors[1], INPUT_PULLUP);
+  // Pedestrian buttons and the night light sensor
+  pinMode(pedestrians[0], INPUT_PULLUP);
+  pinMode(pedestrians[1], INPUT_PULLUP);
+  pinMode(nightSensor, INPUT);
 
-  // Attach interrupts for speed sensors
-  attachInterrupt(digitalPinToInterrupt(speedSensors[0]), sensorOneTriggered, FALLING);
-  attachInterrupt(digitalPinToInterrupt(speedSensors[1]), sensorTwoTriggered, FALLING);
+  LoopProfiler::begin();
 
   // Start with all traffic lights red
   setAllLightsRed();
   delay(2000);
 
+  xTaskCreatePinnedToCore(logTask, "log", TASK_STACK_SIZE, NULL,
+                          LOG_TASK_PRIORITY, &tasks[TASK_LOG].handle, SERVICE_CORE);
+  xTaskCreatePinnedToCore(displayTask, "display", TASK_STACK_SIZE, NULL,
+                          DISPLAY_TASK_PRIORITY, &tasks[TASK_DISPLAY].handle, SERVICE_CORE);
+  xTaskCreatePinnedToCore(lightsTask, "lights", TASK_STACK_SIZE, NULL,
+                          LIGHTS_TASK_PRIORITY, &tasks[TASK_LIGHTS].handle, SIGNAL_CORE);
+  xTaskCreatePinnedToCore(sensorTask, "sensors", TASK_STACK_SIZE, NULL,
+                          SENSOR_TASK_PRIORITY, &tasks[TASK_SENSORS].handle, SIGNAL_CORE);
+
+  // Interrupts notify the tasks, so attach them once the tasks exist
+  beginSpeedCapture();
+  attachInterrupt(digitalPinToInterrupt(pedestrians[0]), pedestrianOnePressed, FALLING);
+  attachInterrupt(digitalPinToInterrupt(pedestrians[1]), pedestrianTwoPressed, FALLING);
+}
+
+void loop() {
+  // Everything runs in the tasks started by setup()
+  vTaskDelete(NULL);
+}
+
+// Ticks to block for so a task wakes at wakeTime (0 if it already passed)
+TickType_t ticksUntil(unsigned long wakeTime) {
+  long remaining = (long)(wakeTime - millis());
+  if (remaining <= 0) {
+    return 0;
+  }
+  return pdMS_TO_TICKS(remaining);
+}
+
+void sensorTask(void *arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    sensorProfile.recordWakeDelay(lastEdgeCycles);
+    sensorProfile.tick();
+
+    int64_t start = esp_timer_get_time();
+    {
+      ProfileScope scope(sensorProfile, pairingScope);
+      processSensorEdges();
+    }
+    tasks[TASK_SENSORS].busyUs += esp_timer_get_time() - start;
+  }
+}
+
+void lightsTask(void *arg) {
   // Set initial state
+  unsigned long startTime = millis();
   updateTrafficLights(STATE_1_GREEN);
-  stateChangeTime = millis();
-  messageChangeTime = millis();
+  nextStateTime = startTime + phaseDuration(STATE_1_GREEN, startTime);
+
+  for (;;) {
+    // Sleep until the phase ends or a pedestrian presses a button
+    uint32_t notifyBits = 0;
+    xTaskNotifyWait(0, UINT32_MAX, &notifyBits, ticksUntil(nextStateTime));
+    lightsProfile.tick();
+
+    int64_t start = esp_timer_get_time();
+    if ((long)(millis() - nextStateTime) >= 0) {
+      // Both sides wrap at 2^32 us, so the difference stays right
+      uint32_t lateUs = (uint32_t)start - nextStateTime * 1000UL;
+      // Over ~17.9 s late the cycle count would wrap, so saturate instead
+      const uint32_t maxLateUs = UINT32_MAX / LoopProfiler::cyclesPerMicrosecond();
+      if (lateUs > maxLateUs) {
+        lateUs = maxLateUs;
+      }
+      lightsProfile.addWakeDelay(lateUs * LoopProfiler::cyclesPerMicrosecond());
+    }
+    handlePedestrians(notifyBits, millis());
+    {
+      ProfileScope scope(lightsProfile, phaseScope);
+      handleTrafficLights(millis());
+    }
+    tasks[TASK_LIGHTS].busyUs += esp_timer_get_time() - start;
+  }
+}
 
-  lcd.clear();
+void displayTask(void *arg) {
+  unsigned long now = millis();
   displayBillboardMessage();
+  billboardTask = displayScheduler.every(messageChangeInterval, rotateBillboard, now);
+  speedMessageTask = displayScheduler.add(endSpeedMessage);
+
+  for (;;) {
+    // Sleep until the next billboard change or a new speed reading
+    SpeedReading reading;
+    TickType_t wait = ticksUntil(displayScheduler.nextDeadline());
+    bool gotReading = xQueueReceive(speedQueue, &reading, wait) == pdTRUE;
+
+    int64_t start = esp_timer_get_time();
+    unsigned long currentTime = millis();
+    if (gotReading) {
+      vehicleSpeed = reading.centiKmh;
+      speedStats.add(reading.centiKmh, currentTime);
+      showSpeed(currentTime);
+    }
+    displayScheduler.run(currentTime);
+
+    // The log task prints the latest summary when asked
+    SpeedStats::Summary summary = speedStats.summary(currentTime);
+    xQueueOverwrite(statsQueue, &summary);
+    tasks[TASK_DISPLAY].busyUs += esp_timer_get_time() - start;
+  }
 }
 
-void loop() {
-  // Handle traffic light state changes
-  handleTrafficLights();
+void logTask(void *arg) {
+  unsigned long lastReport = millis();
+
+  for (;;) {
+    LogEvent event;
+    TickType_t wait = ticksUntil(lastReport + taskReportInterval);
+    if (wait > pdMS_TO_TICKS(serialPollInterval)) {
+      wait = pdMS_TO_TICKS(serialPollInterval);
+    }
+    bool gotEvent = xQueueReceive(logQueue, &event, wait) == pdTRUE;
 
-  // Display billboard message or speed
-  updateDisplay();
+    int64_t start = esp_timer_get_time();
+    if (gotEvent) {
+      sendLogEvent(event);
+    }
+    handleSerialCommands();
+    unsigned long currentTime = millis();
+    if (currentTime - lastReport >= taskReportInterval) {
+      sendTaskReport(currentTime - lastReport);
+      lastReport = currentTime;
+    }
+    telemetry.pump();
+    tasks[TASK_LOG].busyUs += esp_timer_get_time() - start;
+  }
 }
 
-void handleTrafficLights() {
-  unsigned long currentTime = millis();
+// 'p' prints the timing profiles of the core 1 tasks, 's' the speed
+// statistics, 'a' toggles adaptive timing
+void handleSerialCommands() {
+  while (Serial.available() > 0) {
+    char command = Serial.read();
+    if (command == 'p') {
+      lightsProfile.dump(telemetry);
+      sensorProfile.dump(telemetry);
+    }
+    else if (command == 's') {
+      sendSpeedStats();
+    }
+    else if (command == 'a') {
+      adaptiveTiming = !adaptiveTiming;
+      telemetry.print("Adaptive timing ");
+      telemetry.println(adaptiveTiming ? "on" : "off");
+    }
+  }
+}
+
+// Queue a log line without ever blocking the caller
+void logEvent(LogType type, uint32_t value, uint32_t extra) {
+  LogEvent event = {type, (uint32_t)millis(), value, extra};
+  xQueueSend(logQueue, &event, 0);
+}
 
-  // Check if it's time to change traffic light state
-  if (currentState == STATE_1_GREEN && currentTime - stateChangeTime >= greenTime) {
-    updateTrafficLights(STATE_1_YELLOW);
-    stateChangeTime = currentTime;
+// One telemetry frame per event, stamped with when it happened
+void sendLogEvent(const LogEvent &event) {
+  telemetry.beginFrame(event.timeMs);
+  switch (event.type) {
+  case LOG_STATE:
+    telemetry.add(CH_STATE, event.value);
+    break;
+  case LOG_FIRST_SENSOR:
+    telemetry.add(CH_FIRST_SENSOR, 1);
+    break;
+  case LOG_SPEED:
+    telemetry.add(CH_SPEED, event.value);
+    telemetry.add(CH_SPEED_UNCERTAINTY, event.extra);
+    break;
+  case LOG_EDGES_DROPPED:
+    telemetry.add(CH_EDGES_DROPPED, event.value);
+    break;
+  case LOG_PEDESTRIAN:
+    telemetry.add(CH_PEDESTRIAN, event.value + 1);
+    break;
+  case LOG_GREEN:
+    telemetry.add(CH_GREEN_ROAD, event.value + 1);
+    telemetry.add(CH_GREEN_TIME, event.extra);
+    break;
   }
-  else if (currentState == STATE_1_YELLOW && currentTime - stateChangeTime >= yellowTime) {
-    updateTrafficLights(STATE_1_RED);
-    stateChangeTime = currentTime;
+  telemetry.endFrame();
+}
+
+// The display task's latest speed statistics, as one frame
+void sendSpeedStats() {
+  SpeedStats::Summary summary;
+  if (xQueuePeek(statsQueue, &summary, 0) != pdTRUE) {
+    return;
   }
-  else if (currentState == STATE_1_RED && currentTime - stateChangeTime >= allRedTime) {
-    updateTrafficLights(STATE_2_GREEN);
-    stateChangeTime = currentTime;
+  telemetry.beginFrame(millis());
+  telemetry.add(CH_STATS_COUNT, summary.count);
+  telemetry.add(CH_STATS_MEAN, summary.meanCentiKmh);
+  telemetry.add(CH_STATS_STDDEV, summary.stddevCentiKmh);
+  telemetry.add(CH_STATS_MIN, summary.minCentiKmh);
+  telemetry.add(CH_STATS_MAX, summary.maxCentiKmh);
+  telemetry.add(CH_STATS_P50, summary.p50CentiKmh);
+  telemetry.add(CH_STATS_P85, summary.p85CentiKmh);
+  telemetry.add(CH_STATS_CARS_PER_MINUTE, summary.carsLastMinute);
+  telemetry.endFrame();
+}
+
+// CPU load and stack headroom of every task since the last report
+void sendTaskReport(unsigned long elapsedMs) {
+  static uint64_t lastBusyUs[TASK_COUNT];
+
+  telemetry.beginFrame(millis());
+  for (int i = 0; i < TASK_COUNT; i++) {
+    // Written from another core; a torn read only skews one report
+    uint64_t busyUs = tasks[i].busyUs;
+    uint32_t load = (busyUs - lastBusyUs[i]) * 10 / elapsedMs; // 0.01 %
+    lastBusyUs[i] = busyUs;
+
+    telemetry.add(CH_TASK_LOAD + i, load);
+    telemetry.add(CH_TASK_STACK + i, uxTaskGetStackHighWaterMark(tasks[i].handle));
   }
-  else if (currentState == STATE_2_GREEN && currentTime - stateChangeTime >= greenTime) {
-    updateTrafficLights(STATE_2_YELLOW);
-    stateChangeTime = currentTime;
+  telemetry.add(CH_NIGHT_SENSOR, analogRead(nightSensor));
+  telemetry.endFrame();
+}
+
+// Advances through the phase table and returns when the current phase ends
+unsigned long handleTrafficLights(unsigned long currentTime) {
+  // Deadlines are chained off the previous deadline rather than the time we
+  // noticed it, so a late wake-up never stretches the cycle
+  uint32_t cars = __atomic_exchange_n(&vehicleArrivals, 0, __ATOMIC_RELAXED);
+  adaptive.addArrivals(ROAD_1, cars, currentTime);
+
+  while ((long)(currentTime - nextStateTime) >= 0) {
+    int road = greenRoad(currentState);
+    if (road >= 0) {
+      adaptive.greenEnded(road, nextStateTime);
+    }
+    int newState = (currentState + 1) % STATE_COUNT;
+    updateTrafficLights(newState);
+    nextStateTime += phaseDuration(newState, nextStateTime);
   }
-  else if (currentState == STATE_2_YELLOW && currentTime - stateChangeTime >= yellowTime) {
-    updateTrafficLights(STATE_2_RED);
-    stateChangeTime = currentTime;
+
+  return nextStateTime;
+}
+
+// The road a state gives green to, or -1
+int greenRoad(int state) {
+  if (lightStates[state][PHASE_LIGHT1] == 2) {
+    return ROAD_1;
   }
-  else if (currentState == STATE_2_RED && currentTime - stateChangeTime >= allRedTime) {
-    updateTrafficLights(STATE_1_GREEN);
-    stateChangeTime = currentTime;
+  if (lightStates[state][PHASE_LIGHT2] == 2) {
+    return ROAD_2;
   }
+  return -1;
 }
 
-void updateTrafficLights(int newState) {
-  // Set all lights to off initially
+// How long a state lasts when it starts at startTime
+unsigned long phaseDuration(int state, unsigned long startTime) {
+  int road = greenRoad(state);
+  if (road < 0) {
+    return lightStates[state][PHASE_DURATION];
+  }
+
+  adaptive.greenStarted(road, startTime);
+  unsigned long duration = lightStates[state][PHASE_DURATION];
+  if (adaptiveTiming) {
+    duration = adaptive.greenTime(road, startTime);
+  }
+  logEvent(LOG_GREEN, road, duration);
+  return duration;
+}
+
+// Latches pedestrian requests; a request is served once its road turns red.
+// Crossing road 1 needs road 2's green, so it also counts as demand there.
+void handlePedestrians(uint32_t notifyBits, unsigned long currentTime) {
+  const uint32_t pedestrianBits[2] = {NOTIFY_PEDESTRIAN_1, NOTIFY_PEDESTRIAN_2};
+  const uint8_t servedBy[2] = {ROAD_2, ROAD_1};
+
+  for (int i = 0; i < 2; i++) {
+    if ((notifyBits & pedestrianBits[i]) && !pedestrianWaiting[i]) {
+      pedestrianWaiting[i] = true;
+      adaptive.addArrivals(servedBy[i], 1, currentTime);
+      logEvent(LOG_PEDESTRIAN, i);
+    }
+  }
+}
+
+// Output bits for a state: light1 [R,Y,G] in bits 0-2, light2 in bits 3-5
+uint8_t stateOutputs(int state) {
+  return (1 << lightStates[state][PHASE_LIGHT1]) |
+         (1 << (3 + lightStates[state][PHASE_LIGHT2]));
+}
+
+// Only touch the pins whose level actually changes
+void writeLightOutputs(uint8_t outputs) {
+  uint8_t changed = outputs ^ lightOutputs;
+
   for (int i = 0; i < 3; i++) {
-    digitalWrite(trafficLight1[i], LOW);
-    digitalWrite(trafficLight2[i], LOW);
+    if (changed & (1 << i)) {
+      digitalWrite(trafficLight1[i], (outputs & (1 << i)) ? HIGH : LOW);
+    }
+    if (changed & (1 << (3 + i))) {
+      digitalWrite(trafficLight2[i], (outputs & (1 << (3 + i))) ? HIGH : LOW);
+    }
   }
 
-  // Set appropriate lights based on the state array
-  digitalWrite(trafficLight1[lightStates[newState][0]], HIGH);
-  digitalWrite(trafficLight2[lightStates[newState][1]], HIGH);
+  lightOutputs = outputs;
+}
+
+void updateTrafficLights(int newState) {
+  writeLightOutputs(stateOutputs(newState));
 
   currentState = newState;
-  Serial.print("Traffic light state changed to: ");
-  Serial.println(newState);
+  if (lightStates[newState][PHASE_LIGHT1] == 0) {
+    pedestrianWaiting[0] = false;
+  }
+  if (lightStates[newState][PHASE_LIGHT2] == 0) {
+    pedestrianWaiting[1] = false;
+  }
+  logEvent(LOG_STATE, newState);
 }
 
 void setAllLightsRed() {
@@ -177,87 +655,207 @@ void setAllLightsRed() {
     digitalWrite(trafficLight1[i], LOW);
     digitalWrite(trafficLight2[i], LOW);
   }
-  
+
   // Turn on only red lights
   digitalWrite(trafficLight1[0], HIGH);  // Red light 1
   digitalWrite(trafficLight2[0], HIGH);  // Red light 2
+  lightOutputs = (1 << 0) | (1 << 3);
 }
 
-void sensorOneTriggered() {
-  firstSensorTime = millis();
-  speedMeasurementActive = true;
-  Serial.println("First sensor triggered");
+// Wake the sensor task from an interrupt so it handles new edges right away.
+// Returns true if the interrupt should yield to it.
+bool IRAM_ATTR notifySensorTaskFromISR() {
+  lastEdgeCycles = LoopProfiler::now();
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  vTaskNotifyGiveFromISR(tasks[TASK_SENSORS].handle, &higherPriorityTaskWoken);
+  return higherPriorityTaskWoken == pdTRUE;
 }
 
-void sensorTwoTriggered() {
-  if (speedMeasurementActive) {
-    secondSensorTime = millis();
-    calculateSpeed();
-    speedMeasurementActive = false;
-    displaySpeed = true;
-    Serial.print("Speed: ");
-    Serial.print(vehicleSpeed);
-    Serial.println(" km/h");
+void IRAM_ATTR notifyPedestrianFromISR(uint32_t bit) {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  xTaskNotifyFromISR(tasks[TASK_LIGHTS].handle, bit, eSetBits, &higherPriorityTaskWoken);
+  if (higherPriorityTaskWoken) {
+    portYIELD_FROM_ISR();
   }
 }
 
-void calculateSpeed() {
-  unsigned long timeDifference = secondSensorTime - firstSensorTime;
+void IRAM_ATTR pedestrianOnePressed() {
+  notifyPedestrianFromISR(NOTIFY_PEDESTRIAN_1);
+}
+
+void IRAM_ATTR pedestrianTwoPressed() {
+  notifyPedestrianFromISR(NOTIFY_PEDESTRIAN_2);
+}
 
-  // Avoid division by zero
-  if (timeDifference == 0) {
-    vehicleSpeed = 0;
-    return;
+#if SPEED_CAPTURE_HW
+// Runs in the MCPWM interrupt. The capture value was latched at the edge, so
+// interrupt latency does not matter. The 32-bit counter is widened to 64 bits
+// here; after a long quiet spell the high word can be off, but both edges of a
+// car get the same offset so the difference between them is still exact.
+bool IRAM_ATTR onSensorCapture(mcpwm_unit_t unit, mcpwm_capture_channel_id_t channel,
+                               const cap_event_data_t *edata, void *arg) {
+  static uint32_t lastCapture = 0;
+  static uint64_t captureHigh = 0;
+
+  // Latch the capture timer now: the difference is the interrupt latency
+  mcpwm_ll_capture_trigger_sw(&MCPWM0, captureClockChannel);
+  uint32_t entryTicks = mcpwm_ll_capture_get_value(&MCPWM0, captureClockChannel) - edata->cap_value;
+  sensorProfile.addIsrEntry(entryTicks * LoopProfiler::cyclesPerMicrosecond() /
+                            (captureTicksPerSecond / 1000000));
+
+  if (edata->cap_value < lastCapture) {
+    captureHigh += 1ULL << 32;
   }
+  lastCapture = edata->cap_value;
 
-  // Calculate speed in meters per second
-  float speedMS = (sensorDistance * 1000.0) / timeDifference;
+  uint8_t sensor = (channel == MCPWM_SELECT_CAP0) ? 0 : 1;
+  sensorEdges.push({sensor, captureHigh | edata->cap_value});
+  return notifySensorTaskFromISR();
+}
 
-  // Convert to km/h
-  vehicleSpeed = speedMS * 3.6;
+void beginSpeedCapture() {
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_CAP_0, speedSensors[0]);
+  mcpwm_gpio_init(MCPWM_UNIT_0, MCPWM_CAP_1, speedSensors[1]);
+  gpio_pullup_en((gpio_num_t)speedSensors[0]);
+  gpio_pullup_en((gpio_num_t)speedSensors[1]);
+
+  mcpwm_capture_config_t config = {};
+  config.cap_edge = MCPWM_NEG_EDGE;
+  config.cap_prescale = 1;
+  config.capture_cb = onSensorCapture;
+  config.user_data = NULL;
+  mcpwm_capture_enable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP0, &config);
+  mcpwm_capture_enable_channel(MCPWM_UNIT_0, MCPWM_SELECT_CAP1, &config);
+  // No input and no interrupt: the ISR triggers it to read the timer
+  mcpwm_ll_capture_enable_channel(&MCPWM0, captureClockChannel, true);
+}
+#else
+void IRAM_ATTR sensorOneTriggered() {
+  sensorEdges.push({0, (uint64_t)esp_timer_get_time()});
+  if (notifySensorTaskFromISR()) {
+    portYIELD_FROM_ISR();
+  }
 }
 
-void displayBillboardMessage() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Welcome to City");
-  lcd.setCursor(0, 1);
-  lcd.print(messages[currentMessage]);
+void IRAM_ATTR sensorTwoTriggered() {
+  sensorEdges.push({1, (uint64_t)esp_timer_get_time()});
+  if (notifySensorTaskFromISR()) {
+    portYIELD_FROM_ISR();
+  }
 }
 
-void displaySpeedMessage() {
-  lcd.clear();
-  lcd.setCursor(0, 0);
-  lcd.print("Vehicle Speed:");
-  lcd.setCursor(0, 1);
-  lcd.print(vehicleSpeed, 1);
-  lcd.print(" km/h");
+void beginSpeedCapture() {
+  // Initialize speed sensor pins with pull-up resistors
+  pinMode(speedSensors[0], INPUT_PULLUP);
+  pinMode(speedSensors[1], INPUT_PULLUP);
+
+  // Attach interrupts for speed sensors
+  attachInterrupt(digitalPinToInterrupt(speedSensors[0]), sensorOneTriggered, FALLING);
+  attachInterrupt(digitalPinToInterrupt(speedSensors[1]), sensorTwoTriggered, FALLING);
+}
+#endif
+
+// Drains the edge queue in batches, pairing first/second sensor edges
+void processSensorEdges() {
+  SensorEdge batch[sensorEdgeBatch];
+  size_t count;
+
+  while ((count = sensorEdges.popBatch(batch, sensorEdgeBatch)) > 0) {
+    for (size_t i = 0; i < count; i++) {
+      if (batch[i].sensor == 0) {
+        firstSensorTime = batch[i].time;
+        speedMeasurementActive = true;
+        logEvent(LOG_FIRST_SENSOR, 0);
+      }
+      else if (speedMeasurementActive) {
+        secondSensorTime = batch[i].time;
+        SpeedReading reading = calculateSpeed();
+        speedMeasurementActive = false;
+        xQueueSend(speedQueue, &reading, 0);
+        __atomic_fetch_add(&vehicleArrivals, 1, __ATOMIC_RELAXED);
+        logEvent(LOG_SPEED, reading.centiKmh, reading.uncertaintyCentiKmh);
+      }
+    }
+  }
+
+  if (sensorEdges.dropped() != reportedEdgeDrops) {
+    reportedEdgeDrops = sensorEdges.dropped();
+    logEvent(LOG_EDGES_DROPPED, reportedEdgeDrops);
+  }
 }
 
-void updateDisplay() {
-  unsigned long currentTime = millis();
+// Integer speed from the two edge timestamps, in hundredths of a km/h
+SpeedReading calculateSpeed() {
+  SpeedReading reading = {0, 0};
+  uint64_t ticks = secondSensorTime - firstSensorTime;
 
-  // If we need to display speed, show it for 5 seconds
-  if (displaySpeed) {
-    static unsigned long speedDisplayStartTime = 0;
+  // Avoid division by zero
+  if (ticks == 0) {
+    return reading;
+  }
 
-    if (speedDisplayStartTime == 0) {
-      displaySpeedMessage();
-      speedDisplayStartTime = currentTime;
-    }
+  // km/h = (mm / 1000) / (ticks / ticksPerSecond) * 3.6, times 100
+  uint64_t numerator = (uint64_t)sensorDistanceMm * captureTicksPerSecond * 36;
+  uint64_t denominator = ticks * 100;
+  reading.centiKmh = (uint32_t)((numerator + denominator / 2) / denominator);
 
-    // After 5 seconds, go back to regular messages
-    if (currentTime - speedDisplayStartTime >= 5000) {
-      displaySpeed = false;
-      speedDisplayStartTime = 0;
-    }
+  // Relative errors add: placement of the sensors plus timestamp error
+  reading.uncertaintyCentiKmh =
+      (uint32_t)((uint64_t)reading.centiKmh * sensorToleranceMm / sensorDistanceMm +
+                 ((uint64_t)reading.centiKmh * captureErrorTicks + ticks - 1) / ticks);
+
+  return reading;
+}
+
+void displayBillboardMessage() {
+  char line[LcdFrame::COLS + 1];
+
+  if (currentMessage == VIEW_85TH_PERCENTILE) {
+    uint16_t p85 = speedStats.percentile(85);
+    snprintf(line, sizeof(line), "%u.%u km/h", p85 / 100, (p85 % 100) / 10);
+    screen.printLine(0, "85th percentile");
+    screen.printLine(1, line);
+  }
+  else if (currentMessage == VIEW_CARS_PER_MINUTE) {
+    snprintf(line, sizeof(line), "%u", speedStats.carsPerMinute(millis()));
+    screen.printLine(0, "Cars per minute");
+    screen.printLine(1, line);
   }
-  // Otherwise show cycling billboard messages
   else {
-    if (currentTime - messageChangeTime >= messageChangeInterval) {
-      currentMessage = (currentMessage + 1) % messageCount;
-      displayBillboardMessage();
-      messageChangeTime = currentTime;
-    }
+    screen.printLine(0, "Welcome to City");
+    screen.printLine(1, messages[currentMessage]);
   }
-}
\ No newline at end of file
+  screen.render();
+}
+
+void displaySpeedMessage() {
+  char line[LcdFrame::COLS + 1];
+  snprintf(line, sizeof(line), "%u.%02u km/h",
+           (unsigned)(vehicleSpeed / 100), (unsigned)(vehicleSpeed % 100));
+  screen.printLine(0, "Vehicle Speed:");
+  screen.printLine(1, line);
+  screen.render();
+}
+
+// Shows a new car's speed for speedMessageTime, pausing the billboard. A
+// car that comes while a speed is up replaces it and starts the time again.
+void showSpeed(unsigned long currentTime) {
+  displaySpeed = true;
+  displaySpeedMessage();
+  displayScheduler.cancel(billboardTask);
+  displayScheduler.restart(speedMessageTask, speedMessageTime, currentTime);
+}
+
+// Back to the billboard, which shows its current message for a full interval
+void endSpeedMessage() {
+  displaySpeed = false;
+  displayBillboardMessage();
+  displayScheduler.restart(billboardTask, messageChangeInterval, millis());
+}
+
+void rotateBillboard() {
+  // The statistics views only join the rotation once there is data
+  int views = speedStats.count() > 0 ? billboardViewCount : messageCount;
+  currentMessage = (currentMessage + 1) % views;
+  displayBillboardMessage();
+}
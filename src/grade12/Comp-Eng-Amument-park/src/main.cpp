@@ -1,110 +1,164 @@
 #include <Arduino.h>
 #include <Servo.h>
-
-// Forward declarations (needed in .cpp)
-void setStepper1(int stepIndex);
-void setStepper2(int stepIndex);
-
-// --- Stepper 1 pins (3s delay) ---
-int IN1 = 8;
-int IN2 = 9;
-int IN3 = 10;
-int IN4 = 11;
-
-// --- Stepper 2 pins (4s delay) ---
-int IN5 = 2;
-int IN6 = 3;
-int IN7 = 4;
-int IN8 = 5;
+#include <avr/sleep.h>
+#include <LoopProfiler.h>
+#include <Scheduler.h>
+#include <SmoothServo.h>
+#include <StepperEngine.h>
+
+// --- Stepper 1 pins (PORTB) ---
+const uint8_t IN1 = 8;
+const uint8_t IN2 = 9;
+const uint8_t IN3 = 10;
+const uint8_t IN4 = 11;
+
+// --- Stepper 2 pins (PORTD) ---
+const uint8_t IN5 = 2;
+const uint8_t IN6 = 3;
+const uint8_t IN7 = 4;
+const uint8_t IN8 = 5;
 
 // --- Parameters ---
-const unsigned long stepDelay1 = 3.5; // Stepper 1 speed (ms per step)
-const unsigned long stepDelay2 = 2; // Stepper 2 speed (ms per step)
+// The steppers are stepped by the Timer2 interrupt (lib/StepperEngine). Each
+// ride swings back and forth, speeding up and braking along a precomputed
+// ramp, so it can run faster than a motor that starts and reverses at full
+// speed without losing steps.
+const unsigned long topSpeedPeriod1 = 2500; // Stepper 1 top speed (us per step)
+const unsigned long topSpeedPeriod2 = 1500; // Stepper 2 top speed (us per step)
+const unsigned long acceleration1 = 1000;   // Stepper 1 (steps/s^2)
+const unsigned long acceleration2 = 2000;   // Stepper 2 (steps/s^2)
+const long swingSteps1 = 1428;              // Stepper 1 travel each way (full steps)
+const long swingSteps2 = 2000;              // Stepper 2 travel each way (full steps)
+
+// Coil drive per ride: FULL_STEP, HALF_STEP (smoother, same speed) or
+// MICROSTEP (smoothest; add -D STEPPER_ENGINE_TICK_US=25 to platformio.ini so
+// the coil PWM runs fast enough). Both rides half-step: the swings run
+// quieter and with less shake than the original full-step drive, for about
+// 30% less torque on the one-coil phases. FULL_STEP gives back the original
+// drive.
+const StepperEngine::DriveMode driveMode1 = StepperEngine::HALF_STEP;
+const StepperEngine::DriveMode driveMode2 = StepperEngine::HALF_STEP;
+static_assert((driveMode1 != StepperEngine::MICROSTEP && driveMode2 != StepperEngine::MICROSTEP) ||
+                  StepperEngine::PWM_HZ >= STEPPER_ENGINE_MIN_PWM_HZ,
+              "MICROSTEP needs a shorter STEPPER_ENGINE_TICK_US");
+
+// How often loop() work runs (ms). Each swing takes seconds, so checking for
+// an empty move queue every 20 ms leaves plenty of time to queue the next.
+const unsigned long swingCheckInterval = 20;
+const unsigned long servoUpdateInterval = 20; // one servo pulse frame
+const unsigned long serialPollInterval = 50;
 
 // --- State variables ---
-int stepIndex1 = 0;
-int stepIndex2 = 0;
-int direction1 = 1; // stepper 1 direction
-int direction2 = 1; // stepper 2 direction
-
-unsigned long lastStepTime1 = 0;
-unsigned long lastStepTime2 = 0;
-unsigned long lastDirChange1 = 0;
-unsigned long lastDirChange2 = 0;
-
-// --- Step sequence (full-step drive) ---
-int stepSequence[4][4] = {
-  {1, 0, 1, 0},  // Step 1
-  {0, 1, 1, 0},  // Step 2
-  {0, 1, 0, 1},  // Step 3
-  {1, 0, 0, 1}   // Step 4
-};
+int stepper1 = -1;  // StepperEngine motor ids
+int stepper2 = -1;
+int direction1 = 1; // direction of the next stepper 1 swing
+int direction2 = 1; // direction of the next stepper 2 swing
+
+StepperRamp ramp1;
+StepperRamp ramp2;
 
 // --- Servo ---
+// A continuous rotation servo: 0 = reverse, 90 = stop, 180 = forward.
+// It spins up to speed instead of starting at full speed, and is only
+// written when its speed changes.
+const int servoSpeed = 180;
+const uint16_t servoSpinUpRate = 45; // degrees per second, 2 s to full speed
 Servo myServo;
+SmoothServo<Servo> servoDrive(myServo, 0, servoSpinUpRate);
 int servoPin = 12;
 
+// --- Scheduling ---
+// loop() only runs the tasks that are due and sleeps in between
+Scheduler scheduler;
+uint8_t swingTask = Scheduler::NO_TASK;
+uint8_t servoTask = Scheduler::NO_TASK;
+uint8_t serialTask = Scheduler::NO_TASK;
+
+void queueSwings();
+void updateServo();
+void pollSerial();
+void printTaskStats(const char *name, uint8_t id);
+
+// --- Profiling (send 'p' over serial to print) ---
+LoopProfiler loopProfile("loop");
+uint8_t stepperScope = loopProfile.addScope("steppers");
+uint8_t servoScope = loopProfile.addScope("servo");
+
 void setup() {
-  // Stepper 1
-  pinMode(IN1, OUTPUT);
-  pinMode(IN2, OUTPUT);
-  pinMode(IN3, OUTPUT);
-  pinMode(IN4, OUTPUT);
-
-  // Stepper 2
-  pinMode(IN5, OUTPUT);
-  pinMode(IN6, OUTPUT);
-  pinMode(IN7, OUTPUT);
-  pinMode(IN8, OUTPUT);
+  Serial.begin(115200);
+  LoopProfiler::begin();
+
+  // Steppers, each motor's coils switched by a single port write
+  stepper1 = steppers.addMotor<IN1, IN2, IN3, IN4>();
+  stepper2 = steppers.addMotor<IN5, IN6, IN7, IN8>();
+  ramp1.build(topSpeedPeriod1, acceleration1);
+  ramp2.build(topSpeedPeriod2, acceleration2);
+  steppers.setRamp(stepper1, &ramp1);
+  steppers.setRamp(stepper2, &ramp2);
+  steppers.setDriveMode(stepper1, driveMode1);
+  steppers.setDriveMode(stepper2, driveMode2);
+  steppers.begin();
 
   // Servo
   myServo.attach(servoPin);
+  servoDrive.jumpTo(90);
+  servoDrive.write(servoSpeed);
+
+  unsigned long now = millis();
+  swingTask = scheduler.every(swingCheckInterval, queueSwings, now);
+  servoTask = scheduler.every(servoUpdateInterval, updateServo, now);
+  serialTask = scheduler.every(serialPollInterval, pollSerial, now);
+  queueSwings();
+
+  // Idle sleep stops the CPU but keeps the timers and serial running, so any
+  // interrupt (Timer0's millis() tick, the stepper timer, serial) wakes it
+  set_sleep_mode(SLEEP_MODE_IDLE);
 }
 
 void loop() {
-  unsigned long currentTime = millis();
+  loopProfile.tick();
+  if (scheduler.run(millis()) > 0) {
+    sleep_mode();
+  }
+}
 
-  // --- Stepper 1: Reverse every 3 seconds ---
-  if (currentTime - lastDirChange1 >= 5000) {
+// --- Keep the next swing queued, so each one starts as the last stops ---
+void queueSwings() {
+  ProfileScope scope(loopProfile, stepperScope);
+  if (steppers.queuedMoves(stepper1) == 0) {
+    steppers.move(stepper1, direction1 * swingSteps1 * StepperEngine::stepsPerFullStep(driveMode1));
     direction1 *= -1;
-    lastDirChange1 = currentTime;
   }
-
-  // --- Stepper 2: Reverse every 4 seconds ---
-  if (currentTime - lastDirChange2 >= 4000) {
+  if (steppers.queuedMoves(stepper2) == 0) {
+    steppers.move(stepper2, direction2 * swingSteps2 * StepperEngine::stepsPerFullStep(driveMode2));
     direction2 *= -1;
-    lastDirChange2 = currentTime;
-  }
-
-  // --- Stepper 1 movement (5 ms per step) ---
-  if (currentTime - lastStepTime1 >= stepDelay1) {
-    stepIndex1 = (stepIndex1 + direction1 + 4) % 4;
-    setStepper1(stepIndex1);
-    lastStepTime1 = currentTime;
-  }
-
-  // --- Stepper 2 movement (2 ms per step) ---
-  if (currentTime - lastStepTime2 >= stepDelay2) {
-    stepIndex2 = (stepIndex2 + direction2 + 4) % 4;
-    setStepper2(stepIndex2);
-    lastStepTime2 = currentTime;
   }
+}
 
-  // --- Servo continuous spin ---
-  myServo.write(180); // 0 = reverse, 90 = stop, 180 = forward
+// --- Servo continuous spin ---
+void updateServo() {
+  ProfileScope scope(loopProfile, servoScope);
+  servoDrive.update(millis());
 }
 
-// --- Helper functions ---
-void setStepper1(int stepIndex) {
-  digitalWrite(IN1, stepSequence[stepIndex][0]);
-  digitalWrite(IN2, stepSequence[stepIndex][1]);
-  digitalWrite(IN3, stepSequence[stepIndex][2]);
-  digitalWrite(IN4, stepSequence[stepIndex][3]);
+// --- Profiler dump ---
+void pollSerial() {
+  if (Serial.available() > 0 && Serial.read() == 'p') {
+    loopProfile.dump(Serial);
+    printTaskStats("swings", swingTask);
+    printTaskStats("servo", servoTask);
+    printTaskStats("serial", serialTask);
+  }
 }
 
-void setStepper2(int stepIndex) {
-  digitalWrite(IN5, stepSequence[stepIndex][0]);
-  digitalWrite(IN6, stepSequence[stepIndex][1]);
-  digitalWrite(IN7, stepSequence[stepIndex][2]);
-  digitalWrite(IN8, stepSequence[stepIndex][3]);
+void printTaskStats(const char *name, uint8_t id) {
+  const Scheduler::Stats &stats = scheduler.stats(id);
+  Serial.print("  task ");
+  Serial.print(name);
+  Serial.print(" runs ");
+  Serial.print(stats.runs);
+  Serial.print(" overruns ");
+  Serial.print(stats.overruns);
+  Serial.print(" max late ms ");
+  Serial.println(stats.maxLate);
 }
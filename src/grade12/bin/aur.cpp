@@ -1,11 +1,13 @@
-int pin1 = 13;
-int pin2 = 12;
-int pin3 = 11;
-int pin4 = 10;
-int pin5 = 9;
-int pin6 = 8;
-int pin7 = 7;
-int pin8 = 6;
+#include <PinGroup.h>
+
+const uint8_t pin1 = 13;
+const uint8_t pin2 = 12;
+const uint8_t pin3 = 11;
+const uint8_t pin4 = 10;
+const uint8_t pin5 = 9;
+const uint8_t pin6 = 8;
+const uint8_t pin7 = 7;
+const uint8_t pin8 = 6;
 
 int buttonPin = 2;
 
@@ -17,16 +19,15 @@ int name[5][8] = {
   {0, 1, 1, 0, 1, 0, 1, 1}
 };
 
-int pins[8] = {pin1, pin2, pin3, pin4, pin5, pin6, pin7, pin8};
+// All 8 LEDs change at once: one write to PORTB and one to PORTD
+typedef PinGroup<pin1, pin2, pin3, pin4, pin5, pin6, pin7, pin8> Leds;
 
 int currentPattern = 0;
 bool lastButtonState = HIGH;
 bool buttonState = HIGH;
 
 void setup() {
-  for (int i = 0; i < 8; i++) {
-    pinMode(pins[i], OUTPUT);
-  }
+  Leds::begin();
 
   pinMode(buttonPin, INPUT_PULLUP);
 
@@ -51,7 +52,9 @@ void loop() {
 }
 
 void displayPattern(int patternIndex) {
+  uint8_t bits = 0;
   for (int k = 0; k < 8; k++) {
-    digitalWrite(pins[k], name[patternIndex][k]);
+    bits |= name[patternIndex][k] << k;
   }
+  Leds::write(bits);
 }
@@ -0,0 +1,144 @@
+// Throughput benchmark for lib/AdaptiveSignal on a simple queueing model of
+// the grade 11 intersection: random arrivals on each road, one car leaves per
+// headway on green after the startup loss, fixed yellow and all-red.
+
+#include <AdaptiveSignal.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+const uint32_t YELLOW_MS = 3000;
+const uint32_t ALL_RED_MS = 2000;
+const uint32_t FIXED_GREEN_MS = 10000;
+const uint32_t HOUR_MS = 3600000;
+const AdaptiveSignal::Config config = {5000, 30000, 2000, 2000};
+
+struct Result {
+  uint32_t vehiclesPerHour;
+  uint32_t leftWaiting;
+};
+
+// One hour of traffic. Each road gets a car in a given millisecond with
+// probability perHour / 3600000, from the same random sequence every run.
+Result runHour(bool adaptiveTiming, const uint32_t perHour[2]) {
+  AdaptiveSignal adaptive(config);
+  uint32_t queue[2] = {0, 0};
+  uint32_t departed = 0;
+  uint8_t road = 0;
+  uint32_t now = 0;
+  srand(42);
+
+  while (now < HOUR_MS) {
+    uint32_t green = adaptiveTiming ? adaptive.greenTime(road, now) : FIXED_GREEN_MS;
+    adaptive.greenStarted(road, now);
+    uint32_t greenEnd = now + green;
+    uint32_t phaseEnd = greenEnd + YELLOW_MS + ALL_RED_MS;
+    uint32_t nextDeparture = now + config.startupLostMs;
+
+    for (; now < phaseEnd; now++) {
+      for (uint8_t r = 0; r < 2; r++) {
+        if ((uint32_t)rand() % HOUR_MS < perHour[r]) {
+          queue[r]++;
+          adaptive.addArrivals(r, 1, now);
+        }
+      }
+      if (now == nextDeparture && now < greenEnd) {
+        if (queue[road] > 0) {
+          queue[road]--;
+          departed++;
+        }
+        nextDeparture += config.headwayMs;
+      }
+      if (now == greenEnd) {
+        adaptive.greenEnded(road, now);
+      }
+    }
+    road = (road + 1) % 2;
+  }
+
+  Result result = {departed, queue[0] + queue[1]};
+  return result;
+}
+
+void benchmark(const char *name, const uint32_t perHour[2]) {
+  Result fixed = runHour(false, perHour);
+  Result adaptive = runHour(true, perHour);
+  printf("%-12s demand %4u + %4u veh/h  fixed %4u veh/h (%3u left)  adaptive %4u veh/h (%3u left)\n",
+         name, (unsigned)perHour[0], (unsigned)perHour[1], (unsigned)fixed.vehiclesPerHour,
+         (unsigned)fixed.leftWaiting, (unsigned)adaptive.vehiclesPerHour,
+         (unsigned)adaptive.leftWaiting);
+
+  // Never moves fewer cars than the fixed plan
+  TEST_ASSERT_TRUE(adaptive.vehiclesPerHour >= fixed.vehiclesPerHour);
+}
+
+void test_green_is_minimum_without_demand() {
+  AdaptiveSignal adaptive(config);
+  TEST_ASSERT_EQUAL_UINT32(config.minGreenMs, adaptive.greenTime(0, 1000));
+  TEST_ASSERT_EQUAL_UINT32(config.minGreenMs, adaptive.greenTime(1, 1000));
+}
+
+void test_green_is_maximum_when_other_road_is_empty() {
+  AdaptiveSignal adaptive(config);
+  adaptive.addArrivals(0, 1, 1000);
+  TEST_ASSERT_EQUAL_UINT32(config.maxGreenMs, adaptive.greenTime(0, 2000));
+  TEST_ASSERT_EQUAL_UINT32(config.minGreenMs, adaptive.greenTime(1, 2000));
+}
+
+void test_green_grows_with_the_queue() {
+  AdaptiveSignal adaptive(config);
+  adaptive.addArrivals(1, 1, 0);
+  adaptive.addArrivals(0, 4, 0);
+  uint32_t shortQueue = adaptive.greenTime(0, 1000);
+  adaptive.addArrivals(0, 4, 1000);
+  uint32_t longQueue = adaptive.greenTime(0, 1000);
+
+  TEST_ASSERT_TRUE(shortQueue > config.startupLostMs + 4 * config.headwayMs);
+  TEST_ASSERT_TRUE(longQueue > shortQueue);
+  TEST_ASSERT_TRUE(longQueue <= config.maxGreenMs);
+}
+
+void test_queue_discharges_on_green() {
+  AdaptiveSignal adaptive(config);
+  adaptive.addArrivals(0, 5, 0);
+  adaptive.greenStarted(0, 1000);
+  adaptive.greenEnded(0, 1000 + config.startupLostMs + 3 * config.headwayMs);
+  TEST_ASSERT_EQUAL_UINT32(2, adaptive.queue(0));
+  TEST_ASSERT_EQUAL_UINT32(3, adaptive.served(0));
+}
+
+void test_rate_forgets_old_arrivals() {
+  AdaptiveSignal adaptive(config);
+  adaptive.addArrivals(0, 10, 0);
+  TEST_ASSERT_EQUAL_UINT32(300, adaptive.arrivalsPerHour(0, 5000));
+  TEST_ASSERT_EQUAL_UINT32(0, adaptive.arrivalsPerHour(0, 200000));
+}
+
+void test_throughput_light_traffic() {
+  const uint32_t perHour[2] = {300, 100};
+  benchmark("light", perHour);
+}
+
+void test_throughput_unbalanced() {
+  const uint32_t perHour[2] = {900, 150};
+  benchmark("unbalanced", perHour);
+}
+
+void test_throughput_heavy() {
+  const uint32_t perHour[2] = {800, 700};
+  benchmark("heavy", perHour);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_green_is_minimum_without_demand);
+  RUN_TEST(test_green_is_maximum_when_other_road_is_empty);
+  RUN_TEST(test_green_grows_with_the_queue);
+  RUN_TEST(test_queue_discharges_on_green);
+  RUN_TEST(test_rate_forgets_old_arrivals);
+  RUN_TEST(test_throughput_light_traffic);
+  RUN_TEST(test_throughput_unbalanced);
+  RUN_TEST(test_throughput_heavy);
+  return UNITY_END();
+}
@@ -0,0 +1,151 @@
+// Host tests for lib/AdcService: the decimation is fed synthetic DMA frames
+// in the controller's TYPE1 format, and DoubleBuffer is hammered from two
+// threads.
+
+#include <AdcService.h>
+#include <unity.h>
+
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+const uint16_t SAMPLES_PER_VALUE = 1 << (2 * ADC_SERVICE_OVERSAMPLE_BITS);
+
+uint16_t type1(uint8_t channel, uint16_t value) {
+  return (channel << 12) | (value & 0x0FFF);
+}
+
+// One DMA frame's worth of conversions, pins alternating as the pattern does
+void feed(AdcService &adc, const std::vector<uint16_t> &conversions) {
+  for (size_t i = 0; i < conversions.size(); i += 64) {
+    size_t count = conversions.size() - i < 64 ? conversions.size() - i : 64;
+    adc.addSamples(&conversions[i], count);
+  }
+}
+
+void test_pins_map_to_adc1_channels() {
+  AdcService adc;
+  TEST_ASSERT_EQUAL(0, adc.addPin(34));
+  TEST_ASSERT_EQUAL(1, adc.addPin(32));
+  TEST_ASSERT_EQUAL(0, adc.addPin(34)); // same pin, same index
+  TEST_ASSERT_EQUAL(-1, adc.addPin(25)); // ADC2
+  TEST_ASSERT_EQUAL(-1, adc.addPin(2));
+  TEST_ASSERT_TRUE(adc.begin());
+}
+
+void test_oversampled_values_per_pin() {
+  AdcService adc;
+  adc.addPin(34); // channel 6
+  adc.addPin(32); // channel 4
+
+  std::vector<uint16_t> conversions;
+  for (int i = 0; i < SAMPLES_PER_VALUE; i++) {
+    // 1000.25 on average: the extra bits resolve the quarter
+    conversions.push_back(type1(6, i % 4 == 0 ? 1001 : 1000));
+    conversions.push_back(type1(4, 3000));
+    conversions.push_back(type1(5, 4095)); // a channel nobody asked for
+  }
+  TEST_ASSERT_EQUAL(0, adc.updates());
+  feed(adc, conversions);
+
+  TEST_ASSERT_EQUAL(1, adc.updates());
+  TEST_ASSERT_EQUAL(16004, adc.read(0));
+  TEST_ASSERT_EQUAL(1000, adc.read12(0));
+  TEST_ASSERT_EQUAL(3000 << ADC_SERVICE_OVERSAMPLE_BITS, adc.read(1));
+  TEST_ASSERT_EQUAL(3000, adc.read12(1));
+}
+
+void test_frame_waits_for_every_pin() {
+  AdcService adc;
+  adc.addPin(34);
+  adc.addPin(32);
+
+  std::vector<uint16_t> conversions(SAMPLES_PER_VALUE, type1(6, 2000));
+  feed(adc, conversions);
+  TEST_ASSERT_EQUAL(0, adc.updates());
+
+  conversions.assign(SAMPLES_PER_VALUE, type1(4, 100));
+  feed(adc, conversions);
+  AdcService::Frame frame;
+  TEST_ASSERT_EQUAL(1, adc.readFrame(frame));
+  TEST_ASSERT_EQUAL(2000 << ADC_SERVICE_OVERSAMPLE_BITS, frame.values[0]);
+  TEST_ASSERT_EQUAL(100 << ADC_SERVICE_OVERSAMPLE_BITS, frame.values[1]);
+}
+
+void test_noise_is_averaged_down() {
+  AdcService adc;
+  adc.addPin(36); // channel 0
+  srand(3);
+
+  // Sum of uniforms, roughly normal, +/- 40 counts around 2048
+  const int VALUES = 200;
+  double rawSquares = 0;
+  std::vector<double> outputs;
+  std::vector<uint16_t> conversions;
+  for (int v = 0; v < VALUES; v++) {
+    conversions.clear();
+    for (int i = 0; i < SAMPLES_PER_VALUE; i++) {
+      int noise = rand() % 41 + rand() % 41 - 40;
+      rawSquares += noise * noise;
+      conversions.push_back(type1(0, 2048 + noise));
+    }
+    feed(adc, conversions);
+    outputs.push_back(adc.read(0) / (double)(1 << ADC_SERVICE_OVERSAMPLE_BITS));
+  }
+
+  double rawSd = sqrt(rawSquares / (VALUES * SAMPLES_PER_VALUE));
+  double squares = 0;
+  for (double output : outputs) {
+    squares += (output - 2048) * (output - 2048);
+  }
+  double sd = sqrt(squares / VALUES);
+  printf("raw noise %.1f counts, oversampled %.2f counts\n", rawSd, sd);
+  TEST_ASSERT_TRUE(sd < rawSd / 10);
+}
+
+struct Pair {
+  uint32_t value;
+  uint32_t check; // always ~value
+  uint8_t padding[56];
+};
+
+void test_double_buffer_never_tears() {
+  DoubleBuffer<Pair> buffer;
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    Pair pair = {};
+    for (uint32_t i = 1; i <= 2000000; i++) {
+      pair.value = i;
+      pair.check = ~i;
+      buffer.publish(pair);
+    }
+    done = true;
+  });
+
+  uint32_t reads = 0;
+  uint32_t last = 0;
+  while (!done) {
+    Pair pair;
+    uint32_t sequence = buffer.read(pair);
+    if (sequence == 0) {
+      continue;
+    }
+    TEST_ASSERT_TRUE(pair.check == ~pair.value);
+    TEST_ASSERT_TRUE(pair.value >= last);
+    last = pair.value;
+    reads++;
+  }
+  writer.join();
+  TEST_ASSERT_TRUE(reads > 0);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_pins_map_to_adc1_channels);
+  RUN_TEST(test_oversampled_values_per_pin);
+  RUN_TEST(test_frame_waits_for_every_pin);
+  RUN_TEST(test_noise_is_averaged_down);
+  RUN_TEST(test_double_buffer_never_tears);
+  return UNITY_END();
+}
@@ -0,0 +1,80 @@
+// Host tests for lib/AsyncLcd: its task runs under the lib/ArduinoSim
+// scheduler, so commands only reach the LCD inside sim::runFor().
+
+#include <AsyncLcd.h>
+#include <LiquidCrystal.h>
+#include <Sim.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <string>
+
+LiquidCrystal lcd(12, 11, 5, 4, 3, 2);
+LcdFrame frame(lcd);
+AsyncLcd screen(frame);
+
+const uint64_t MS = 1000;
+
+std::string glassRow(uint8_t row) {
+  std::string text;
+  for (uint8_t col = 0; col < LcdFrame::COLS; col++) {
+    text += lcd.charAt(col, row);
+  }
+  return text;
+}
+
+void test_draw_reaches_the_lcd() {
+  screen.printLine(0, "Speed:");
+  screen.setCursor(7, 0);
+  screen.print(48);
+  screen.print(" km/h");
+  screen.render();
+  // Nothing is drawn until the task runs
+  TEST_ASSERT_EQUAL_STRING("                ", glassRow(0).c_str());
+
+  sim::runFor(100 * MS);
+  TEST_ASSERT_EQUAL_STRING("Speed: 48 km/h  ", glassRow(0).c_str());
+  TEST_ASSERT_EQUAL(0, screen.dropped());
+}
+
+void test_full_queue_drops_whole_draws() {
+  // The task does not run meanwhile: 21 draws of three commands leave one
+  // slot of the 64
+  char line[LcdFrame::COLS + 1];
+  for (int i = 0; i < 21; i++) {
+    snprintf(line, sizeof(line), "frame %d", i);
+    screen.clear();
+    screen.printLine(0, line);
+    screen.render();
+  }
+  TEST_ASSERT_EQUAL(0, screen.dropped());
+
+  // Its clear would fit, but not the rest
+  screen.clear();
+  screen.printLine(1, "lost");
+  screen.render();
+  TEST_ASSERT_EQUAL(1, screen.dropped());
+
+  sim::runFor(100 * MS);
+  TEST_ASSERT_EQUAL_STRING("frame 20        ", glassRow(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("                ", glassRow(1).c_str());
+
+  // A draw on top of what is there finds the last whole draw, not a
+  // cleared frame
+  screen.setCursor(15, 0);
+  screen.print('!');
+  screen.render();
+  sim::runFor(100 * MS);
+  TEST_ASSERT_EQUAL_STRING("frame 20       !", glassRow(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("                ", glassRow(1).c_str());
+}
+
+int main(int argc, char **argv) {
+  lcd.begin(LcdFrame::COLS, LcdFrame::ROWS);
+  screen.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_draw_reaches_the_lcd);
+  RUN_TEST(test_full_queue_drops_whole_draws);
+  return UNITY_END();
+}
@@ -0,0 +1,83 @@
+// Host tests for lib/BeepPlayer. Nothing arms a timer on the host, so the
+// tests call advance() where the timer callback would.
+
+#include <BeepPlayer.h>
+#include <Sim.h>
+#include <unity.h>
+
+const uint8_t BUZZER = 22;
+
+const BeepPlayer::Step doubleSteps[] = {{300, 200}, {300, 1000}};
+const BeepPlayer::Pattern doubleBeep = {doubleSteps, 2, BeepPlayer::FOREVER};
+
+const BeepPlayer::Step chirpSteps[] = {{50, 0}};
+const BeepPlayer::Pattern chirps = {chirpSteps, 1, 3};
+
+void test_plays_steps_in_order() {
+  BeepPlayer buzzer(BUZZER);
+  TEST_ASSERT_TRUE(buzzer.begin());
+  TEST_ASSERT_EQUAL(0, sim::pinLevel(BUZZER));
+
+  buzzer.play(doubleBeep);
+  TEST_ASSERT_TRUE(buzzer.playing());
+  TEST_ASSERT_EQUAL(1, sim::pinLevel(BUZZER));
+
+  // off 200, on 300, off 1000, then round again
+  const uint32_t delays[] = {200, 300, 1000, 300, 200};
+  const uint8_t levels[] = {0, 1, 0, 1, 0};
+  for (uint8_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(delays[i], buzzer.advance());
+    TEST_ASSERT_EQUAL(levels[i], sim::pinLevel(BUZZER));
+  }
+  TEST_ASSERT_TRUE(buzzer.playing());
+}
+
+void test_replaying_same_pattern_carries_on() {
+  BeepPlayer buzzer(BUZZER);
+  buzzer.begin();
+  buzzer.play(doubleBeep);
+  buzzer.advance(); // into the first gap
+  buzzer.play(doubleBeep);
+  TEST_ASSERT_EQUAL(0, sim::pinLevel(BUZZER));
+  TEST_ASSERT_EQUAL(300, buzzer.advance());
+}
+
+void test_repeats_then_stops() {
+  BeepPlayer buzzer(BUZZER);
+  buzzer.begin();
+  buzzer.play(chirps);
+
+  // No gap configured: each off edge goes straight into the next beep
+  TEST_ASSERT_EQUAL(50, buzzer.advance());
+  TEST_ASSERT_EQUAL(1, sim::pinLevel(BUZZER));
+  TEST_ASSERT_EQUAL(50, buzzer.advance());
+  TEST_ASSERT_EQUAL(0, buzzer.advance());
+  TEST_ASSERT_EQUAL(0, sim::pinLevel(BUZZER));
+  TEST_ASSERT_FALSE(buzzer.playing());
+  TEST_ASSERT_EQUAL(0, buzzer.advance());
+}
+
+void test_stop_and_switch_patterns() {
+  BeepPlayer buzzer(BUZZER);
+  buzzer.begin();
+  buzzer.play(doubleBeep);
+  buzzer.stop();
+  TEST_ASSERT_FALSE(buzzer.playing());
+  TEST_ASSERT_EQUAL(0, sim::pinLevel(BUZZER));
+
+  buzzer.play(doubleBeep);
+  buzzer.advance();
+  buzzer.play(chirps); // a different pattern starts from its first step
+  TEST_ASSERT_TRUE(buzzer.current() == &chirps);
+  TEST_ASSERT_EQUAL(1, sim::pinLevel(BUZZER));
+  TEST_ASSERT_EQUAL(50, buzzer.advance());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_plays_steps_in_order);
+  RUN_TEST(test_replaying_same_pattern_carries_on);
+  RUN_TEST(test_repeats_then_stops);
+  RUN_TEST(test_stop_and_switch_patterns);
+  return UNITY_END();
+}
@@ -0,0 +1,74 @@
+// Host tests for lib/LcdFrame against the HD44780 model in lib/ArduinoSim
+
+#include <LcdFrame.h>
+#include <LiquidCrystal.h>
+#include <unity.h>
+
+#include <string>
+
+LiquidCrystal lcd(12, 11, 5, 4, 3, 2);
+LcdFrame frame(lcd);
+
+std::string glassRow(uint8_t row) {
+  std::string text;
+  for (uint8_t col = 0; col < LcdFrame::COLS; col++) {
+    text += lcd.charAt(col, row);
+  }
+  return text;
+}
+
+void blankScreen() {
+  lcd.begin(LcdFrame::COLS, LcdFrame::ROWS);
+  frame.begin();
+}
+
+void test_render_sends_only_changed_cells() {
+  blankScreen();
+  frame.printLine(0, "Speed: 48 km/h");
+  frame.render();
+  TEST_ASSERT_FALSE(frame.dirty());
+
+  uint32_t before = lcd.busBytes();
+  frame.printLine(0, "Speed: 52 km/h");
+  // One cursor move and two characters
+  TEST_ASSERT_EQUAL(3, frame.render());
+  TEST_ASSERT_EQUAL_STRING("Speed: 52 km/h  ", glassRow(0).c_str());
+  TEST_ASSERT_TRUE(lcd.busBytes() > before);
+}
+
+void test_long_print_stays_on_its_row() {
+  blankScreen();
+  frame.setCursor(10, 0);
+  // Longer than 256 characters, so an 8-bit column would wrap back on screen
+  for (int i = 0; i < 300; i++) {
+    frame.print('x');
+  }
+  frame.render();
+  TEST_ASSERT_EQUAL_STRING("          xxxxxx", glassRow(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("                ", glassRow(1).c_str());
+}
+
+void test_newline_moves_to_the_next_row() {
+  blankScreen();
+  frame.print("Cars: 12");
+  frame.println();
+  frame.print("Avg 48");
+  frame.println();
+  frame.print("dropped");
+  frame.render();
+  TEST_ASSERT_EQUAL_STRING("Cars: 12        ", glassRow(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("Avg 48          ", glassRow(1).c_str());
+
+  frame.setCursor(0, 1);
+  frame.print("ok");
+  frame.render();
+  TEST_ASSERT_EQUAL_STRING("ok", glassRow(1).substr(0, 2).c_str());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_render_sends_only_changed_cells);
+  RUN_TEST(test_long_print_stays_on_its_row);
+  RUN_TEST(test_newline_moves_to_the_next_row);
+  return UNITY_END();
+}
@@ -0,0 +1,58 @@
+// Host tests for lib/PinGroup. The register masks are checked at compile
+// time; the write itself falls back to digitalWrite() on the host.
+
+#include <PinGroup.h>
+#include <unity.h>
+
+// The ride's stepper coils, one port each
+typedef PinGroup<8, 9, 10, 11> Stepper1;
+typedef PinGroup<2, 3, 4, 5> Stepper2;
+// grade12/bin/aur.cpp: PORTB and PORTD, listed high pin first
+typedef PinGroup<13, 12, 11, 10, 9, 8, 7, 6> AurLeds;
+// grade11 servo sketch segments a-g; GPIO33 is in the second ESP32 bank
+typedef PinGroup<13, 12, 14, 27, 26, 25, 33> Segments;
+
+using namespace pin_group;
+
+static_assert(Stepper1::unoBits(UNO_PORTB, 0b0101) == 0b0101, "pins 8, 10 are PB0, PB2");
+static_assert(Stepper1::unoBits(UNO_PORTD, 0b1111) == 0, "nothing on PORTD");
+static_assert(Stepper2::unoBits(UNO_PORTD, 0b1001) == 0b100100, "pins 2, 5 are PD2, PD5");
+static_assert(AurLeds::unoBits(UNO_PORTB, 0xFF) == 0b111111, "pins 8-13 are PB0-PB5");
+static_assert(AurLeds::unoBits(UNO_PORTD, 0xFF) == 0b11000000, "pins 6, 7 are PD6, PD7");
+static_assert(AurLeds::unoBits(UNO_PORTB, 0b00000001) == 0b100000, "bit 0 is pin 13 = PB5");
+static_assert(PinGroup<14, 19>::unoBits(UNO_PORTC, 0b11) == 0b100001, "A0, A5 are PC0, PC5");
+static_assert(Segments::esp32Bits(0, 0x7F) ==
+                  ((1UL << 13) | (1UL << 12) | (1UL << 14) | (1UL << 27) | (1UL << 26) | (1UL << 25)),
+              "GPIO0-31 in bank 0");
+static_assert(Segments::esp32Bits(1, 0x7F) == 0b10, "GPIO33 is bit 1 of bank 1");
+static_assert(Segments::esp32Bits(1, 0x3F) == 0, "segment g off");
+
+void test_bits_map_to_pins_in_order() {
+  Stepper1::begin();
+  const uint8_t pins[4] = {8, 9, 10, 11};
+  const uint8_t patterns[4] = {0b0101, 0b0110, 0b1010, 0b1001};
+
+  for (int p = 0; p < 4; p++) {
+    Stepper1::write(patterns[p]);
+    for (int i = 0; i < 4; i++) {
+      TEST_ASSERT_EQUAL((patterns[p] >> i) & 1, digitalRead(pins[i]));
+    }
+  }
+}
+
+void test_precomputed_pattern() {
+  static const Stepper2::Pattern coils = Stepper2::pattern(0b0110);
+  Stepper2::begin();
+  Stepper2::write(coils);
+  TEST_ASSERT_EQUAL(LOW, digitalRead(2));
+  TEST_ASSERT_EQUAL(HIGH, digitalRead(3));
+  TEST_ASSERT_EQUAL(HIGH, digitalRead(4));
+  TEST_ASSERT_EQUAL(LOW, digitalRead(5));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_bits_map_to_pins_in_order);
+  RUN_TEST(test_precomputed_pattern);
+  return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// Host tests and per-sample benchmark for lib/RangeFilter
+
+#include <RangeFilter.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+template <uint8_t N>
+void checkMedianAgainstSort(uint32_t seed) {
+  srand(seed);
+  SlidingMedian<N> median;
+  std::vector<int32_t> all;
+  for (int i = 0; i < 2000; i++) {
+    // Plenty of repeats, which is where heap bookkeeping goes wrong
+    int32_t value = rand() % 50 - 10;
+    all.push_back(value);
+    int32_t got = median.add(value);
+
+    std::vector<int32_t> window(all.end() - std::min<size_t>(all.size(), N), all.end());
+    std::sort(window.begin(), window.end());
+    TEST_ASSERT_EQUAL(window[(window.size() - 1) / 2], got);
+  }
+}
+
+void test_sliding_median_matches_sorting() {
+  checkMedianAgainstSort<1>(1);
+  checkMedianAgainstSort<3>(2);
+  checkMedianAgainstSort<5>(3);
+  checkMedianAgainstSort<15>(4);
+  checkMedianAgainstSort<63>(5);
+}
+
+void test_single_spurious_echo_is_ignored() {
+  RangeFilter<5> filter;
+  uint32_t t = 0;
+  for (int i = 0; i < 10; i++) {
+    filter.add(1500, t += 60);
+  }
+  // One echo off something close, then back to normal
+  TEST_ASSERT_FALSE(filter.add(150, t += 60));
+  TEST_ASSERT_TRUE(filter.add(1500, t += 60));
+  TEST_ASSERT_EQUAL(1500, filter.distance());
+  TEST_ASSERT_EQUAL(1, filter.outliers());
+}
+
+void test_real_jump_is_believed() {
+  RangeFilter<5> filter;
+  uint32_t t = 0;
+  for (int i = 0; i < 10; i++) {
+    filter.add(2000, t += 60);
+  }
+  // Someone steps in front: gated twice, then the median follows
+  TEST_ASSERT_FALSE(filter.add(400, t += 60));
+  TEST_ASSERT_FALSE(filter.add(400, t += 60));
+  for (int i = 0; i < 6; i++) {
+    filter.add(400, t += 60);
+  }
+  TEST_ASSERT_INT_WITHIN(50, 400, filter.distance());
+}
+
+void test_disagreeing_outliers_are_not_believed() {
+  RangeFilter<5> filter;
+  uint32_t t = 0;
+  for (int i = 0; i < 10; i++) {
+    filter.add(1000, t += 60);
+  }
+  // Wild both ways, never twice in the same place
+  for (int i = 0; i < 6; i++) {
+    TEST_ASSERT_FALSE(filter.add(i % 2 ? 3000 : 30, t += 60));
+  }
+  TEST_ASSERT_TRUE(filter.add(1000, t += 60));
+  TEST_ASSERT_EQUAL(1000, filter.distance());
+  TEST_ASSERT_EQUAL(6, filter.outliers());
+}
+
+void test_velocity_of_an_approach() {
+  // Walking in at 800 mm/s, read every 60 ms with +/-10 mm of noise
+  RangeFilter<5> filter;
+  srand(7);
+  uint32_t t = 0;
+  for (int i = 0; i < 40; i++) {
+    int32_t mm = 4000 - 800 * (int32_t)t / 1000 + rand() % 21 - 10;
+    filter.add(mm, t);
+    t += 60;
+  }
+  TEST_ASSERT_INT_WITHIN(100, -800, filter.velocity());
+
+  // Standing still again
+  int32_t stopped = filter.distance();
+  for (int i = 0; i < 40; i++) {
+    filter.add(stopped, t += 60);
+  }
+  TEST_ASSERT_INT_WITHIN(30, 0, filter.velocity());
+}
+
+template <uint8_t N>
+void benchmarkWindow() {
+  const int SAMPLES = 1000000;
+  std::vector<int32_t> input(SAMPLES);
+  srand(N);
+  for (int i = 0; i < SAMPLES; i++) {
+    input[i] = 1000 + rand() % 200 + (rand() % 50 == 0 ? 2000 : 0);
+  }
+
+  RangeFilter<N> filter;
+  int32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SAMPLES; i++) {
+    filter.add(input[i], i * 60);
+    sink += filter.distance();
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+
+  // Baseline: copy the window and select its median for every sample
+  int32_t window[N] = {};
+  int32_t scratch[N];
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < SAMPLES; i++) {
+    window[i % N] = input[i];
+    std::copy(window, window + N, scratch);
+    std::nth_element(scratch, scratch + N / 2, scratch + N);
+    sink += scratch[N / 2];
+  }
+  end = std::chrono::steady_clock::now();
+  double naiveNs = std::chrono::duration<double, std::nano>(end - start).count() / SAMPLES;
+
+  printf("window %2u  chain %5.1f ns/sample, copy+select median alone %5.1f ns/sample (host)  (%d)\n",
+         N, ns, naiveNs, (int)(sink & 1));
+}
+
+void test_per_sample_benchmark() {
+  benchmarkWindow<5>();
+  benchmarkWindow<15>();
+  benchmarkWindow<63>();
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sliding_median_matches_sorting);
+  RUN_TEST(test_single_spurious_echo_is_ignored);
+  RUN_TEST(test_real_jump_is_believed);
+  RUN_TEST(test_disagreeing_outliers_are_not_believed);
+  RUN_TEST(test_velocity_of_an_approach);
+  RUN_TEST(test_per_sample_benchmark);
+  return UNITY_END();
+}
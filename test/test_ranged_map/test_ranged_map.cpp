@@ -0,0 +1,95 @@
+// Host tests and per-call benchmark for lib/RangedMap: every input of the
+// sketches' mappings against Arduino's map()
+
+#include <Arduino.h>
+#include <RangedMap.h>
+#include <unity.h>
+
+#include <chrono>
+#include <stdio.h>
+#include <vector>
+
+// Worked out by the compiler
+static_assert(ranged_map<0, 4095, 20, 160>(4095) == 160, "constexpr");
+static_assert(ranged_map<0, 4095, 255, 0>(0) == 255, "constexpr");
+
+template <long InMin, long InMax, long OutMin, long OutMax>
+void checkAgainstMap(long from, long to) {
+  long lowOut = OutMin < OutMax ? OutMin : OutMax;
+  long highOut = OutMin < OutMax ? OutMax : OutMin;
+  long lowIn = InMin < InMax ? InMin : InMax;
+  long highIn = InMin < InMax ? InMax : InMin;
+  for (long x = from; x <= to; x++) {
+    long got = ranged_map<InMin, InMax, OutMin, OutMax>(x);
+    if (x >= lowIn && x <= highIn) {
+      TEST_ASSERT_EQUAL(map(x, InMin, InMax, OutMin, OutMax), got);
+    }
+    else {
+      TEST_ASSERT_EQUAL(constrain(map(x, InMin, InMax, OutMin, OutMax), lowOut, highOut), got);
+    }
+  }
+}
+
+void test_sketch_mappings_match_map() {
+  checkAgainstMap<0, 4095, 20, 160>(-100, 4200);   // servo
+  checkAgainstMap<0, 4095, 1, 30>(-100, 4200);     // distance thresholds
+  checkAgainstMap<0, 4095, 255, 0>(-100, 4200);    // night light red
+  checkAgainstMap<0, 4095, 0, 255>(-100, 4200);    // night light green
+  checkAgainstMap<2048, 4095, 0, 255>(0, 4200);    // night light blue
+  checkAgainstMap<500, 4000, 0, 180>(0, 4200);     // photoresistor servo
+  checkAgainstMap<0, 4095, 200, 2000>(-100, 4200); // potentiometer tone
+  checkAgainstMap<0, 4095, 1000, 100>(-100, 4200); // potentiometer blink
+}
+
+void test_backwards_and_wide_ranges() {
+  checkAgainstMap<4095, 0, 0, 100>(-10, 4105);
+  checkAgainstMap<1023, 0, 255, 0>(-10, 1033);
+  checkAgainstMap<0, 65535, 0, 4095>(0, 65535);
+  // Needs the 64-bit multiply
+  checkAgainstMap<-50000, 50000, -1000000, 1000000>(-50100, 50100);
+  TEST_ASSERT_FALSE((ranged_map_detail::Map<-50000, 50000, -1000000, 1000000>::narrow()));
+  TEST_ASSERT_TRUE((ranged_map_detail::Map<0, 4095, 0, 255>::narrow()));
+}
+
+void test_saturates_instead_of_extrapolating() {
+  TEST_ASSERT_EQUAL(20, (ranged_map<0, 4095, 20, 160>(-5)));
+  TEST_ASSERT_EQUAL(160, (ranged_map<0, 4095, 20, 160>(70000)));
+  TEST_ASSERT_EQUAL(0, (ranged_map<2048, 4095, 0, 255>(100)));
+  TEST_ASSERT_EQUAL(180, (ranged_map<500, 4000, 0, 180>(4095)));
+}
+
+void test_per_call_benchmark() {
+  const int CALLS = 10000000;
+  std::vector<long> readings(CALLS);
+  srand(25);
+  for (int i = 0; i < CALLS; i++) {
+    readings[i] = rand() % 4096;
+  }
+
+  long sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < CALLS; i++) {
+    sink += constrain(map(readings[i], 500, 4000, 0, 180), 0, 180);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double mapNs = std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < CALLS; i++) {
+    sink += ranged_map<500, 4000, 0, 180>(readings[i]);
+  }
+  end = std::chrono::steady_clock::now();
+  double rangedNs = std::chrono::duration<double, std::nano>(end - start).count() / CALLS;
+
+  printf("map()+constrain() %.2f ns/call, ranged_map %.2f ns/call (host)  (%ld)\n", mapNs, rangedNs,
+         sink & 1);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_sketch_mappings_match_map);
+  RUN_TEST(test_backwards_and_wide_ranges);
+  RUN_TEST(test_saturates_instead_of_extrapolating);
+  RUN_TEST(test_per_call_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,105 @@
+// Host tests for lib/RgbLed: the compile-time gamma table and what goes
+// through the mailbox. The LEDC and the fade task only exist on the ESP32,
+// so service() stands in for the task.
+//
+// LEDs keep their channels for good, so each test that makes one first
+// gives them all back with resetChannels().
+
+#include <RgbLed.h>
+#include <unity.h>
+
+#include <math.h>
+#include <stdio.h>
+
+double referenceDuty(int level, uint16_t maxDuty) {
+  double lightness = level * 100.0 / 255;
+  double y = lightness <= 8 ? lightness / 903.3 : pow((lightness + 16) / 116, 3);
+  return y * maxDuty;
+}
+
+void test_gamma_matches_cie_curve() {
+  TEST_ASSERT_EQUAL(0, RgbLed::GAMMA[0]);
+  TEST_ASSERT_EQUAL(RgbLed::MAX_DUTY, RgbLed::GAMMA[255]);
+  for (int level = 0; level < 256; level++) {
+    TEST_ASSERT_TRUE(fabs(RgbLed::GAMMA[level] - referenceDuty(level, RgbLed::MAX_DUTY)) <= 0.5);
+    if (level > 0) {
+      TEST_ASSERT_TRUE(RgbLed::GAMMA[level] >= RgbLed::GAMMA[level - 1]);
+    }
+  }
+  // Half of 255 looks about half as bright: 18% duty, not 50%
+  TEST_ASSERT_INT_WITHIN(20, 1530, RgbLed::GAMMA[128]);
+}
+
+void test_dim_end_keeps_its_steps() {
+  // The same curve at the old 8 bits merges most of the dim levels
+  int distinct13 = 1;
+  int distinct8 = 1;
+  for (int level = 1; level < 256; level++) {
+    distinct13 += RgbLed::GAMMA[level] != RgbLed::GAMMA[level - 1];
+    distinct8 += lround(referenceDuty(level, 255)) != lround(referenceDuty(level - 1, 255));
+  }
+  printf("distinct levels: %d at %d bits, %d at 8 bits\n", distinct13, RgbLed::BITS, distinct8);
+  TEST_ASSERT_TRUE(distinct13 >= 250);
+  TEST_ASSERT_TRUE(distinct8 < 200);
+}
+
+void test_set_color_records_target() {
+  RgbLed::resetChannels();
+  RgbLed led(19, 21, 18);
+  TEST_ASSERT_TRUE(led.begin());
+  led.setColor(255, 50, 0, 200);
+  RgbLed::Color color = led.color();
+  TEST_ASSERT_EQUAL(255, color.red);
+  TEST_ASSERT_EQUAL(50, color.green);
+  TEST_ASSERT_EQUAL(0, color.blue);
+  led.off();
+  TEST_ASSERT_EQUAL(0, led.color().red);
+}
+
+void test_mailbox_carries_fade_and_skips_repeats() {
+  RgbLed::resetChannels();
+  RgbLed led(1, 2, 3);
+  TEST_ASSERT_TRUE(led.begin());
+  TEST_ASSERT_FALSE(led.service());
+
+  led.setColor(10, 20, 30, 500);
+  TEST_ASSERT_TRUE(led.service());
+  RgbLed::Target applied = led.applied();
+  TEST_ASSERT_EQUAL(10, applied.color.red);
+  TEST_ASSERT_EQUAL(20, applied.color.green);
+  TEST_ASSERT_EQUAL(30, applied.color.blue);
+  TEST_ASSERT_EQUAL(500, applied.fadeMs);
+
+  // The color it is already going to: nothing posted
+  led.setColor(10, 20, 30, 0);
+  TEST_ASSERT_FALSE(led.service());
+
+  // Set twice before the task looks: only the latest is applied
+  led.setColor(0, 0, 255, 0);
+  led.off(1000);
+  TEST_ASSERT_TRUE(led.service());
+  TEST_ASSERT_FALSE(led.service());
+  TEST_ASSERT_EQUAL(0, led.applied().color.blue);
+  TEST_ASSERT_EQUAL(1000, led.applied().fadeMs);
+}
+
+void test_third_led_has_no_channels() {
+  // Three channels each: a third LED does not fit in the low-speed group
+  RgbLed::resetChannels();
+  RgbLed first(1, 2, 3);
+  RgbLed second(4, 5, 6);
+  TEST_ASSERT_TRUE(first.begin());
+  TEST_ASSERT_TRUE(second.begin());
+  RgbLed third(7, 8, 9);
+  TEST_ASSERT_FALSE(third.begin());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_gamma_matches_cie_curve);
+  RUN_TEST(test_dim_end_keeps_its_steps);
+  RUN_TEST(test_set_color_records_target);
+  RUN_TEST(test_mailbox_carries_fade_and_skips_repeats);
+  RUN_TEST(test_third_led_has_no_channels);
+  return UNITY_END();
+}
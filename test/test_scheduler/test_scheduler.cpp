@@ -0,0 +1,183 @@
+// Host tests for lib/Scheduler. Time is whatever the tests pass to run(), so
+// nothing here waits.
+
+#include <Scheduler.h>
+#include <unity.h>
+
+#include <string>
+#include <vector>
+
+std::vector<char> ran;
+
+void taskA() { ran.push_back('a'); }
+void taskB() { ran.push_back('b'); }
+void taskC() { ran.push_back('c'); }
+
+Scheduler *current = NULL;
+uint8_t selfId = Scheduler::NO_TASK;
+unsigned long selfNow = 0;
+
+void restartsItself() {
+  ran.push_back('r');
+  current->restart(selfId, 30, selfNow);
+}
+
+std::string order() {
+  return std::string(ran.begin(), ran.end());
+}
+
+void test_runs_tasks_in_deadline_order() {
+  ran.clear();
+  Scheduler scheduler;
+  scheduler.after(30, taskC, 0);
+  scheduler.after(10, taskA, 0);
+  scheduler.after(20, taskB, 0);
+
+  TEST_ASSERT_EQUAL(10, scheduler.nextDeadline());
+  TEST_ASSERT_EQUAL(10, scheduler.run(0));
+  TEST_ASSERT_EQUAL_STRING("", order().c_str());
+
+  // All three are due; they still run earliest first
+  TEST_ASSERT_EQUAL(1000, scheduler.run(50));
+  TEST_ASSERT_EQUAL_STRING("abc", order().c_str());
+  TEST_ASSERT_EQUAL(0, scheduler.pendingCount());
+}
+
+void test_periodic_task_keeps_its_phase() {
+  ran.clear();
+  Scheduler scheduler;
+  uint8_t id = scheduler.every(100, taskA, 0);
+
+  // Late by 30, the next run is still due at 200, not 230
+  TEST_ASSERT_EQUAL(70, scheduler.run(130));
+  TEST_ASSERT_EQUAL(200, scheduler.nextDeadline());
+  scheduler.run(200);
+  TEST_ASSERT_EQUAL(2, scheduler.stats(id).runs);
+  TEST_ASSERT_EQUAL(0, scheduler.stats(id).overruns);
+  TEST_ASSERT_EQUAL(30, scheduler.stats(id).maxLate);
+}
+
+void test_missed_periods_count_as_overruns() {
+  ran.clear();
+  Scheduler scheduler;
+  uint8_t id = scheduler.every(100, taskA, 0);
+
+  // Runs once for 100, skips 200, 300 and 400
+  scheduler.run(450);
+  TEST_ASSERT_EQUAL_STRING("a", order().c_str());
+  TEST_ASSERT_EQUAL(1, scheduler.stats(id).runs);
+  TEST_ASSERT_EQUAL(3, scheduler.stats(id).overruns);
+  TEST_ASSERT_EQUAL(500, scheduler.nextDeadline());
+}
+
+void test_cancel_and_restart() {
+  ran.clear();
+  Scheduler scheduler;
+  uint8_t a = scheduler.every(10, taskA, 0);
+  uint8_t b = scheduler.after(20, taskB, 0);
+  uint8_t c = scheduler.after(30, taskC, 0);
+
+  scheduler.cancel(a);
+  TEST_ASSERT_FALSE(scheduler.pending(a));
+  scheduler.run(25);
+  TEST_ASSERT_EQUAL_STRING("b", order().c_str());
+
+  // A one-shot keeps its slot and can be armed again
+  TEST_ASSERT_FALSE(scheduler.pending(b));
+  scheduler.restart(b, 20, 25);
+  scheduler.restart(a, 0, 25);
+  scheduler.run(50);
+  TEST_ASSERT_EQUAL_STRING("bacb", order().c_str());
+  TEST_ASSERT_FALSE(scheduler.pending(c));
+  TEST_ASSERT_TRUE(scheduler.pending(a));
+}
+
+void test_added_task_waits_for_restart() {
+  ran.clear();
+  Scheduler scheduler;
+  uint8_t a = scheduler.add(taskA);
+  TEST_ASSERT_TRUE(a != Scheduler::NO_TASK);
+  TEST_ASSERT_FALSE(scheduler.pending(a));
+  TEST_ASSERT_EQUAL(0, scheduler.pendingCount());
+  TEST_ASSERT_EQUAL(1000, scheduler.run(100));
+  TEST_ASSERT_TRUE(order().empty());
+
+  scheduler.restart(a, 10, 100);
+  TEST_ASSERT_TRUE(scheduler.pending(a));
+  scheduler.run(110);
+  TEST_ASSERT_EQUAL_STRING("a", order().c_str());
+  TEST_ASSERT_FALSE(scheduler.pending(a));
+}
+
+void test_callback_can_restart_itself() {
+  ran.clear();
+  Scheduler scheduler;
+  current = &scheduler;
+  selfNow = 5;
+  selfId = scheduler.after(5, restartsItself, 0);
+
+  TEST_ASSERT_EQUAL(30, scheduler.run(5));
+  TEST_ASSERT_EQUAL_STRING("r", order().c_str());
+  TEST_ASSERT_EQUAL(35, scheduler.nextDeadline());
+}
+
+void test_deadlines_across_millis_wrap() {
+  ran.clear();
+  Scheduler scheduler;
+  unsigned long start = (unsigned long)-50;
+  scheduler.after(100, taskB, start); // due at 50, after the wrap
+  scheduler.after(20, taskA, start);  // due before the wrap
+
+  TEST_ASSERT_EQUAL(start + 20, scheduler.nextDeadline());
+  scheduler.run(start + 30);
+  TEST_ASSERT_EQUAL_STRING("a", order().c_str());
+  TEST_ASSERT_EQUAL(20, scheduler.run(30));
+  scheduler.run(50);
+  TEST_ASSERT_EQUAL_STRING("ab", order().c_str());
+}
+
+void test_full_scheduler_rejects_tasks() {
+  Scheduler scheduler;
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+    TEST_ASSERT_TRUE(scheduler.after(i, taskA, 0) != Scheduler::NO_TASK);
+  }
+  TEST_ASSERT_EQUAL(Scheduler::NO_TASK, scheduler.every(10, taskA, 0));
+  TEST_ASSERT_EQUAL(Scheduler::NO_TASK, Scheduler().every(0, taskA, 0));
+}
+
+// Cancelling from the middle of the heap has to keep it ordered
+void test_heap_stays_ordered() {
+  ran.clear();
+  Scheduler scheduler;
+  const unsigned long deadlines[SCHEDULER_MAX_TASKS] = {70, 20, 60, 10, 80, 30, 50, 40};
+  uint8_t ids[SCHEDULER_MAX_TASKS];
+  for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+    ids[i] = scheduler.after(deadlines[i], taskA, 0);
+  }
+  scheduler.cancel(ids[1]); // 20
+  scheduler.cancel(ids[6]); // 50
+
+  unsigned long last = 0;
+  while (scheduler.pendingCount() > 0) {
+    unsigned long next = scheduler.nextDeadline();
+    TEST_ASSERT_TRUE(next > last);
+    TEST_ASSERT_TRUE(next != 20 && next != 50);
+    last = next;
+    scheduler.run(next);
+  }
+  TEST_ASSERT_EQUAL(6, ran.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_runs_tasks_in_deadline_order);
+  RUN_TEST(test_periodic_task_keeps_its_phase);
+  RUN_TEST(test_missed_periods_count_as_overruns);
+  RUN_TEST(test_cancel_and_restart);
+  RUN_TEST(test_added_task_waits_for_restart);
+  RUN_TEST(test_callback_can_restart_itself);
+  RUN_TEST(test_deadlines_across_millis_wrap);
+  RUN_TEST(test_full_scheduler_rejects_tasks);
+  RUN_TEST(test_heap_stays_ordered);
+  return UNITY_END();
+}
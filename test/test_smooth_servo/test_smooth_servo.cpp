@@ -0,0 +1,103 @@
+// Host tests for lib/SmoothServo against a servo that records its writes
+
+#include <SmoothServo.h>
+#include <unity.h>
+
+#include <vector>
+
+struct FakeServo {
+  std::vector<int> writes;
+  void write(int angle) { writes.push_back(angle); }
+};
+
+void test_same_angle_is_written_once() {
+  FakeServo servo;
+  SmoothServo<FakeServo> smooth(servo);
+  for (int i = 0; i < 1000; i++) {
+    smooth.write(180);
+  }
+  TEST_ASSERT_EQUAL(1, servo.writes.size());
+  smooth.write(179);
+  TEST_ASSERT_EQUAL(2, servo.writes.size());
+  TEST_ASSERT_EQUAL(179, smooth.read());
+}
+
+void test_deadband_ignores_noise() {
+  FakeServo servo;
+  SmoothServo<FakeServo> smooth(servo, 2);
+  smooth.write(90);
+  const int noisy[] = {91, 89, 92, 88, 90, 91};
+  for (int angle : noisy) {
+    smooth.write(angle);
+  }
+  TEST_ASSERT_EQUAL(1, servo.writes.size());
+
+  // A real move gets through, and the deadband follows it
+  smooth.write(95);
+  smooth.write(94);
+  TEST_ASSERT_EQUAL(2, servo.writes.size());
+  TEST_ASSERT_EQUAL(95, smooth.read());
+  TEST_ASSERT_EQUAL(2, smooth.writes());
+}
+
+void test_slew_rate_limits_speed() {
+  FakeServo servo;
+  SmoothServo<FakeServo> smooth(servo, 0, 100); // 100 degrees per second
+  smooth.jumpTo(0);
+  smooth.update(0);
+  smooth.write(90);
+  TEST_ASSERT_EQUAL(1, servo.writes.size()); // nothing until update()
+
+  unsigned long now = 0;
+  while (smooth.update(now += 20)) {
+    TEST_ASSERT_TRUE(servo.writes.back() - servo.writes[servo.writes.size() - 2] <= 2);
+  }
+  TEST_ASSERT_EQUAL(900, now); // 90 degrees at 100 per second
+  TEST_ASSERT_EQUAL(90, smooth.read());
+  TEST_ASSERT_FALSE(smooth.moving());
+
+  // Settled, further updates write nothing
+  size_t count = servo.writes.size();
+  for (int i = 0; i < 50; i++) {
+    smooth.update(now += 20);
+  }
+  TEST_ASSERT_EQUAL(count, servo.writes.size());
+}
+
+void test_slew_reverses_mid_move() {
+  FakeServo servo;
+  SmoothServo<FakeServo> smooth(servo, 0, 50);
+  smooth.jumpTo(90);
+  smooth.update(0);
+  smooth.write(180);
+  smooth.update(100);
+  smooth.update(200); // 10 degrees along
+  TEST_ASSERT_EQUAL(100, smooth.read());
+  smooth.write(80);
+  smooth.update(300);
+  smooth.update(400);
+  TEST_ASSERT_EQUAL(90, smooth.read());
+  smooth.update(500);
+  smooth.update(600);
+  TEST_ASSERT_EQUAL(80, smooth.read());
+  TEST_ASSERT_FALSE(smooth.moving());
+}
+
+void test_long_gap_does_not_leap() {
+  FakeServo servo;
+  SmoothServo<FakeServo> smooth(servo, 0, 100);
+  smooth.jumpTo(0);
+  smooth.write(180);
+  smooth.update(60000);
+  TEST_ASSERT_EQUAL(10, smooth.read());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_same_angle_is_written_once);
+  RUN_TEST(test_deadband_ignores_noise);
+  RUN_TEST(test_slew_rate_limits_speed);
+  RUN_TEST(test_slew_reverses_mid_move);
+  RUN_TEST(test_long_gap_does_not_leap);
+  return UNITY_END();
+}
@@ -0,0 +1,180 @@
+// Host tests and sample rate benchmark for SonarArray. Each simulated HC-SR04
+// answers its trigger pulse with an echo as wide as the round trip to the
+// object placed in front of it, or the ~38 ms pulse of nothing in range.
+
+#include <SonarArray.h>
+#include <Sim.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <vector>
+
+const uint8_t SENSORS = 8;
+const uint64_t ECHO_DELAY_US = 450; // trigger to echo start
+
+uint8_t trigPin(uint8_t i) { return 10 + i; }
+uint8_t echoPin(uint8_t i) { return 30 + i; }
+
+Ultrasonic sonars[SENSORS] = {
+    Ultrasonic(10, 30), Ultrasonic(11, 31), Ultrasonic(12, 32), Ultrasonic(13, 33),
+    Ultrasonic(14, 34), Ultrasonic(15, 35), Ultrasonic(16, 36), Ultrasonic(17, 37),
+};
+SonarArray perimeter;
+
+long objectMm[SENSORS]; // -1 for nothing in range
+
+struct Ping {
+  uint8_t sensor;
+  uint64_t triggerUs;
+  uint64_t echoEndUs;
+};
+std::vector<Ping> pings;
+size_t historySeen = 0;
+
+// Answers any trigger pulses since the last call
+void answerTriggers() {
+  const std::vector<sim::PinChange> &history = sim::pinHistory();
+  for (; historySeen < history.size(); historySeen++) {
+    const sim::PinChange &change = history[historySeen];
+    if (change.level != HIGH || change.pin < trigPin(0) || change.pin >= trigPin(SENSORS)) {
+      continue;
+    }
+    uint8_t sensor = change.pin - trigPin(0);
+    uint64_t width = objectMm[sensor] < 0 ? 38000 : objectMm[sensor] * 2000 / 343;
+    uint64_t start = change.us + ECHO_DELAY_US;
+    sim::setInputAt(start, echoPin(sensor), HIGH);
+    sim::setInputAt(start + width, echoPin(sensor), LOW);
+    pings.push_back({sensor, change.us, start + width});
+  }
+}
+
+// update() from a 1 ms tick, as a scheduler task would run it
+void runFor(uint64_t us) {
+  uint64_t end = sim::nowUs() + us;
+  while (sim::nowUs() < end) {
+    sim::runFor(1000);
+    perimeter.update();
+    answerTriggers();
+  }
+}
+
+void placeObjects(long mm) {
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    objectMm[i] = mm;
+  }
+}
+
+// Lets the running ping finish so the next test starts clean
+void settle() {
+  placeObjects(-1);
+  runFor(200000);
+  pings.clear();
+}
+
+void test_sensors_take_turns_across_the_ring() {
+  placeObjects(500);
+  runFor(300000);
+  TEST_ASSERT_TRUE(pings.size() >= 16);
+  const uint8_t order[SENSORS] = {0, 3, 6, 1, 4, 7, 2, 5};
+  for (size_t i = 0; i < 16; i++) {
+    TEST_ASSERT_EQUAL(order[i % SENSORS], pings[i].sensor);
+  }
+  settle();
+}
+
+void test_only_one_sensor_pings_at_a_time() {
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    objectMm[i] = i % 3 == 0 ? -1 : 200 + 300 * i;
+  }
+  runFor(2000000);
+  for (size_t i = 1; i < pings.size(); i++) {
+    // A sensor with nothing in range stops listening at its timeout, though
+    // its echo line stays high a while longer
+    const Ping &last = pings[i - 1];
+    uint64_t listened = last.triggerUs + ECHO_DELAY_US + ULTRASONIC_TIMEOUT_US;
+    uint64_t quietFrom = last.echoEndUs < listened ? last.echoEndUs : listened;
+    TEST_ASSERT_TRUE(pings[i].triggerUs >= quietFrom + ULTRASONIC_GUARD_US);
+  }
+  settle();
+}
+
+void test_closest_object_and_bearing() {
+  placeObjects(-1);
+  objectMm[2] = 1200;
+  objectMm[5] = 700;
+  objectMm[6] = 900;
+  runFor(1000000);
+
+  SonarArray::Target target = perimeter.closest();
+  TEST_ASSERT_EQUAL(5, target.sensor);
+  TEST_ASSERT_INT_WITHIN(2, 700, target.mm);
+  TEST_ASSERT_EQUAL(225, target.bearing);
+
+  // It walks away, out of range
+  objectMm[5] = -1;
+  runFor(1000000);
+  target = perimeter.closest();
+  TEST_ASSERT_EQUAL(6, target.sensor);
+  TEST_ASSERT_EQUAL(270, target.bearing);
+
+  placeObjects(-1);
+  runFor(1000000);
+  TEST_ASSERT_EQUAL(-1, perimeter.closest().sensor);
+  settle();
+}
+
+// Samples per second, per sensor and in total, over 10 s
+double benchmark(const char *name, long mm) {
+  placeObjects(mm);
+  uint32_t before[SENSORS];
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    before[i] = perimeter.stats(i).readings;
+  }
+  runFor(10000000);
+
+  double total = 0;
+  printf("%-8s", name);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    double rate = (perimeter.stats(i).readings - before[i]) / 10.0;
+    total += rate;
+    printf(" %5.1f", rate);
+  }
+  printf("  total %6.1f Hz\n", total);
+  settle();
+  return total;
+}
+
+void test_sample_rate_benchmark() {
+  printf("sensor    ");
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    printf("%5u ", i);
+  }
+  printf("\n");
+  double nearRate = benchmark("0.3 m", 300);
+  double farRate = benchmark("3 m", 3000);
+  double emptyRate = benchmark("empty", -1);
+
+  // Each ping costs its echo, the guard time and up to one update() tick.
+  // Near objects hit the sensors' own 60 ms ping cycle instead.
+  TEST_ASSERT_TRUE(nearRate > 100);
+  TEST_ASSERT_TRUE(farRate > 40);
+  TEST_ASSERT_TRUE(emptyRate > 20);
+  for (uint8_t i = 1; i < SENSORS; i++) {
+    TEST_ASSERT_INT_WITHIN(1, perimeter.stats(0).readings, perimeter.stats(i).readings);
+  }
+}
+
+int main(int argc, char **argv) {
+  sim::runFor(1000);
+  for (uint8_t i = 0; i < SENSORS; i++) {
+    perimeter.add(sonars[i], i * 45);
+  }
+  perimeter.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_sensors_take_turns_across_the_ring);
+  RUN_TEST(test_only_one_sensor_pings_at_a_time);
+  RUN_TEST(test_closest_object_and_bearing);
+  RUN_TEST(test_sample_rate_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,104 @@
+// Host tests for lib/SpeedStats
+
+#include <SpeedStats.h>
+#include <unity.h>
+
+#include <math.h>
+#include <stdlib.h>
+
+void test_empty() {
+  SpeedStats stats;
+  TEST_ASSERT_EQUAL_UINT32(0, stats.count());
+  TEST_ASSERT_EQUAL_UINT16(0, stats.mean());
+  TEST_ASSERT_EQUAL_UINT16(0, stats.minSpeed());
+  TEST_ASSERT_EQUAL_UINT16(0, stats.percentile(85));
+  TEST_ASSERT_EQUAL_UINT16(0, stats.carsPerMinute(120000));
+}
+
+void test_mean_and_stddev_match_two_pass() {
+  SpeedStats stats;
+  srand(7);
+  double sum = 0;
+  double values[1000];
+  for (int i = 0; i < 1000; i++) {
+    values[i] = 3000 + rand() % 4000;
+    sum += values[i];
+    stats.add(values[i], i * 1000);
+  }
+  double mean = sum / 1000;
+  double squares = 0;
+  for (int i = 0; i < 1000; i++) {
+    squares += (values[i] - mean) * (values[i] - mean);
+  }
+
+  TEST_ASSERT_UINT32_WITHIN(1, (uint32_t)(mean + 0.5), stats.mean());
+  TEST_ASSERT_UINT32_WITHIN(1, (uint32_t)(sqrt(squares / 999) + 0.5), stats.stddev());
+}
+
+void test_integer_mean_and_stddev_round_to_nearest() {
+  SpeedStats stats;
+  stats.add(1000, 0);
+  stats.add(3000, 0);
+  TEST_ASSERT_EQUAL_UINT16(2000, stats.mean());
+  TEST_ASSERT_EQUAL_UINT16(1414, stats.stddev()); // sqrt(2000000) = 1414.2
+
+  // A long run of one speed neither drifts the mean nor grows the spread
+  SpeedStats steady;
+  steady.add(5001, 0);
+  steady.add(5002, 0);
+  for (int i = 0; i < 100000; i++) {
+    steady.add(5001, 0);
+  }
+  TEST_ASSERT_EQUAL_UINT16(5001, steady.mean());
+  TEST_ASSERT_EQUAL_UINT16(0, steady.stddev());
+}
+
+void test_min_max() {
+  SpeedStats stats;
+  stats.add(4500, 0);
+  stats.add(1200, 0);
+  stats.add(9100, 0);
+  TEST_ASSERT_EQUAL_UINT16(1200, stats.minSpeed());
+  TEST_ASSERT_EQUAL_UINT16(9100, stats.maxSpeed());
+}
+
+void test_percentile_within_bucket_resolution() {
+  SpeedStats stats;
+  // 20.00 .. 119.99 km/h in 0.01 steps, so p85 is 105.00 km/h
+  for (uint32_t v = 2000; v < 12000; v++) {
+    stats.add(v, 0);
+  }
+  uint16_t p85 = stats.percentile(85);
+  TEST_ASSERT_UINT32_WITHIN(10500 / 32, 10500, p85);
+  TEST_ASSERT_UINT32_WITHIN(7000 / 32, 7000, stats.percentile(50));
+  TEST_ASSERT_EQUAL_UINT16(11999, stats.percentile(100));
+}
+
+void test_cars_per_minute_ring() {
+  SpeedStats stats;
+  for (int i = 0; i < 12; i++) {
+    stats.add(5000, 60000 + i * 5000); // 12 cars in minute 1
+  }
+  stats.add(6000, 130000);             // 1 car in minute 2
+
+  TEST_ASSERT_EQUAL_UINT16(12, stats.carsPerMinute(125000));
+  TEST_ASSERT_EQUAL_UINT16(1, stats.carsPerMinute(185000));
+  TEST_ASSERT_EQUAL_UINT16(0, stats.carsPerMinute(245000));
+  TEST_ASSERT_EQUAL_UINT32(60000, stats.minute(185000, 2).sumCentiKmh);
+
+  // An hour later the slot is reused, not added to
+  stats.add(7000, 60000 + 3600000);
+  TEST_ASSERT_EQUAL_UINT16(1, stats.carsPerMinute(125000 + 3600000));
+  TEST_ASSERT_EQUAL_UINT16(0, stats.minute(185000, 2 + 60).count);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_empty);
+  RUN_TEST(test_mean_and_stddev_match_two_pass);
+  RUN_TEST(test_integer_mean_and_stddev_round_to_nearest);
+  RUN_TEST(test_min_max);
+  RUN_TEST(test_percentile_within_bucket_resolution);
+  RUN_TEST(test_cars_per_minute_ring);
+  return UNITY_END();
+}
@@ -0,0 +1,276 @@
+// Host tests for lib/StepperEngine. The tests call tick() in place of the
+// timer interrupt, so one call is STEPPER_ENGINE_TICK_US of motor time.
+
+#include <StepperEngine.h>
+#include <unity.h>
+
+#include <vector>
+
+const uint8_t PINS_A[4] = {8, 9, 10, 11};
+const uint8_t PINS_B[4] = {2, 3, 4, 5};
+const uint8_t PINS_C[4] = {14, 15, 16, 17};
+int8_t motorA = -1;
+int8_t motorB = -1;
+int8_t motorC = -1;
+StepperRamp ramp;
+
+void runFor(uint32_t us) {
+  for (uint32_t t = 0; t < us; t += StepperEngine::TICK_US) {
+    steppers.tick();
+  }
+}
+
+uint8_t coils(const uint8_t pins[4]) {
+  uint8_t bits = 0;
+  for (int p = 0; p < 4; p++) {
+    bits |= digitalRead(pins[p]) << p;
+  }
+  return bits;
+}
+
+void test_stopped_until_a_period_is_set() {
+  runFor(100000);
+  TEST_ASSERT_EQUAL(0, steppers.position(motorA));
+  TEST_ASSERT_EQUAL_HEX8(0b0101, coils(PINS_A));
+}
+
+void test_fractional_millisecond_period_is_exact() {
+  // The old millis() loop truncated 3.5 ms to 3 ms
+  steppers.setPeriod(motorA, 3500);
+  runFor(3500000);
+  TEST_ASSERT_EQUAL(1000, steppers.position(motorA));
+}
+
+void test_period_between_ticks_averages_out() {
+  long before = steppers.position(motorA);
+  steppers.setPeriod(motorA, 3530);
+  runFor(3530 * 1000);
+  TEST_ASSERT_INT32_WITHIN(1, 1000, steppers.position(motorA) - before);
+}
+
+void test_full_step_sequence_and_reverse() {
+  const uint8_t sequence[4] = {0b0101, 0b0110, 0b1010, 0b1001};
+  steppers.setPeriod(motorA, 0);
+  steppers.setPeriod(motorB, 2000);
+
+  long start = steppers.position(motorB);
+  uint8_t phase = start & 3;
+  for (int i = 0; i < 8; i++) {
+    runFor(2000);
+    phase = (phase + 1) & 3;
+    TEST_ASSERT_EQUAL_HEX8(sequence[phase], coils(PINS_B));
+  }
+
+  steppers.setDirection(motorB, -1);
+  for (int i = 0; i < 8; i++) {
+    runFor(2000);
+    phase = (phase - 1) & 3;
+    TEST_ASSERT_EQUAL_HEX8(sequence[phase], coils(PINS_B));
+  }
+  TEST_ASSERT_EQUAL(start, steppers.position(motorB));
+}
+
+void test_motors_are_independent() {
+  long a = steppers.position(motorA);
+  long b = steppers.position(motorB);
+  steppers.setPeriod(motorA, 500);
+  steppers.setDirection(motorB, 1);
+  runFor(1000000);
+  TEST_ASSERT_EQUAL(2000, steppers.position(motorA) - a);
+  TEST_ASSERT_EQUAL(500, steppers.position(motorB) - b);
+}
+
+void test_trapezoid_ramp_matches_constant_acceleration() {
+  uint16_t length = ramp.build(1000, 2000);
+  // v^2 / 2a = 1000^2 / 4000 = 250 steps, more than the table holds
+  TEST_ASSERT_EQUAL(STEPPER_ENGINE_RAMP_STEPS, length);
+
+  length = ramp.build(2000, 2000);
+  // 500^2 / 4000 = 62.5 steps to top speed, plus the top speed entry
+  TEST_ASSERT_INT32_WITHIN(2, 64, length);
+  TEST_ASSERT_EQUAL(2000, ramp.interval(length - 1));
+
+  // Step n comes sqrt(2n / a) after the start. The first interval is
+  // deliberately short (Austin's 0.676 correction), so time from step 1.
+  uint32_t elapsed = 0;
+  for (uint16_t n = 1; n < 50; n++) {
+    TEST_ASSERT_TRUE(ramp.interval(n - 1) > ramp.interval(n));
+    elapsed += ramp.interval(n);
+  }
+  uint32_t expected = (sqrt(2.0 * 50 / 2000) - sqrt(2.0 / 2000)) * 1e6;
+  TEST_ASSERT_UINT32_WITHIN(expected / 50, expected, elapsed);
+}
+
+void test_s_curve_ramp_eases_in() {
+  StepperRamp trapezoid;
+  trapezoid.build(2000, 2000);
+  StepperRamp sCurve;
+  uint16_t length = sCurve.build(2000, 2000, StepperRamp::S_CURVE);
+
+  // Gentler start, same top speed, longer ramp
+  TEST_ASSERT_TRUE(sCurve.interval(1) > trapezoid.interval(1));
+  TEST_ASSERT_EQUAL(2000, sCurve.interval(length - 1));
+  TEST_ASSERT_TRUE(length > trapezoid.length());
+  for (uint16_t n = 0; n + 1 < length; n++) {
+    TEST_ASSERT_TRUE(sCurve.interval(n) >= sCurve.interval(n + 1));
+  }
+}
+
+// Runs until the motor stops, returning the intervals between its steps
+std::vector<uint32_t> runMove() {
+  std::vector<uint32_t> intervals;
+  long last = steppers.position(motorC);
+  uint32_t since = 0;
+  while (steppers.isMoving(motorC)) {
+    steppers.tick();
+    since += StepperEngine::TICK_US;
+    if (steppers.position(motorC) != last) {
+      last = steppers.position(motorC);
+      intervals.push_back(since);
+      since = 0;
+    }
+  }
+  return intervals;
+}
+
+void test_move_accelerates_cruises_and_brakes() {
+  ramp.build(2000, 2000);
+  steppers.setRamp(motorC, &ramp);
+  long start = steppers.position(motorC);
+  TEST_ASSERT_TRUE(steppers.move(motorC, 500));
+
+  std::vector<uint32_t> intervals = runMove();
+  TEST_ASSERT_EQUAL(500, steppers.position(motorC) - start);
+  TEST_ASSERT_EQUAL(500, intervals.size());
+
+  // Mirror-image ramps at both ends, top speed in the middle
+  TEST_ASSERT_EQUAL(2000, intervals[250]);
+  TEST_ASSERT_UINT32_WITHIN(StepperEngine::TICK_US, ramp.interval(0), intervals[0]);
+  TEST_ASSERT_UINT32_WITHIN(StepperEngine::TICK_US, intervals[1], intervals[498]);
+}
+
+void test_short_move_never_reaches_top_speed() {
+  long start = steppers.position(motorC);
+  steppers.move(motorC, -20);
+  std::vector<uint32_t> intervals = runMove();
+  TEST_ASSERT_EQUAL(-20, steppers.position(motorC) - start);
+  for (size_t i = 0; i < intervals.size(); i++) {
+    TEST_ASSERT_TRUE(intervals[i] > 2000);
+  }
+}
+
+void test_queued_moves_reverse_through_a_stop() {
+  long start = steppers.position(motorC);
+  TEST_ASSERT_TRUE(steppers.move(motorC, 300));
+  TEST_ASSERT_TRUE(steppers.move(motorC, -300));
+  TEST_ASSERT_TRUE(steppers.move(motorC, 100));
+  TEST_ASSERT_EQUAL(3, steppers.queuedMoves(motorC));
+
+  std::vector<uint32_t> intervals = runMove();
+  TEST_ASSERT_EQUAL(100, steppers.position(motorC) - start);
+  TEST_ASSERT_EQUAL(700, intervals.size());
+  // The first step after each reversal is a standing start
+  TEST_ASSERT_TRUE(intervals[300] >= ramp.interval(0));
+  TEST_ASSERT_TRUE(intervals[600] >= ramp.interval(0));
+}
+
+void test_half_step_sequence() {
+  const uint8_t sequence[8] = {0b0101, 0b0100, 0b0110, 0b0010, 0b1010, 0b1000, 0b1001, 0b0001};
+  steppers.setPeriod(motorB, 0);
+  steppers.setDriveMode(motorB, StepperEngine::HALF_STEP);
+  TEST_ASSERT_EQUAL(2, StepperEngine::stepsPerFullStep(StepperEngine::HALF_STEP));
+
+  long start = steppers.position(motorB);
+  steppers.setPeriod(motorB, 1000);
+  for (int i = 1; i <= 16; i++) {
+    runFor(1000);
+    TEST_ASSERT_EQUAL_HEX8(sequence[i % 8], coils(PINS_B));
+  }
+  TEST_ASSERT_EQUAL(16, steppers.position(motorB) - start);
+  steppers.setPeriod(motorB, 0);
+}
+
+// Ticks each coil end is on over one PWM period
+void pwmOnTicks(const uint8_t pins[4], int onTicks[4]) {
+  for (int p = 0; p < 4; p++) {
+    onTicks[p] = 0;
+  }
+  for (int t = 0; t < STEPPER_ENGINE_PWM_LEVELS; t++) {
+    steppers.tick();
+    uint8_t bits = coils(pins);
+    for (int p = 0; p < 4; p++) {
+      onTicks[p] += (bits >> p) & 1;
+    }
+  }
+}
+
+void test_microstep_currents_follow_sine_and_cosine() {
+  const int micro = STEPPER_ENGINE_MICROSTEPS;
+  const int levels = STEPPER_ENGINE_PWM_LEVELS;
+  TEST_ASSERT_TRUE(steppers.setDriveMode(motorB, StepperEngine::MICROSTEP));
+
+  // Walk one electrical turn a microstep at a time, checking duty per coil
+  for (int e = 0; e < 4 * micro; e++) {
+    int onTicks[4];
+    pwmOnTicks(PINS_B, onTicks);
+    double angle = e * M_PI / 2 / micro;
+    int expectA = lround(levels * fabs(cos(angle)));
+    int expectB = lround(levels * fabs(sin(angle)));
+
+    // Coil A is IN1 for +cos, IN2 for -cos; coil B is IN3/IN4 for sin
+    TEST_ASSERT_INT_WITHIN(1, expectA, onTicks[0] + onTicks[1]);
+    TEST_ASSERT_INT_WITHIN(1, expectB, onTicks[2] + onTicks[3]);
+    TEST_ASSERT_TRUE(cos(angle) > 0.01 ? onTicks[1] == 0 : true);
+    TEST_ASSERT_TRUE(cos(angle) < -0.01 ? onTicks[0] == 0 : true);
+    TEST_ASSERT_TRUE(sin(angle) > 0.01 ? onTicks[3] == 0 : true);
+    TEST_ASSERT_TRUE(sin(angle) < -0.01 ? onTicks[2] == 0 : true);
+
+    // One microstep forward, between PWM periods
+    steppers.setPeriod(motorB, StepperEngine::TICK_US);
+    steppers.tick();
+    steppers.setPeriod(motorB, 0);
+  }
+}
+
+void test_ramp_time_is_the_same_in_every_mode() {
+  // The same distance in full, half and micro steps takes about the same time
+  uint32_t times[3];
+  const StepperEngine::DriveMode modes[3] = {StepperEngine::FULL_STEP, StepperEngine::HALF_STEP,
+                                             StepperEngine::MICROSTEP};
+  ramp.build(2000, 2000);
+  for (int m = 0; m < 3; m++) {
+    steppers.setDriveMode(motorC, modes[m]);
+    steppers.move(motorC, 300L * StepperEngine::stepsPerFullStep(modes[m]));
+    std::vector<uint32_t> intervals = runMove();
+    times[m] = 0;
+    for (size_t i = 0; i < intervals.size(); i++) {
+      times[m] += intervals[i];
+    }
+  }
+  TEST_ASSERT_UINT32_WITHIN(times[0] / 50, times[0], times[1]);
+  TEST_ASSERT_UINT32_WITHIN(times[0] / 50, times[0], times[2]);
+  steppers.setDriveMode(motorC, StepperEngine::FULL_STEP);
+}
+
+int main(int argc, char **argv) {
+  motorA = steppers.addMotor(PINS_A[0], PINS_A[1], PINS_A[2], PINS_A[3]);
+  motorB = steppers.addMotor<2, 3, 4, 5>();
+  motorC = steppers.addMotor(PINS_C[0], PINS_C[1], PINS_C[2], PINS_C[3]);
+  steppers.begin();
+
+  UNITY_BEGIN();
+  RUN_TEST(test_stopped_until_a_period_is_set);
+  RUN_TEST(test_fractional_millisecond_period_is_exact);
+  RUN_TEST(test_period_between_ticks_averages_out);
+  RUN_TEST(test_full_step_sequence_and_reverse);
+  RUN_TEST(test_motors_are_independent);
+  RUN_TEST(test_trapezoid_ramp_matches_constant_acceleration);
+  RUN_TEST(test_s_curve_ramp_eases_in);
+  RUN_TEST(test_move_accelerates_cruises_and_brakes);
+  RUN_TEST(test_short_move_never_reaches_top_speed);
+  RUN_TEST(test_queued_moves_reverse_through_a_stop);
+  RUN_TEST(test_half_step_sequence);
+  RUN_TEST(test_microstep_currents_follow_sine_and_cosine);
+  RUN_TEST(test_ramp_time_is_the_same_in_every_mode);
+  return UNITY_END();
+}
@@ -0,0 +1,245 @@
+// Host tests for lib/Telemetry: encoder -> byte stream -> decoder
+
+#include <Telemetry.h>
+#include <TelemetryDecoder.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Collects what the encoder writes, with a settable amount of TX room
+class Sink : public Print {
+public:
+  std::string bytes;
+  int room = 1 << 20;
+
+  size_t write(uint8_t c) override {
+    bytes.push_back((char)c);
+    room--;
+    return 1;
+  }
+  using Print::write;
+  int availableForWrite() override { return room; }
+};
+
+struct Record {
+  uint32_t timeMs;
+  uint8_t channel;
+  int32_t value;
+};
+
+struct Decoded {
+  std::vector<Record> records;
+  std::string text;
+};
+
+void onRecord(void *context, uint32_t timeMs, uint8_t channel, int32_t value) {
+  ((Decoded *)context)->records.push_back({timeMs, channel, value});
+}
+
+void onText(void *context, const char *text, size_t length) {
+  ((Decoded *)context)->text.append(text, length);
+}
+
+Decoded decode(const std::string &bytes) {
+  Decoded decoded;
+  TelemetryDecoder decoder(onRecord, onText, &decoded);
+  // Odd chunk sizes, like a serial port delivers them
+  for (size_t i = 0; i < bytes.size(); i += 7) {
+    size_t count = bytes.size() - i < 7 ? bytes.size() - i : 7;
+    decoder.feed((const uint8_t *)bytes.data() + i, count);
+  }
+  decoder.finish();
+  return decoded;
+}
+
+void test_records_round_trip() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  const int32_t values[] = {0, 1, -1, 127, -128, 300000, INT32_MAX, INT32_MIN};
+
+  for (uint32_t i = 0; i < 8; i++) {
+    telemetry.send(1000 + i * 250, i + 1, values[i]);
+  }
+  telemetry.beginFrame(70000);
+  telemetry.add(20, 5000);
+  telemetry.add(21, 26);
+  telemetry.endFrame();
+  telemetry.pump();
+
+  Decoded decoded = decode(sink.bytes);
+  TEST_ASSERT_EQUAL(10, decoded.records.size());
+  for (uint32_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL_UINT32(1000 + i * 250, decoded.records[i].timeMs);
+    TEST_ASSERT_EQUAL_UINT8(i + 1, decoded.records[i].channel);
+    TEST_ASSERT_EQUAL_INT32(values[i], decoded.records[i].value);
+  }
+  TEST_ASSERT_EQUAL_UINT32(70000, decoded.records[9].timeMs);
+  TEST_ASSERT_EQUAL_INT32(26, decoded.records[9].value);
+  TEST_ASSERT_TRUE(decoded.text.empty());
+}
+
+void test_text_passes_through() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  telemetry.send(5, 1, 42);
+  telemetry.println("Adaptive timing off");
+  telemetry.send(6, 1, 43);
+  telemetry.print("trailing");
+  telemetry.pump();
+
+  Decoded decoded = decode(sink.bytes);
+  TEST_ASSERT_EQUAL(2, decoded.records.size());
+  TEST_ASSERT_EQUAL_STRING("Adaptive timing off\r\ntrailing", decoded.text.c_str());
+}
+
+void test_corrupt_frame_is_not_a_record() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  telemetry.send(5, 1, 42);
+  telemetry.send(6, 2, 43);
+  telemetry.pump();
+  sink.bytes[2] ^= 0x10;
+
+  Decoded decoded = decode(sink.bytes);
+  TEST_ASSERT_EQUAL(1, decoded.records.size());
+  TEST_ASSERT_EQUAL_INT32(43, decoded.records[0].value);
+}
+
+// After a lost frame its layout's deltas must not decode against the wrong
+// values, and the next key frame brings it back
+void test_lost_frame_skips_layout_until_key_frame() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  std::vector<size_t> ends;
+  for (int32_t i = 0; i < 2 * TELEMETRY_KEY_INTERVAL; i++) {
+    telemetry.send(i * 100, 1, i * i);
+    telemetry.send(i * 100 + 50, 2, -i);
+    telemetry.pump();
+    ends.push_back(sink.bytes.size());
+  }
+
+  // Cut out the pair of frames from round 3
+  std::string bytes = sink.bytes.substr(0, ends[2]) + sink.bytes.substr(ends[3]);
+  Decoded decoded;
+  TelemetryDecoder decoder(onRecord, onText, &decoded);
+  decoder.feed((const uint8_t *)bytes.data(), bytes.size());
+
+  TEST_ASSERT_TRUE(decoder.skippedFrames() > 0);
+  TEST_ASSERT_EQUAL(2 * (2 * TELEMETRY_KEY_INTERVAL - 1) - decoder.skippedFrames(), decoded.records.size());
+  for (const Record &record : decoded.records) {
+    int32_t i = record.timeMs / 100;
+    TEST_ASSERT_TRUE(i != 3);
+    TEST_ASSERT_EQUAL_INT32(record.channel == 1 ? i * i : -i, record.value);
+  }
+  TEST_ASSERT_EQUAL_UINT32((2 * TELEMETRY_KEY_INTERVAL - 1) * 100 + 50, decoded.records.back().timeMs);
+}
+
+void test_pump_never_exceeds_tx_room() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  for (int i = 0; i < 20; i++) {
+    telemetry.send(i, 1, i);
+  }
+  sink.room = 10;
+  TEST_ASSERT_EQUAL(10, telemetry.pump());
+  TEST_ASSERT_EQUAL(0, telemetry.pump());
+  sink.room = 1 << 20;
+  telemetry.pump();
+  TEST_ASSERT_EQUAL(20, decode(sink.bytes).records.size());
+}
+
+void test_full_ring_drops_whole_frames() {
+  Sink sink;
+  Telemetry telemetry(sink);
+  uint32_t sent = 0;
+  for (uint32_t i = 0; i < 200; i++) {
+    sent += telemetry.send(i * 10, 1, i);
+  }
+  TEST_ASSERT_TRUE(telemetry.droppedFrames() > 0);
+  TEST_ASSERT_EQUAL_UINT32(200, sent + telemetry.droppedFrames());
+
+  telemetry.pump();
+  telemetry.send(123456, 2, 7);
+  telemetry.pump();
+
+  Decoded decoded = decode(sink.bytes);
+  TEST_ASSERT_EQUAL(sent + 1, decoded.records.size());
+  // Frames after a drop are deltas against the last one that went out
+  for (size_t i = 0; i < sent; i++) {
+    TEST_ASSERT_EQUAL_UINT32(decoded.records[i].value * 10, decoded.records[i].timeMs);
+  }
+  TEST_ASSERT_EQUAL_UINT32(123456, decoded.records.back().timeMs);
+}
+
+// Bytes per event against the Serial.print lines they replace. Each sketch
+// has its own serial port, so its own encoder.
+void test_bytes_on_the_wire() {
+  Sink finnalSink, potSink, lightSink;
+  Telemetry finnal(finnalSink), pot(potSink), light(lightSink);
+  std::string text;
+  uint32_t timeMs = 2000;
+  char line[64];
+
+  for (int i = 0; i < 100; i++) {
+    // finnal: a phase change and a measured car
+    timeMs += 3000;
+    finnal.send(timeMs, 1, i % 6);
+    text += "Traffic light state changed to: " + std::to_string(i % 6) + "\r\n";
+    timeMs += 1200;
+    int32_t speed = 4673 + (i * 37) % 400;
+    finnal.beginFrame(timeMs);
+    finnal.add(3, speed);
+    finnal.add(4, 25);
+    finnal.endFrame();
+    snprintf(line, sizeof(line), "Speed: %d.%02d +/- 0.25 km/h\r\n", speed / 100, speed % 100);
+    text += line;
+
+    // Poteniometer: frequency and delay every blink, the knob turned now and then
+    timeMs += 600;
+    int32_t frequency = 1234 + (i / 10) * 3;
+    pot.beginFrame(timeMs);
+    pot.add(1, frequency);
+    pot.add(2, 487);
+    pot.endFrame();
+    text += "Frequency: " + std::to_string(frequency) + " Hz | Delay: 487\r\n";
+
+    // photoResistor: one reading every 100 ms, flickering a little, sent
+    // ten to a frame
+    timeMs += 100;
+    int32_t reading = 2868 + (i * 5) % 7;
+    if (i % 10 == 0) {
+      light.beginFrame(timeMs);
+    }
+    light.add(1, reading);
+    if (i % 10 == 9) {
+      light.endFrame();
+    }
+    text += std::to_string(reading) + "\r\n";
+
+    finnal.pump();
+    pot.pump();
+    light.pump();
+  }
+
+  size_t bytes = finnalSink.bytes.size() + potSink.bytes.size() + lightSink.bytes.size();
+  printf("text %u bytes, telemetry %u bytes, %.1fx smaller\n", (unsigned)text.size(),
+         (unsigned)bytes, (double)text.size() / bytes);
+  TEST_ASSERT_EQUAL(300, decode(finnalSink.bytes).records.size());
+  TEST_ASSERT_EQUAL(200, decode(potSink.bytes).records.size());
+  TEST_ASSERT_EQUAL(100, decode(lightSink.bytes).records.size());
+  TEST_ASSERT_TRUE(bytes * 5 <= text.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_records_round_trip);
+  RUN_TEST(test_text_passes_through);
+  RUN_TEST(test_corrupt_frame_is_not_a_record);
+  RUN_TEST(test_lost_frame_skips_layout_until_key_frame);
+  RUN_TEST(test_pump_never_exceeds_tx_room);
+  RUN_TEST(test_full_ring_drops_whole_frames);
+  RUN_TEST(test_bytes_on_the_wire);
+  return UNITY_END();
+}
@@ -0,0 +1,106 @@
+// Host tests for lib/Tmp36: the flash table against the nominal esp_adc_cal
+// curve it was generated from, plus the per-reading cost against the old
+// float conversion.
+
+#include <Tmp36.h>
+#include <unity.h>
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+// esp_adc_cal at 11 dB with the default 1100 mV Vref
+double referenceMv(double code) {
+  const double coeffA = (1100 * 196602) / 4096; // integer division, as the IDF does
+  return coeffA * code / 65536 + 142;
+}
+
+double referenceCentiCelsius(double code) {
+  return (referenceMv(code) - 500) * 10;
+}
+
+void test_table_points_match_reference() {
+  for (uint8_t i = 0; i < Tmp36::TABLE_POINTS; i++) {
+    double expected = referenceCentiCelsius(i << Tmp36::SEGMENT_BITS);
+    TEST_ASSERT_TRUE(fabs(Tmp36::NOMINAL_TABLE[i] - expected) <= 0.5);
+  }
+}
+
+void test_every_12_bit_code_within_a_hundredth() {
+  Tmp36 sensor;
+  TEST_ASSERT_FALSE(sensor.begin());
+  TEST_ASSERT_FALSE(sensor.calibrated());
+
+  double worst = 0;
+  for (uint32_t code = 0; code < 4096; code++) {
+    double error = fabs(sensor.centiCelsius(code) - referenceCentiCelsius(code));
+    if (error > worst) {
+      worst = error;
+    }
+  }
+  printf("worst error over 4096 codes: %.2f centi-degrees\n", worst);
+  TEST_ASSERT_TRUE(worst <= 1.0);
+}
+
+void test_oversampled_readings() {
+  Tmp36 sensor;
+  // 16-bit values resolve between 12-bit codes
+  for (uint32_t value = 0; value < (4095UL << 4); value += 7) {
+    double error = fabs(sensor.centiCelsius(value, 16) - referenceCentiCelsius(value / 16.0));
+    TEST_ASSERT_TRUE(error <= 1.0);
+  }
+  // Same code, same answer at either width
+  TEST_ASSERT_EQUAL(sensor.centiCelsius(717), sensor.centiCelsius(717 << 4, 16));
+}
+
+void test_room_temperature() {
+  Tmp36 sensor;
+  // 720 mV is 22 C. Uncorrected, code 717 used to read 7.8 C, hence the +14.
+  TEST_ASSERT_INT_WITHIN(10, 2200, sensor.centiCelsius(717));
+  TEST_ASSERT_EQUAL(7160, Tmp36::toCentiFahrenheit(2200));
+  TEST_ASSERT_EQUAL(-4000, Tmp36::toCentiFahrenheit(-4000));
+  TEST_ASSERT_EQUAL(INT16_MAX, Tmp36::toCentiFahrenheit(sensor.centiCelsius(4095)));
+  TEST_ASSERT_EQUAL(Tmp36::NOMINAL_TABLE[Tmp36::TABLE_POINTS - 1], sensor.centiCelsius(5000));
+}
+
+void test_per_reading_benchmark() {
+  const int READINGS = 4000000;
+  std::vector<uint16_t> codes(READINGS);
+  srand(22);
+  for (int i = 0; i < READINGS; i++) {
+    codes[i] = rand() % 4096;
+  }
+
+  Tmp36 sensor;
+  int32_t sink = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < READINGS; i++) {
+    sink += sensor.centiCelsius(codes[i]);
+  }
+  auto end = std::chrono::steady_clock::now();
+  double tableNs = std::chrono::duration<double, std::nano>(end - start).count() / READINGS;
+
+  // The sketch's old conversion
+  float floatSink = 0;
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < READINGS; i++) {
+    float voltage = codes[i] * (3.3 / 4095.0);
+    floatSink += ((voltage - 0.5) * 100.0) + 14;
+  }
+  end = std::chrono::steady_clock::now();
+  double floatNs = std::chrono::duration<double, std::nano>(end - start).count() / READINGS;
+
+  printf("table %.2f ns/reading, float %.2f ns/reading (host)  (%d)\n", tableNs, floatNs,
+         (int)((sink + (int32_t)floatSink) & 1));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_table_points_match_reference);
+  RUN_TEST(test_every_12_bit_code_within_a_hundredth);
+  RUN_TEST(test_oversampled_readings);
+  RUN_TEST(test_room_temperature);
+  RUN_TEST(test_per_reading_benchmark);
+  return UNITY_END();
+}
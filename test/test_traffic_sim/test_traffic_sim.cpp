@@ -0,0 +1,276 @@
+// Runs the traffic controller sketch (src/grade11/finnal/main.cpp, built
+// unmodified) on the host against lib/ArduinoSim.
+//
+// Sketch globals cannot be reset, so the tests share one simulation and run
+// in order, each one moving virtual time forward.
+
+#include <Sim.h>
+#include <TelemetryDecoder.h>
+#include <unity.h>
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "../../src/grade11/finnal/main.cpp"
+
+const uint64_t MS = 1000;
+const uint64_t SECOND = 1000 * MS;
+
+// One car crossing both photoresistors at a given speed
+void scheduleCar(uint64_t atUs, uint32_t speedCentiKmh) {
+  // dt = distance / speed, in microseconds
+  uint64_t travelUs = (uint64_t)sensorDistanceMm * 3600 * 100 / speedCentiKmh;
+  sim::pulseLowAt(atUs, speedSensors[0], 20 * MS);
+  sim::pulseLowAt(atUs + travelUs, speedSensors[1], 20 * MS);
+}
+
+// Light states reconstructed from the pin history: (time, state) per change
+std::vector<std::pair<uint64_t, int>> lightTimeline() {
+  std::vector<std::pair<uint64_t, int>> timeline;
+  uint8_t levels[64] = {0};
+  const std::vector<sim::PinChange> &history = sim::pinHistory();
+
+  for (size_t i = 0; i < history.size(); i++) {
+    levels[history[i].pin] = history[i].level;
+    // Only look at the lights once every change at this instant is applied
+    if (i + 1 < history.size() && history[i + 1].us == history[i].us) {
+      continue;
+    }
+
+    uint8_t outputs = 0;
+    for (int c = 0; c < 3; c++) {
+      outputs |= levels[trafficLight1[c]] << c;
+      outputs |= levels[trafficLight2[c]] << (3 + c);
+    }
+    // Both all-red phases look the same, so prefer the expected next state
+    int state = timeline.empty() ? -1 : (timeline.back().second + 1) % STATE_COUNT;
+    if (state < 0 || stateOutputs(state) != outputs) {
+      state = -1;
+      for (int s = 0; s < STATE_COUNT && state < 0; s++) {
+        if (stateOutputs(s) == outputs) {
+          state = s;
+        }
+      }
+    }
+    if (state >= 0 && (timeline.empty() || outputs != stateOutputs(timeline.back().second))) {
+      timeline.push_back({history[i].us, state});
+    }
+  }
+  return timeline;
+}
+
+struct Record {
+  uint32_t timeMs;
+  uint8_t channel;
+  int32_t value;
+};
+
+void collectRecord(void *context, uint32_t timeMs, uint8_t channel, int32_t value) {
+  ((std::vector<Record> *)context)->push_back({timeMs, channel, value});
+}
+
+// Every telemetry record sent so far
+std::vector<Record> loggedRecords() {
+  std::vector<Record> records;
+  TelemetryDecoder decoder(collectRecord, NULL, &records);
+  decoder.feed((const uint8_t *)Serial.output().data(), Serial.output().size());
+  TEST_ASSERT_EQUAL_UINT32(0, decoder.skippedFrames());
+  return records;
+}
+
+// Values of one channel, in order
+std::vector<int32_t> loggedValues(uint8_t channel) {
+  std::vector<int32_t> values;
+  for (const Record &record : loggedRecords()) {
+    if (record.channel == channel) {
+      values.push_back(record.value);
+    }
+  }
+  return values;
+}
+
+// Every measured speed and its uncertainty, in 0.01 km/h
+std::vector<std::pair<uint32_t, uint32_t>> loggedSpeeds() {
+  std::vector<int32_t> speeds = loggedValues(CH_SPEED);
+  std::vector<int32_t> uncertainties = loggedValues(CH_SPEED_UNCERTAINTY);
+  std::vector<std::pair<uint32_t, uint32_t>> result;
+  for (size_t i = 0; i < speeds.size(); i++) {
+    result.push_back({(uint32_t)speeds[i], (uint32_t)uncertainties[i]});
+  }
+  return result;
+}
+
+void test_startup_shows_splash_with_all_red() {
+  sim::runUntil(1 * SECOND);
+
+  TEST_ASSERT_EQUAL_STRING("Traffic System  ", sim::lcdLine(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("Initializing... ", sim::lcdLine(1).c_str());
+  TEST_ASSERT_EQUAL(HIGH, sim::pinLevel(trafficLight1[0]));
+  TEST_ASSERT_EQUAL(HIGH, sim::pinLevel(trafficLight2[0]));
+  TEST_ASSERT_EQUAL(LOW, sim::pinLevel(trafficLight1[2]));
+  TEST_ASSERT_EQUAL(LOW, sim::pinLevel(trafficLight2[2]));
+}
+
+void test_billboard_rotates_messages() {
+  sim::runUntil(2 * SECOND + 100 * MS);
+  TEST_ASSERT_EQUAL_STRING("Welcome to City ", sim::lcdLine(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("Drive Safely    ", sim::lcdLine(1).c_str());
+
+  sim::runUntil(7 * SECOND + 100 * MS);
+  TEST_ASSERT_EQUAL_STRING("Buckle Up!      ", sim::lcdLine(1).c_str());
+
+  // lcd.begin() and the frame's begin() clear once each, nothing after that
+  TEST_ASSERT_EQUAL_UINT32(2, sim::lcd()->clears());
+}
+
+// Yellow and all-red come from the table; greens are adaptive
+void assertPhaseLengths(const std::vector<std::pair<uint64_t, int>> &timeline, size_t from,
+                        unsigned long road1Green, unsigned long road2Green) {
+  for (size_t i = from; i + 1 < timeline.size(); i++) {
+    int state = timeline[i].second;
+    unsigned long expected = lightStates[state][PHASE_DURATION];
+    if (greenRoad(state) == ROAD_1) {
+      expected = road1Green;
+    }
+    else if (greenRoad(state) == ROAD_2) {
+      expected = road2Green;
+    }
+    TEST_ASSERT_EQUAL((state + 1) % STATE_COUNT, timeline[i + 1].second);
+    TEST_ASSERT_EQUAL_UINT64(expected * MS, timeline[i + 1].first - timeline[i].first);
+  }
+}
+
+void test_phases_follow_the_table() {
+  sim::runUntil(2 * SECOND + 3 * 30 * SECOND);
+
+  std::vector<std::pair<uint64_t, int>> timeline = lightTimeline();
+  // Initial all-red, then three full cycles
+  TEST_ASSERT_TRUE(timeline.size() >= 1 + 3 * STATE_COUNT);
+
+  // First green comes right after the 2 s all-red startup
+  TEST_ASSERT_EQUAL(STATE_1_GREEN, timeline[1].second);
+  TEST_ASSERT_EQUAL_UINT64(2 * SECOND, timeline[1].first);
+
+  // No traffic yet, so both roads only get the minimum green
+  assertPhaseLengths(timeline, 1, minGreenTime, minGreenTime);
+}
+
+void test_speed_is_measured_and_displayed() {
+  uint64_t start = sim::nowUs() + 1 * SECOND;
+  scheduleCar(start, 5000); // 50 km/h
+
+  sim::runUntil(start + 500 * MS);
+  TEST_ASSERT_EQUAL_STRING("Vehicle Speed:  ", sim::lcdLine(0).c_str());
+  TEST_ASSERT_EQUAL_STRING("50.00 km/h      ", sim::lcdLine(1).c_str());
+  std::vector<std::pair<uint32_t, uint32_t>> speeds = loggedSpeeds();
+  TEST_ASSERT_EQUAL(1, speeds.size());
+  TEST_ASSERT_EQUAL_UINT32(5000, speeds[0].first);
+  TEST_ASSERT_EQUAL_UINT32(26, speeds[0].second);
+
+  // Back to the billboard after 5 s
+  sim::runUntil(start + 6 * SECOND);
+  TEST_ASSERT_EQUAL_STRING("Welcome to City ", sim::lcdLine(0).c_str());
+}
+
+void test_profiles_dump_on_request() {
+  Serial.receive("p");
+  sim::runFor(500 * MS);
+
+  const std::string &log = Serial.output();
+  TEST_ASSERT_TRUE(log.find("[lights] times in us") != std::string::npos);
+  TEST_ASSERT_TRUE(log.find("phase change n ") != std::string::npos);
+  TEST_ASSERT_TRUE(log.find("[sensors] times in us") != std::string::npos);
+  TEST_ASSERT_TRUE(log.find("edge pairing n 2 ") != std::string::npos);
+}
+
+void test_hours_of_traffic() {
+  const uint64_t duration = 2 * 3600 * SECOND;
+  uint64_t start = sim::nowUs() + 1 * SECOND;
+  size_t speedsBefore = loggedSpeeds().size();
+  size_t phasesBefore = lightTimeline().size();
+
+  // A car every 3-20 s at 20-130 km/h, same sequence on every run
+  srand(1234);
+  std::vector<uint32_t> truth;
+  for (uint64_t t = start; t < start + duration - 30 * SECOND;) {
+    uint32_t speed = 2000 + rand() % 11000;
+    scheduleCar(t, speed);
+    truth.push_back(speed);
+    t += (3 + rand() % 18) * SECOND;
+  }
+
+  sim::runUntil(start + duration);
+
+  // Every car measured, within its reported uncertainty
+  std::vector<std::pair<uint32_t, uint32_t>> speeds = loggedSpeeds();
+  TEST_ASSERT_EQUAL(truth.size(), speeds.size() - speedsBefore);
+  for (size_t i = 0; i < truth.size(); i++) {
+    const std::pair<uint32_t, uint32_t> &measured = speeds[speedsBefore + i];
+    TEST_ASSERT_UINT32_WITHIN(measured.second, truth[i], measured.first);
+  }
+  TEST_ASSERT_TRUE(loggedValues(CH_EDGES_DROPPED).empty());
+  TEST_ASSERT_EQUAL_UINT32(0, telemetry.droppedFrames());
+
+  // The task report still arrives every 10 s
+  TEST_ASSERT_UINT32_WITHIN(2, (start + duration) / SECOND / 10, loggedValues(CH_NIGHT_SENSOR).size());
+
+  // Nobody ever waits on road 2, so road 1 keeps the longest green. Skip the
+  // first cycle, which was planned before the first car arrived.
+  std::vector<std::pair<uint64_t, int>> timeline = lightTimeline();
+  size_t from = phasesBefore + STATE_COUNT;
+  while (timeline[from].second != STATE_1_GREEN) {
+    from++;
+  }
+  TEST_ASSERT_TRUE(timeline.size() - from > 3 * STATE_COUNT);
+  assertPhaseLengths(timeline, from, maxGreenTime, minGreenTime);
+}
+
+void test_speed_stats_on_billboard_and_serial() {
+  size_t cars = loggedSpeeds().size();
+  Serial.receive("s");
+  sim::runFor(500 * MS);
+  std::vector<int32_t> counts = loggedValues(CH_STATS_COUNT);
+  TEST_ASSERT_EQUAL(1, counts.size());
+  TEST_ASSERT_EQUAL_INT32(cars, counts[0]);
+  TEST_ASSERT_EQUAL(1, loggedValues(CH_STATS_P85).size());
+
+  // Both statistics views come round within one rotation
+  bool sawPercentile = false;
+  bool sawCarsPerMinute = false;
+  for (int i = 0; i < billboardViewCount + 1; i++) {
+    sim::runFor(messageChangeInterval * MS);
+    sawPercentile |= sim::lcdLine(0) == "85th percentile ";
+    sawCarsPerMinute |= sim::lcdLine(0) == "Cars per minute ";
+  }
+  TEST_ASSERT_TRUE(sawPercentile);
+  TEST_ASSERT_TRUE(sawCarsPerMinute);
+}
+
+void test_fixed_timing_on_request() {
+  Serial.receive("a");
+  sim::runFor(2 * 40 * SECOND);
+  TEST_ASSERT_TRUE(Serial.output().find("Adaptive timing off") != std::string::npos);
+
+  // The cycle in progress finishes first, then the table's green times apply
+  size_t phasesBefore = lightTimeline().size();
+  sim::runFor(3 * 30 * SECOND);
+  std::vector<std::pair<uint64_t, int>> timeline = lightTimeline();
+  TEST_ASSERT_TRUE(timeline.size() - phasesBefore >= 2 * STATE_COUNT);
+  assertPhaseLengths(timeline, phasesBefore, greenTime, greenTime);
+}
+
+int main(int argc, char **argv) {
+  sim::begin(setup, loop);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_startup_shows_splash_with_all_red);
+  RUN_TEST(test_billboard_rotates_messages);
+  RUN_TEST(test_phases_follow_the_table);
+  RUN_TEST(test_speed_is_measured_and_displayed);
+  RUN_TEST(test_profiles_dump_on_request);
+  RUN_TEST(test_hours_of_traffic);
+  RUN_TEST(test_speed_stats_on_billboard_and_serial);
+  RUN_TEST(test_fixed_timing_on_request);
+  return UNITY_END();
+}
@@ -0,0 +1,127 @@
+// Host tests for lib/Ultrasonic. Echo pulses are scripted on the simulated
+// pin, which fires the driver's interrupt at the edges like a real sensor.
+
+#include <Ultrasonic.h>
+#include <Sim.h>
+#include <unity.h>
+
+#include <vector>
+
+const uint8_t TRIG = 26;
+const uint8_t ECHO = 27;
+Ultrasonic sonar(TRIG, ECHO);
+
+std::vector<Ultrasonic::Reading> called;
+
+void onReading(const Ultrasonic::Reading &reading, void *arg) {
+  called.push_back(reading);
+}
+
+// Pings, then answers with an echo of the given width after 450 us
+void pingWithEcho(uint32_t widthUs) {
+  TEST_ASSERT_TRUE(sonar.trigger());
+  uint64_t start = sim::nowUs() + 450;
+  sim::setInputAt(start, ECHO, HIGH);
+  sim::setInputAt(start + widthUs, ECHO, LOW);
+}
+
+void waitForNextCycle() {
+  sim::runFor(ULTRASONIC_CYCLE_US);
+}
+
+void test_trigger_does_not_wait_for_the_echo() {
+  uint64_t before = sim::nowUs();
+  pingWithEcho(1480); // ~254 mm, 10 inches
+  TEST_ASSERT_EQUAL(10, sim::nowUs() - before); // only the trigger pulse
+
+  const std::vector<sim::PinChange> &history = sim::pinHistory();
+  TEST_ASSERT_EQUAL(TRIG, history.back().pin);
+  TEST_ASSERT_EQUAL(LOW, history.back().level);
+  TEST_ASSERT_EQUAL(HIGH, history[history.size() - 2].level);
+
+  Ultrasonic::Reading reading;
+  TEST_ASSERT_TRUE(sonar.busy());
+  TEST_ASSERT_FALSE(sonar.read(reading));
+
+  sim::runFor(5000);
+  TEST_ASSERT_FALSE(sonar.busy());
+  TEST_ASSERT_TRUE(sonar.read(reading));
+  TEST_ASSERT_EQUAL(Ultrasonic::OK, reading.status);
+  TEST_ASSERT_EQUAL(1480, reading.echoUs);
+  TEST_ASSERT_EQUAL(253, reading.mm());
+  TEST_ASSERT_EQUAL((uint32_t)before, reading.triggerUs);
+
+  // The mailbox only hands each reading out once
+  TEST_ASSERT_FALSE(sonar.read(reading));
+  TEST_ASSERT_EQUAL(1, called.size());
+  TEST_ASSERT_EQUAL(1480, called.back().echoUs);
+  waitForNextCycle();
+}
+
+void test_pings_are_spaced_by_the_cycle_time() {
+  pingWithEcho(600);
+  sim::runFor(5000);
+  TEST_ASSERT_FALSE(sonar.busy());
+  TEST_ASSERT_FALSE(sonar.trigger());
+  sim::runFor(ULTRASONIC_CYCLE_US - 5000);
+  TEST_ASSERT_TRUE(sonar.trigger());
+  sim::runFor(ULTRASONIC_TIMEOUT_US + 5000);
+  sonar.poll();
+  waitForNextCycle();
+}
+
+void test_missing_echo_times_out_in_poll() {
+  Ultrasonic::Reading reading;
+  sonar.read(reading);
+  called.clear();
+
+  TEST_ASSERT_TRUE(sonar.trigger());
+  sim::runFor(ULTRASONIC_TIMEOUT_US / 2);
+  sonar.poll();
+  TEST_ASSERT_TRUE(sonar.busy());
+
+  sim::runFor(ULTRASONIC_TIMEOUT_US);
+  sonar.poll();
+  TEST_ASSERT_FALSE(sonar.busy());
+  TEST_ASSERT_TRUE(sonar.read(reading));
+  TEST_ASSERT_EQUAL(Ultrasonic::NO_ECHO, reading.status);
+  TEST_ASSERT_EQUAL(1, called.size());
+  waitForNextCycle();
+}
+
+void test_out_of_range_pulse_is_no_echo() {
+  // Nothing in range: the sensor holds the echo high for ~38 ms
+  pingWithEcho(38000);
+  sim::runFor(40000);
+  Ultrasonic::Reading reading;
+  TEST_ASSERT_TRUE(sonar.read(reading));
+  TEST_ASSERT_EQUAL(Ultrasonic::NO_ECHO, reading.status);
+  waitForNextCycle();
+}
+
+void test_stray_edges_are_ignored() {
+  Ultrasonic::Reading reading;
+  sonar.read(reading);
+
+  // Edges with no ping running
+  sim::pulseLowAt(sim::nowUs() + 100, ECHO, 200);
+  sim::setInputAt(sim::nowUs() + 500, ECHO, HIGH);
+  sim::setInputAt(sim::nowUs() + 900, ECHO, LOW);
+  sim::runFor(1000);
+  TEST_ASSERT_FALSE(sonar.busy());
+  TEST_ASSERT_FALSE(sonar.read(reading));
+}
+
+int main(int argc, char **argv) {
+  sim::runFor(1000);
+  sonar.begin();
+  sonar.setCallback(onReading);
+
+  UNITY_BEGIN();
+  RUN_TEST(test_trigger_does_not_wait_for_the_echo);
+  RUN_TEST(test_pings_are_spaced_by_the_cycle_time);
+  RUN_TEST(test_missing_echo_times_out_in_poll);
+  RUN_TEST(test_out_of_range_pulse_is_no_echo);
+  RUN_TEST(test_stray_edges_are_ignored);
+  return UNITY_END();
+}